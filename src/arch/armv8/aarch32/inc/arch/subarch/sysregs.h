@@ -91,6 +91,7 @@ SYSREG_GEN_ACCESSORS(hcr, 4, c1, c1, 0);
 SYSREG_GEN_ACCESSORS(hcr2, 4, c6, c0, 0);
 SYSREG_GEN_ACCESSORS_MERGE(hcr_el2, hcr, hcr2);
 SYSREG_GEN_ACCESSORS(cntfrq_el0, 0, c14, c0, 0);
+SYSREG_GEN_ACCESSORS_64(cntpct_el0, 0, c14);
 
 SYSREG_GEN_ACCESSORS(mpuir_el2, 4, c0, c0, 4);
 SYSREG_GEN_ACCESSORS(prselr_el2, 4, c6, c2, 1);
@@ -173,6 +174,30 @@ static inline void arm_tlbi_ipas2e1is(vaddr_t vaddr)
     asm volatile("mcr p15, 4, %0, c8, c0, 1" ::"r"(vaddr >> 12));
 }
 
+static inline void arm_tlbi_vmalle1is()
+{
+    asm volatile("mcr p15, 0, r0, c8, c3, 0"); // tlbiallis
+}
+
+/**
+ * There are no range TLB maintenance operations in AArch32.
+ */
+
+static inline bool arm_tlbi_range_supported()
+{
+    return false;
+}
+
+static inline void arm_tlbi_rvae2is(uint64_t range)
+{
+    (void)range;
+}
+
+static inline void arm_tlbi_ripas2e1is(uint64_t range)
+{
+    (void)range;
+}
+
 #endif /* |__ASSEMBLER__ */
 
 #endif /* ARCH_PROFILE_SYSREGS_H */
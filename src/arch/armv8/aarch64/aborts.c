@@ -4,8 +4,13 @@
  */
 
 #include <bao.h>
+#include <arch/aborts.h>
 #include <arch/sysregs.h>
+#include <arch/smcc.h>
 #include <cpu.h>
+#include <vm.h>
+#include <stats.h>
+#include <hypercall.h>
 
 void internal_abort_handler(unsigned long gprs[])
 {
@@ -18,3 +23,66 @@ void internal_abort_handler(unsigned long gprs[])
     console_printk("FAR:\t0x%0lx\n", sysreg_far_el2_read());
     ERROR("cpu%d internal hypervisor abort - PANIC\n", cpu()->id);
 }
+
+static bool aborts_fast_hvc(void)
+{
+    unsigned long fid = vcpu_readreg(cpu()->vcpu, 0);
+    unsigned long srvc = fid & ~SMCC_FID_FN_NUM_MSK;
+
+    if ((srvc != SMCC32_FID_VND_HYP_SRVC && srvc != SMCC64_FID_VND_HYP_SRVC) ||
+        ((fid & SMCC_FID_FN_NUM_MSK) != HC_IPC)) {
+        return false;
+    }
+
+    vcpu_writereg(cpu()->vcpu, 0, (unsigned long)hypercall(HC_IPC));
+
+    return true;
+}
+
+static bool aborts_fast_data(unsigned long iss, unsigned long il)
+{
+    if (!(iss & ESR_ISS_DA_ISV_BIT) || (iss & ESR_ISS_DA_FnV_BIT)) {
+        return false;
+    }
+
+    unsigned long DSFC = bit64_extract(iss, ESR_ISS_DA_DSFC_OFF, ESR_ISS_DA_DSFC_LEN) & (0xf << 2);
+    if (DSFC != ESR_ISS_DA_DSFC_TRNSLT && DSFC != ESR_ISS_DA_DSFC_PERMIS) {
+        return false;
+    }
+
+    unsigned long srt = bit64_extract(iss, ESR_ISS_DA_SRT_OFF, ESR_ISS_DA_SRT_LEN);
+    if (!VCPU_REG_CALLER_SAVED(srt)) {
+        return false;
+    }
+
+    return aborts_data_emulate(iss, aborts_fault_addr(), il);
+}
+
+/**
+ * Entered from the lower EL synchronous vector with only the guest's caller-saved registers in the
+ * vcpu register file (see VM_EXIT_CALLER_SAVED). Handles HC_IPC hypercalls and data aborts on
+ * emulated regions whose transfer register was saved, which need no further vcpu state. Anything
+ * else is declined without side effects so the caller can complete the spill and take the full
+ * aborts_sync_handler path.
+ */
+bool aborts_sync_fast_handler()
+{
+    uint64_t start = stats_start();
+    unsigned long esr = sysreg_esr_el2_read();
+    unsigned long ec = bit64_extract(esr, ESR_EC_OFF, ESR_EC_LEN);
+    unsigned long il = bit64_extract(esr, ESR_IL_OFF, ESR_IL_LEN);
+    unsigned long iss = bit64_extract(esr, ESR_ISS_OFF, ESR_ISS_LEN);
+    bool handled = false;
+
+    if (ec == ESR_EC_HVC64) {
+        handled = aborts_fast_hvc();
+    } else if (ec == ESR_EC_DALEL) {
+        handled = aborts_fast_data(iss, il);
+    }
+
+    if (handled) {
+        stats_record(cpu()->vcpu, STATS_EXIT(ec), start);
+    }
+
+    return handled;
+}
@@ -75,6 +75,7 @@ SYSREG_GEN_ACCESSORS(cntvoff_el2);
 SYSREG_GEN_ACCESSORS(sctlr_el1);
 SYSREG_GEN_ACCESSORS(cntkctl_el1);
 SYSREG_GEN_ACCESSORS(cntfrq_el0);
+SYSREG_GEN_ACCESSORS(cntpct_el0);
 SYSREG_GEN_ACCESSORS(pmcr_el0);
 SYSREG_GEN_ACCESSORS(par_el1);
 SYSREG_GEN_ACCESSORS(tcr_el2);
@@ -85,6 +86,7 @@ SYSREG_GEN_ACCESSORS(hcr_el2);
 SYSREG_GEN_ACCESSORS(vtcr_el2);
 SYSREG_GEN_ACCESSORS(vttbr_el2);
 SYSREG_GEN_ACCESSORS(id_aa64mmfr0_el1);
+SYSREG_GEN_ACCESSORS(id_aa64isar0_el1);
 SYSREG_GEN_ACCESSORS(tpidr_el2);
 SYSREG_GEN_ACCESSORS(vsctlr_el2);
 SYSREG_GEN_ACCESSORS(mpuir_el2);
@@ -158,6 +160,35 @@ static inline void arm_tlbi_ipas2e1is(vaddr_t vaddr)
     asm volatile("tlbi ipas2e1is, %0" ::"r"(vaddr >> 12));
 }
 
+static inline void arm_tlbi_vmalle1is()
+{
+    asm volatile("tlbi vmalle1is");
+}
+
+/**
+ * The range operations are only available from Armv8.4. They are encoded as sys instructions so
+ * that they do not depend on the assembler supporting the extension.
+ */
+
+#define ID_AA64ISAR0_TLB_OFF   (56)
+#define ID_AA64ISAR0_TLB_MSK   (0xfULL << ID_AA64ISAR0_TLB_OFF)
+#define ID_AA64ISAR0_TLB_RANGE (0x2ULL << ID_AA64ISAR0_TLB_OFF)
+
+static inline bool arm_tlbi_range_supported()
+{
+    return (sysreg_id_aa64isar0_el1_read() & ID_AA64ISAR0_TLB_MSK) >= ID_AA64ISAR0_TLB_RANGE;
+}
+
+static inline void arm_tlbi_rvae2is(uint64_t range)
+{
+    asm volatile("sys #4, c8, c2, #1, %0" ::"r"(range)); // tlbi rvae2is
+}
+
+static inline void arm_tlbi_ripas2e1is(uint64_t range)
+{
+    asm volatile("sys #4, c8, c0, #2, %0" ::"r"(range)); // tlbi ripas2e1is
+}
+
 #endif /* |__ASSEMBLER__ */
 
 #endif /* __ARCH_SYSREGS_H__ */
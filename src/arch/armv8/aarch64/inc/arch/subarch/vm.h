@@ -14,4 +14,10 @@ struct arch_regs {
     uint64_t spsr_el2;
 } __attribute__((aligned(16))); // makes size always aligned to 16 to respect stack alignment
 
+/**
+ * Registers valid in the vcpu register file during the synchronous exit fast path, i.e., the ones
+ * the AAPCS64 allows C code to clobber. Register 31 is the zero register.
+ */
+#define VCPU_REG_CALLER_SAVED(reg) (((reg) <= 18) || ((reg) >= 30))
+
 #endif                          /* VM_SUBARCH_H */
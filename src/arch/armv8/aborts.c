@@ -8,14 +8,36 @@
 #include <arch/smcc.h>
 #include <cpu.h>
 #include <vm.h>
+#include <stats.h>
 #include <emul.h>
 #include <config.h>
 #include <hypercall.h>
 
 typedef void (*abort_handler_t)(unsigned long, unsigned long, unsigned long, unsigned long);
 
+/**
+ * Guest regions might have been evicted from the mpu to make room for others. If the faulting
+ * address belongs to one of them, map it back and let the guest retry the access. Emulated
+ * regions are never in the vmpu, so their accesses skip the vmpu lookup and its lock.
+ */
+static bool aborts_refill(unsigned long iss, unsigned long far)
+{
+#ifdef MEM_PROT_MPU
+    unsigned long FSC = bit64_extract(iss, ESR_ISS_DA_DSFC_OFF, ESR_ISS_DA_DSFC_LEN) & (0xf << 2);
+    if ((FSC == ESR_ISS_DA_DSFC_TRNSLT) && !(iss & ESR_ISS_DA_FnV_BIT) &&
+        (vm_emul_get_mem(cpu()->vcpu->vm, far) == NULL)) {
+        return mem_vmpu_refill(&cpu()->vcpu->vm->as, far);
+    }
+#endif
+    return false;
+}
+
 void aborts_data_lower(unsigned long iss, unsigned long far, unsigned long il, unsigned long ec)
 {
+    if (aborts_refill(iss, far)) {
+        return;
+    }
+
     if (!(iss & ESR_ISS_DA_ISV_BIT) || (iss & ESR_ISS_DA_FnV_BIT)) {
         ERROR("no information to handle data abort (0x%x)", far);
     }
@@ -26,7 +48,20 @@ void aborts_data_lower(unsigned long iss, unsigned long far, unsigned long il, u
         ERROR("data abort is not translation fault - cant deal with it");
     }
 
-    vaddr_t addr = far;
+    if (!aborts_data_emulate(iss, far, il)) {
+        ERROR("no emulation handler for abort(0x%x at 0x%x)", far, vcpu_readpc(cpu()->vcpu));
+    }
+}
+
+void aborts_instr_lower(unsigned long iss, unsigned long far, unsigned long il, unsigned long ec)
+{
+    if (!aborts_refill(iss, far)) {
+        ERROR("instruction abort (0x%x at 0x%x)", far, vcpu_readpc(cpu()->vcpu));
+    }
+}
+
+bool aborts_data_emulate(unsigned long iss, vaddr_t addr, unsigned long il)
+{
     emul_handler_t handler = vm_emul_get_mem(cpu()->vcpu->vm, addr);
     if (handler != NULL) {
         struct emul_access emul;
@@ -43,11 +78,12 @@ void aborts_data_lower(unsigned long iss, unsigned long far, unsigned long il, u
             unsigned long pc_step = 2 + (2 * il);
             vcpu_writepc(cpu()->vcpu, vcpu_readpc(cpu()->vcpu) + pc_step);
         } else {
-            ERROR("data abort emulation failed (0x%x)", far);
+            ERROR("data abort emulation failed (0x%x)", addr);
         }
-    } else {
-        ERROR("no emulation handler for abort(0x%x at 0x%x)", far, vcpu_readpc(cpu()->vcpu));
+        return true;
     }
+
+    return false;
 }
 
 long int standard_service_call(unsigned long _fn_num)
@@ -151,6 +187,7 @@ void sysreg_handler(unsigned long iss, unsigned long far, unsigned long il, unsi
 }
 
 abort_handler_t abort_handlers[64] = {
+    [ESR_EC_IALEL] = aborts_instr_lower,
     [ESR_EC_DALEL] = aborts_data_lower,
     [ESR_EC_SMC32] = smc_handler,
     [ESR_EC_SMC64] = smc_handler,
@@ -161,18 +198,23 @@ abort_handler_t abort_handlers[64] = {
     [ESR_EC_HVC64] = hvc_handler,
 };
 
-void aborts_sync_handler()
+vaddr_t aborts_fault_addr()
 {
-    unsigned long esr = sysreg_esr_el2_read();
     unsigned long far = sysreg_far_el2_read();
     unsigned long hpfar = sysreg_hpfar_el2_read();
-    unsigned long ipa_fault_addr = 0;
 
     if (DEFINED(MEM_PROT_MMU) || cpu()->vcpu->vm->config->platform.mmu) {
-        ipa_fault_addr = (far & 0xFFF) | (hpfar << 8);
+        return (far & 0xFFF) | (hpfar << 8);
     } else {
-        ipa_fault_addr = far;
+        return far;
     }
+}
+
+void aborts_sync_handler()
+{
+    uint64_t start = stats_start();
+    unsigned long esr = sysreg_esr_el2_read();
+    unsigned long ipa_fault_addr = aborts_fault_addr();
 
     unsigned long ec = bit64_extract(esr, ESR_EC_OFF, ESR_EC_LEN);
     unsigned long il = bit64_extract(esr, ESR_IL_OFF, ESR_IL_LEN);
@@ -184,4 +226,6 @@ void aborts_sync_handler()
     } else {
         ERROR("no handler for abort ec = 0x%x", ec); // unknown guest exception
     }
+
+    stats_record(cpu()->vcpu, STATS_EXIT(ec), start);
 }
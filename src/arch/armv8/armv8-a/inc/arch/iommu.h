@@ -7,7 +7,17 @@
 #define __IOMMU_ARCH_H__
 
 #include <bao.h>
+
+#define SMMUV2 (2)
+#define SMMUV3 (3)
+
+#if (SMMU_VERSION == SMMUV2)
 #include <arch/smmuv2.h>
+#elif (SMMU_VERSION == SMMUV3)
+#include <arch/smmuv3.h>
+#else
+#error "unknown SMMU version " SMMU_VERSION
+#endif
 
 struct iommu_vm_arch {
     streamid_t global_mask;
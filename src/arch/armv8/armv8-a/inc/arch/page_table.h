@@ -169,6 +169,11 @@ static inline paddr_t pte_addr(pte_t* pte)
     return (paddr_t)(*pte & PTE_ADDR_MSK);
 }
 
+static inline pte_flags_t pte_flags(pte_t* pte)
+{
+    return (pte_flags_t)(*pte & PTE_FLAGS_MSK & ~PTE_TYPE_MSK);
+}
+
 #endif /* |__ASSEMBLER__ */
 
 #endif /* __ARCH_PAGE_TABLE_H__ */
@@ -39,6 +39,9 @@
 #define SMMUV2_IDR7_MAJOR_OFF           (4)
 #define SMMUV2_IDR7_MAJOR_LEN           (4)
 
+#define SMMUV2_TLBIVMID_VMID_MSK        BIT32_MASK(0, 16)
+#define SMMUV2_TLBGSTATUS_GSACTIVE      (0x1 << 0)
+
 #define SMMU_SMR_ID_OFF                 0
 #define SMMU_SMR_ID_LEN                 15
 #define SMMU_SMR_ID(smr)                bit32_extract(smr, SMMU_SMR_ID_OFF, SMMU_SMR_ID_LEN)
@@ -383,5 +386,6 @@ streamid_t smmu_sme_get_id(size_t sme);
 streamid_t smmu_sme_get_mask(size_t sme);
 bool smmu_sme_is_group(size_t sme);
 bool smmu_compatible_sme_exists(streamid_t mask, streamid_t id, size_t ctx, bool group);
+void smmu_inv_vmid(asid_t vm_id);
 
 #endif
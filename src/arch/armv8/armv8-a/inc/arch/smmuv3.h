@@ -0,0 +1,184 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __ARCH_SMMUV3_H__
+#define __ARCH_SMMUV3_H__
+
+#include <bao.h>
+
+#define SMMUV3_IDR0_S2P_BIT             (0x1UL << 0)
+#define SMMUV3_IDR0_TTF_OFF             (2)
+#define SMMUV3_IDR0_TTF_LEN             (2)
+#define SMMUV3_IDR0_TTF_AARCH64         (0x2)
+#define SMMUV3_IDR0_COHACC_BIT          (0x1UL << 4)
+#define SMMUV3_IDR0_BTM_BIT             (0x1UL << 5)
+#define SMMUV3_IDR0_HYP_BIT             (0x1UL << 9)
+#define SMMUV3_IDR0_VMID16_BIT          (0x1UL << 18)
+#define SMMUV3_IDR0_ST_LEVEL_OFF        (27)
+#define SMMUV3_IDR0_ST_LEVEL_LEN        (2)
+
+#define SMMUV3_IDR1_SIDSIZE_OFF         (0)
+#define SMMUV3_IDR1_SIDSIZE_LEN         (6)
+#define SMMUV3_IDR1_CMDQS_OFF           (21)
+#define SMMUV3_IDR1_CMDQS_LEN           (5)
+#define SMMUV3_IDR1_TABLES_PRESET_BIT   (0x1UL << 30)
+#define SMMUV3_IDR1_QUEUES_PRESET_BIT   (0x1UL << 29)
+
+#define SMMUV3_IDR5_OAS_OFF             (0)
+#define SMMUV3_IDR5_OAS_LEN             (3)
+#define SMMUV3_IDR5_GRAN4K_BIT          (0x1UL << 4)
+
+#define SMMUV3_AIDR_MAJOR_OFF           (4)
+#define SMMUV3_AIDR_MAJOR_LEN           (4)
+
+#define SMMUV3_CR0_SMMUEN               (0x1UL << 0)
+#define SMMUV3_CR0_EVTQEN               (0x1UL << 2)
+#define SMMUV3_CR0_CMDQEN               (0x1UL << 3)
+
+#define SMMUV3_CR1_QUEUE_IC_OFF         (0)
+#define SMMUV3_CR1_QUEUE_OC_OFF         (2)
+#define SMMUV3_CR1_QUEUE_SH_OFF         (4)
+#define SMMUV3_CR1_TABLE_IC_OFF         (6)
+#define SMMUV3_CR1_TABLE_OC_OFF         (8)
+#define SMMUV3_CR1_TABLE_SH_OFF         (10)
+#define SMMUV3_CR1_WB                   (0x1UL)
+#define SMMUV3_CR1_ISH                  (0x3UL)
+#define SMMUV3_CR1_CACHEABLE                                                    \
+    ((SMMUV3_CR1_WB << SMMUV3_CR1_QUEUE_IC_OFF) |                               \
+        (SMMUV3_CR1_WB << SMMUV3_CR1_QUEUE_OC_OFF) |                            \
+        (SMMUV3_CR1_ISH << SMMUV3_CR1_QUEUE_SH_OFF) |                           \
+        (SMMUV3_CR1_WB << SMMUV3_CR1_TABLE_IC_OFF) |                            \
+        (SMMUV3_CR1_WB << SMMUV3_CR1_TABLE_OC_OFF) | (SMMUV3_CR1_ISH << SMMUV3_CR1_TABLE_SH_OFF))
+
+#define SMMUV3_CR2_RECINVSID            (0x1UL << 1)
+#define SMMUV3_CR2_PTM                  (0x1UL << 2)
+
+#define SMMUV3_GBPA_UPDATE              (0x1UL << 31)
+#define SMMUV3_GBPA_ABORT               (0x1UL << 20)
+
+#define SMMUV3_GERROR_CMDQ_ERR          (0x1UL << 0)
+
+#define SMMUV3_STRTAB_BASE_RA           (0x1ULL << 62)
+#define SMMUV3_STRTAB_BASE_ADDR_MSK     BIT64_MASK(6, 46)
+#define SMMUV3_STRTAB_BASE_CFG_LINEAR   (0x0UL << 16)
+#define SMMUV3_STRTAB_BASE_CFG_LOG2SIZE(N) ((N) & 0x3f)
+
+#define SMMUV3_CMDQ_BASE_RA             (0x1ULL << 62)
+#define SMMUV3_CMDQ_BASE_ADDR_MSK       BIT64_MASK(5, 47)
+#define SMMUV3_CMDQ_BASE_LOG2SIZE(N)    ((N) & 0x1f)
+#define SMMUV3_CMDQ_CONS_ERR_OFF        (24)
+#define SMMUV3_CMDQ_CONS_ERR_LEN        (7)
+
+/* Stream table entry */
+
+#define SMMUV3_STE_DWORDS               (8)
+#define SMMUV3_STE_0_V                  (0x1ULL << 0)
+#define SMMUV3_STE_0_CFG_ABORT          (0x0ULL << 1)
+#define SMMUV3_STE_0_CFG_S2_TRANS       (0x6ULL << 1)
+#define SMMUV3_STE_1_SHCFG_INCOMING     (0x1ULL << 44)
+#define SMMUV3_STE_2_S2VMID(VMID)       ((uint64_t)(VMID)&0xffff)
+#define SMMUV3_STE_2_S2T0SZ(SZ)         (((uint64_t)(SZ)&0x3f) << 32)
+#define SMMUV3_STE_2_S2SL0(SL0)         (((uint64_t)(SL0)&0x3) << 38)
+#define SMMUV3_STE_2_S2SL0_0            SMMUV3_STE_2_S2SL0(0x2)
+#define SMMUV3_STE_2_S2SL0_1            SMMUV3_STE_2_S2SL0(0x1)
+#define SMMUV3_STE_2_S2IR0_WB_RA_WA     (0x1ULL << 40)
+#define SMMUV3_STE_2_S2OR0_WB_RA_WA     (0x1ULL << 42)
+#define SMMUV3_STE_2_S2SH0_IS           (0x3ULL << 44)
+#define SMMUV3_STE_2_S2TG_4K            (0x0ULL << 46)
+#define SMMUV3_STE_2_S2PS(PS)           (((uint64_t)(PS)&0x7) << 48)
+#define SMMUV3_STE_2_S2AA64             (0x1ULL << 51)
+#define SMMUV3_STE_2_S2R                (0x1ULL << 58)
+#define SMMUV3_STE_3_S2TTB_MSK          BIT64_MASK(4, 48)
+
+/* Commands */
+
+#define SMMUV3_CMD_DWORDS               (2)
+#define SMMUV3_CMD_OPCODE(OP)           ((uint64_t)(OP)&0xff)
+#define SMMUV3_CMD_CFGI_STE             (0x03)
+#define SMMUV3_CMD_CFGI_ALL             (0x04)
+#define SMMUV3_CMD_TLBI_EL2_ALL         (0x20)
+#define SMMUV3_CMD_TLBI_S12_VMALL       (0x28)
+#define SMMUV3_CMD_TLBI_S2_IPA          (0x2a)
+#define SMMUV3_CMD_TLBI_NSNH_ALL        (0x30)
+#define SMMUV3_CMD_SYNC                 (0x46)
+#define SMMUV3_CMD_0_SID(SID)           ((uint64_t)(SID) << 32)
+#define SMMUV3_CMD_0_VMID(VMID)         (((uint64_t)(VMID)&0xffff) << 32)
+#define SMMUV3_CMD_1_LEAF               (0x1ULL << 0)
+#define SMMUV3_CMD_1_CFGI_ALL_RANGE     (0x1fULL)
+#define SMMUV3_CMD_1_ADDR_MSK           BIT64_MASK(12, 40)
+#define SMMUV3_CMD_0_SYNC_CS_NONE       (0x0ULL << 12)
+#define SMMUV3_CMD_0_SYNC_MSH_IS        (0x3ULL << 22)
+
+struct smmuv3_hw {
+    uint32_t IDR0;
+    uint32_t IDR1;
+    uint32_t IDR2;
+    uint32_t IDR3;
+    uint32_t IDR4;
+    uint32_t IDR5;
+    uint32_t IIDR;
+    uint32_t AIDR;
+    uint32_t CR0;
+    uint32_t CR0ACK;
+    uint32_t CR1;
+    uint32_t CR2;
+    uint8_t pad1[0x40 - 0x30];
+    uint32_t STATUSR;
+    uint32_t GBPA;
+    uint32_t AGBPA;
+    uint8_t pad2[0x50 - 0x4c];
+    uint32_t IRQ_CTRL;
+    uint32_t IRQ_CTRLACK;
+    uint8_t pad3[0x60 - 0x58];
+    uint32_t GERROR;
+    uint32_t GERRORN;
+    uint64_t GERROR_IRQ_CFG0;
+    uint32_t GERROR_IRQ_CFG1;
+    uint32_t GERROR_IRQ_CFG2;
+    uint8_t pad4[0x80 - 0x78];
+    uint64_t STRTAB_BASE;
+    uint32_t STRTAB_BASE_CFG;
+    uint8_t pad5[0x90 - 0x8c];
+    uint64_t CMDQ_BASE;
+    uint32_t CMDQ_PROD;
+    uint32_t CMDQ_CONS;
+    uint64_t EVENTQ_BASE;
+    uint32_t EVENTQ_PROD;
+    uint32_t EVENTQ_CONS;
+    uint8_t res[];
+} __attribute__((__packed__, __aligned__(PAGE_SIZE)));
+
+struct smmuv3_cmd {
+    uint64_t dw[SMMUV3_CMD_DWORDS];
+};
+
+/**
+ * Commands are accumulated in a batch and only handed to the smmu when the batch is submitted,
+ * followed by a single CMD_SYNC. A batch that fills up is submitted on its own.
+ */
+#define SMMUV3_CMD_BATCH_MAX (32)
+
+/**
+ * Ranges spanning more pages than this are invalidated with a single TLBI_S12_VMALL instead of one
+ * TLBI_S2_IPA per page.
+ */
+#define SMMUV3_TLBI_RANGE_MAX_PAGES (SMMUV3_CMD_BATCH_MAX)
+
+struct smmuv3_cmd_batch {
+    size_t num;
+    struct smmuv3_cmd cmds[SMMUV3_CMD_BATCH_MAX];
+};
+
+typedef deviceid_t streamid_t;
+
+void smmuv3_init();
+
+void smmuv3_batch_add(struct smmuv3_cmd_batch* batch, struct smmuv3_cmd cmd);
+void smmuv3_batch_submit(struct smmuv3_cmd_batch* batch);
+
+bool smmuv3_attach(streamid_t mask, streamid_t id, paddr_t root_pt, asid_t vm_id);
+void smmuv3_inv_range(asid_t vm_id, vaddr_t ipa, size_t size);
+
+#endif /* __ARCH_SMMUV3_H__ */
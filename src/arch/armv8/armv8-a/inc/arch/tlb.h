@@ -10,6 +10,63 @@
 #include <arch/sysregs.h>
 #include <arch/fences.h>
 
+/**
+ * Range TLBI operand for 4K granules. Each operation covers (NUM + 1) * 2^(5 * SCALE + 1) pages
+ * starting at BaseADDR.
+ */
+#define TLBI_RANGE_TG_4K         (0x1ULL << 46)
+#define TLBI_RANGE_SCALE_OFF     (44)
+#define TLBI_RANGE_NUM_OFF       (39)
+#define TLBI_RANGE_NUM_MAX       (0x1f)
+#define TLBI_RANGE_BADDR_MSK     BIT64_MASK(0, 37)
+#define TLBI_RANGE_PAGES(S, N)   ((size_t)((N) + 1) << ((5 * (S)) + 1))
+#define TLBI_RANGE_MAX_PAGES     TLBI_RANGE_PAGES(3, TLBI_RANGE_NUM_MAX)
+
+/**
+ * Above this many pages per-page invalidations cost more than dropping all the translations of
+ * the address space.
+ */
+#define TLB_INV_RANGE_MAX_PAGES  (512)
+
+static inline uint64_t tlbi_range_op(vaddr_t va, size_t scale, size_t num)
+{
+    return TLBI_RANGE_TG_4K | ((uint64_t)scale << TLBI_RANGE_SCALE_OFF) |
+        ((uint64_t)num << TLBI_RANGE_NUM_OFF) | ((va >> 12) & TLBI_RANGE_BADDR_MSK);
+}
+
+static inline bool tlb_inv_range_all(size_t num_pages, bool range)
+{
+    return range ? (num_pages >= TLBI_RANGE_MAX_PAGES) : (num_pages > TLB_INV_RANGE_MAX_PAGES);
+}
+
+/**
+ * Issue the minimum number of invalidations covering num_pages from va, without any barriers.
+ * Odd page counts are trimmed one page at a time and the rest is covered with range operations of
+ * increasing scale.
+ */
+static inline void tlb_inv_range_ops(vaddr_t va, size_t num_pages, bool range,
+    void (*inv_va)(vaddr_t), void (*inv_range)(uint64_t))
+{
+    size_t scale = 0;
+
+    while (num_pages > 0) {
+        if (!range || (num_pages % 2) != 0) {
+            inv_va(va);
+            va += PAGE_SIZE;
+            num_pages--;
+            continue;
+        }
+
+        size_t num = (num_pages >> ((5 * scale) + 1)) & TLBI_RANGE_NUM_MAX;
+        if (num > 0) {
+            inv_range(tlbi_range_op(va, scale, num - 1));
+            va += TLBI_RANGE_PAGES(scale, num - 1) * PAGE_SIZE;
+            num_pages -= TLBI_RANGE_PAGES(scale, num - 1);
+        }
+        scale++;
+    }
+}
+
 static inline void tlb_hyp_inv_va(vaddr_t va)
 {
     DSB(ish);
@@ -26,6 +83,22 @@ static inline void tlb_hyp_inv_all()
     ISB();
 }
 
+static inline void tlb_hyp_inv_range(vaddr_t va, size_t size)
+{
+    vaddr_t base = va & ~(PAGE_SIZE - 1);
+    size_t num_pages = NUM_PAGES(va + size - base);
+    bool range = arm_tlbi_range_supported();
+
+    DSB(ish);
+    if (tlb_inv_range_all(num_pages, range)) {
+        arm_tlbi_alle2is();
+    } else {
+        tlb_inv_range_ops(base, num_pages, range, arm_tlbi_vae2is, arm_tlbi_rvae2is);
+    }
+    DSB(ish);
+    ISB();
+}
+
 static inline void tlb_vm_inv_va(asid_t vmid, vaddr_t va)
 {
     uint64_t vttbr = 0;
@@ -42,7 +115,7 @@ static inline void tlb_vm_inv_va(asid_t vmid, vaddr_t va)
 
     if (switch_vmid) {
         DSB(ish);
-        sysreg_vttbr_el2_write(((uint64_t)vmid << VTTBR_VMID_OFF) & VTTBR_VMID_MSK);
+        sysreg_vttbr_el2_write(vttbr);
     }
 }
 
@@ -62,8 +135,42 @@ static inline void tlb_vm_inv_all(asid_t vmid)
 
     if (switch_vmid) {
         DSB(ish);
+        sysreg_vttbr_el2_write(vttbr);
+    }
+}
+
+static inline void tlb_vm_inv_range(asid_t vmid, vaddr_t va, size_t size)
+{
+    vaddr_t base = va & ~(PAGE_SIZE - 1);
+    size_t num_pages = NUM_PAGES(va + size - base);
+    bool range = arm_tlbi_range_supported();
+    uint64_t vttbr = 0;
+    vttbr = sysreg_vttbr_el2_read();
+    bool switch_vmid = bit64_extract(vttbr, VTTBR_VMID_OFF, VTTBR_VMID_LEN) != vmid;
+
+    DSB(ish);
+    if (switch_vmid) {
         sysreg_vttbr_el2_write(((uint64_t)vmid << VTTBR_VMID_OFF) & VTTBR_VMID_MSK);
+        ISB();
+    }
+
+    if (tlb_inv_range_all(num_pages, range)) {
+        arm_tlbi_vmalls12e1is();
+    } else {
+        /**
+         * Stage 2 invalidations by IPA do not affect combined stage 1 and 2 entries, so those are
+         * dropped for the whole VMID once all the IPA invalidations have completed.
+         */
+        tlb_inv_range_ops(base, num_pages, range, arm_tlbi_ipas2e1is, arm_tlbi_ripas2e1is);
+        DSB(ish);
+        arm_tlbi_vmalle1is();
+    }
+    DSB(ish);
+
+    if (switch_vmid) {
+        sysreg_vttbr_el2_write(vttbr);
     }
+    ISB();
 }
 
 #endif /* __ARCH_TLB_H__ */
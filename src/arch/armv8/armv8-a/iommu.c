@@ -12,13 +12,30 @@
 bool iommu_arch_init()
 {
     if (cpu_is_master() && platform.arch.smmu.base) {
+#if (SMMU_VERSION == SMMUV3)
+        smmuv3_init();
+#else
         smmu_init();
+#endif
         return true;
     }
 
     return false;
 }
 
+#if (SMMU_VERSION == SMMUV3)
+
+static bool iommu_vm_arch_add(struct vm* vm, streamid_t mask, streamid_t id)
+{
+    /* Streams share the vm's stage 2 page tables as its cpus do. */
+    paddr_t rootpt;
+    mem_translate(&cpu()->as, (vaddr_t)vm->as.pt.root, &rootpt);
+
+    return smmuv3_attach(mask | vm->io.prot.mmu.global_mask, id, rootpt, vm->id);
+}
+
+#else
+
 static ssize_t iommu_vm_arch_init_ctx(struct vm* vm)
 {
     ssize_t ctx_id = vm->io.prot.mmu.ctx_id;
@@ -64,6 +81,26 @@ static bool iommu_vm_arch_add(struct vm* vm, streamid_t mask, streamid_t id)
     return true;
 }
 
+#endif
+
+void iommu_arch_vm_inv_range(asid_t vm_id, vaddr_t va, size_t size)
+{
+#if (SMMU_VERSION == SMMUV3)
+    smmuv3_inv_range(vm_id, va, size);
+#else
+    smmu_inv_vmid(vm_id);
+#endif
+}
+
+void iommu_arch_vm_inv_all(asid_t vm_id)
+{
+#if (SMMU_VERSION == SMMUV3)
+    smmuv3_inv_range(vm_id, 0, 0);
+#else
+    smmu_inv_vmid(vm_id);
+#endif
+}
+
 inline bool iommu_arch_vm_add_device(struct vm* vm, streamid_t id)
 {
     return iommu_vm_arch_add(vm, 0, id);
@@ -51,6 +51,7 @@ void psci_wake_from_powerdown()
         ERROR("cpu woke up but theres no vcpu to run");
     }
 
+    vgic_vcpu_standby_exit(cpu()->vcpu);
     vcpu_arch_reset(cpu()->vcpu, cpu()->vcpu->arch.psci_ctx.entrypoint);
     vcpu_writereg(cpu()->vcpu, 0, cpu()->vcpu->arch.psci_ctx.context_id);
     vcpu_run(cpu()->vcpu);
@@ -33,6 +33,8 @@ struct smmu_priv {
     spinlock_t ctx_lock;
     size_t ctx_num;
     BITMAP_ALLOC(ctxbank_bitmap, CTX_MAX_NUM);
+
+    spinlock_t tlb_lock;
 };
 
 struct smmu_priv smmu;
@@ -157,6 +159,8 @@ void smmu_init()
     bitmap_clear_consecutive(smmu.sme_bitmap, 0, smmu.sme_num);
     bitmap_clear_consecutive(smmu.grp_bitmap, 0, smmu.sme_num);
 
+    smmu.tlb_lock = SPINLOCK_INITVAL;
+
     /* Clear random reset state. */
     smmu.hw.glbl_rs0->GFSR = smmu.hw.glbl_rs0->GFSR;
     smmu.hw.glbl_rs0->NSGFSR = smmu.hw.glbl_rs0->NSGFSR;
@@ -344,3 +348,21 @@ void smmu_write_s2c(size_t sme, size_t ctx_id)
     }
     spin_unlock(&smmu.sme_lock);
 }
+
+/**
+ * Invalidate all the tlb entries tagged with vm_id and wait for the invalidation to complete. The
+ * smmuv2 has no per-address stage 2 invalidation outside of the context banks, so the whole vmid
+ * is dropped.
+ */
+void smmu_inv_vmid(asid_t vm_id)
+{
+    if (smmu.hw.glbl_rs0 == NULL) {
+        return;
+    }
+
+    spin_lock(&smmu.tlb_lock);
+    smmu.hw.glbl_rs0->TLBIVMID = vm_id & SMMUV2_TLBIVMID_VMID_MSK;
+    smmu.hw.glbl_rs0->TLBGSYNC = 0;
+    while (smmu.hw.glbl_rs0->TLBGSTATUS & SMMUV2_TLBGSTATUS_GSACTIVE) { }
+    spin_unlock(&smmu.tlb_lock);
+}
@@ -0,0 +1,386 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <arch/smmuv3.h>
+#include <arch/spinlock.h>
+#include <bit.h>
+#include <arch/sysregs.h>
+#include <platform.h>
+#include <cpu.h>
+#include <mem.h>
+#include <cache.h>
+#include <fences.h>
+#include <string.h>
+
+/**
+ * Only a linear stream table is supported, so its size is capped regardless of how many stream id
+ * bits the smmu implements.
+ */
+#define SMMUV3_STRTAB_MAX_LOG2SIZE (8)
+#define SMMUV3_CMDQ_MAX_LOG2SIZE   (8)
+
+struct smmuv3_priv {
+    volatile struct smmuv3_hw* hw;
+    bool coherent;
+
+    struct {
+        spinlock_t lock;
+        volatile uint64_t* base;
+        size_t log2size;
+    } strtab;
+
+    struct {
+        spinlock_t lock;
+        volatile struct smmuv3_cmd* base;
+        size_t log2size;
+        uint32_t prod;
+    } cmdq;
+};
+
+struct smmuv3_priv smmuv3;
+
+static void smmuv3_check_features()
+{
+    unsigned version =
+        bit32_extract(smmuv3.hw->AIDR, SMMUV3_AIDR_MAJOR_OFF, SMMUV3_AIDR_MAJOR_LEN);
+    if (version != 0) {
+        ERROR("smmu unsupported architecture version: 3.%d", version);
+    }
+
+    if (!(smmuv3.hw->IDR0 & SMMUV3_IDR0_S2P_BIT)) {
+        ERROR("smmuv3 does not support 2nd stage translation");
+    }
+
+    if (!(bit32_extract(smmuv3.hw->IDR0, SMMUV3_IDR0_TTF_OFF, SMMUV3_IDR0_TTF_LEN) &
+            SMMUV3_IDR0_TTF_AARCH64)) {
+        ERROR("smmuv3 does not support aarch64 translation tables");
+    }
+
+    if (!(smmuv3.hw->IDR5 & SMMUV3_IDR5_GRAN4K_BIT)) {
+        ERROR("smmuv3 does not support 4kb page granule");
+    }
+
+    if (smmuv3.hw->IDR1 & (SMMUV3_IDR1_TABLES_PRESET_BIT | SMMUV3_IDR1_QUEUES_PRESET_BIT)) {
+        ERROR("smmuv3 with fixed table or queue base addresses not supported");
+    }
+
+    size_t pasize = bit32_extract(smmuv3.hw->IDR5, SMMUV3_IDR5_OAS_OFF, SMMUV3_IDR5_OAS_LEN);
+    if (pasize < parange) {
+        ERROR("smmuv3 does not support the full available pa range");
+    }
+
+    /**
+     * TODO: as for smmuv2, vms sharing their page tables with a non-coherent smmu would need
+     * software-managed coherency for page table updates.
+     */
+    smmuv3.coherent = !!(smmuv3.hw->IDR0 & SMMUV3_IDR0_COHACC_BIT);
+    if (!smmuv3.coherent) {
+        WARNING("smmuv3 does not support coherent accesses");
+    }
+
+    /**
+     * Without broadcast tlb maintenance the smmu tlbs are only invalidated when a device is
+     * attached, i.e., after the vm's address space is built.
+     */
+    if (!(smmuv3.hw->IDR0 & SMMUV3_IDR0_BTM_BIT)) {
+        WARNING("smmuv3 does not support tlb maintenance broadcast");
+    }
+}
+
+static void smmuv3_sync_to_smmu(volatile void* addr, size_t size)
+{
+    if (!smmuv3.coherent) {
+        cache_flush_range((vaddr_t)addr, size);
+    }
+}
+
+static void smmuv3_write_cr0(uint32_t cr0)
+{
+    smmuv3.hw->CR0 = cr0;
+    while (smmuv3.hw->CR0ACK != cr0) { }
+}
+
+static inline uint32_t smmuv3_cmdq_used(uint32_t prod, uint32_t cons)
+{
+    uint32_t wrap_mask = (2UL << smmuv3.cmdq.log2size) - 1;
+    return (prod - cons) & wrap_mask;
+}
+
+static void smmuv3_cmdq_check_error()
+{
+    if ((smmuv3.hw->GERROR ^ smmuv3.hw->GERRORN) & SMMUV3_GERROR_CMDQ_ERR) {
+        ERROR("smmuv3 command queue error %d",
+            bit32_extract(smmuv3.hw->CMDQ_CONS, SMMUV3_CMDQ_CONS_ERR_OFF,
+                SMMUV3_CMDQ_CONS_ERR_LEN));
+    }
+}
+
+/**
+ * Write num commands followed by a CMD_SYNC to the command queue, publish them with a single
+ * producer index update and wait for the smmu to consume the sync, i.e., for all of them to
+ * complete. Batches larger than the queue can hold next to their sync are split in as many
+ * submissions as needed.
+ */
+static void smmuv3_cmdq_submit(struct smmuv3_cmd* cmds, size_t num)
+{
+    size_t qsize = 1UL << smmuv3.cmdq.log2size;
+    uint32_t wrap_mask = (2UL << smmuv3.cmdq.log2size) - 1;
+    struct smmuv3_cmd sync = { .dw = { SMMUV3_CMD_OPCODE(SMMUV3_CMD_SYNC) |
+                                           SMMUV3_CMD_0_SYNC_CS_NONE | SMMUV3_CMD_0_SYNC_MSH_IS,
+        0 } };
+
+    spin_lock(&smmuv3.cmdq.lock);
+
+    do {
+        size_t n = min(num, qsize - 1);
+
+        uint32_t prod = smmuv3.cmdq.prod;
+        while (smmuv3_cmdq_used(prod, smmuv3.hw->CMDQ_CONS) > (qsize - (n + 1))) {
+            smmuv3_cmdq_check_error();
+        }
+
+        for (size_t i = 0; i <= n; i++) {
+            volatile struct smmuv3_cmd* entry = &smmuv3.cmdq.base[prod & (qsize - 1)];
+            struct smmuv3_cmd* cmd = (i < n) ? &cmds[i] : &sync;
+            entry->dw[0] = cmd->dw[0];
+            entry->dw[1] = cmd->dw[1];
+            smmuv3_sync_to_smmu(entry, sizeof(struct smmuv3_cmd));
+            prod = (prod + 1) & wrap_mask;
+        }
+
+        fence_sync_write();
+        smmuv3.hw->CMDQ_PROD = prod;
+        smmuv3.cmdq.prod = prod;
+
+        while (smmuv3_cmdq_used(prod, smmuv3.hw->CMDQ_CONS) != 0) {
+            smmuv3_cmdq_check_error();
+        }
+
+        cmds += n;
+        num -= n;
+    } while (num > 0);
+
+    spin_unlock(&smmuv3.cmdq.lock);
+}
+
+void smmuv3_batch_add(struct smmuv3_cmd_batch* batch, struct smmuv3_cmd cmd)
+{
+    if (batch->num >= SMMUV3_CMD_BATCH_MAX) {
+        smmuv3_batch_submit(batch);
+    }
+    batch->cmds[batch->num++] = cmd;
+}
+
+void smmuv3_batch_submit(struct smmuv3_cmd_batch* batch)
+{
+    if (batch->num > 0) {
+        smmuv3_cmdq_submit(batch->cmds, batch->num);
+        batch->num = 0;
+    }
+}
+
+static inline struct smmuv3_cmd smmuv3_cmd_cfgi_ste(streamid_t sid)
+{
+    return (struct smmuv3_cmd){ .dw = { SMMUV3_CMD_OPCODE(SMMUV3_CMD_CFGI_STE) |
+                                            SMMUV3_CMD_0_SID(sid),
+        SMMUV3_CMD_1_LEAF } };
+}
+
+static inline struct smmuv3_cmd smmuv3_cmd_tlbi_s12_vmall(asid_t vm_id)
+{
+    return (struct smmuv3_cmd){ .dw = { SMMUV3_CMD_OPCODE(SMMUV3_CMD_TLBI_S12_VMALL) |
+                                            SMMUV3_CMD_0_VMID(vm_id),
+        0 } };
+}
+
+static inline struct smmuv3_cmd smmuv3_cmd_tlbi_s2_ipa(asid_t vm_id, vaddr_t ipa)
+{
+    return (struct smmuv3_cmd){ .dw = { SMMUV3_CMD_OPCODE(SMMUV3_CMD_TLBI_S2_IPA) |
+                                            SMMUV3_CMD_0_VMID(vm_id),
+        ipa & SMMUV3_CMD_1_ADDR_MSK } };
+}
+
+static void smmuv3_init_strtab()
+{
+    size_t sidsize = bit32_extract(smmuv3.hw->IDR1, SMMUV3_IDR1_SIDSIZE_OFF,
+        SMMUV3_IDR1_SIDSIZE_LEN);
+    smmuv3.strtab.log2size = min(sidsize, SMMUV3_STRTAB_MAX_LOG2SIZE);
+    smmuv3.strtab.lock = SPINLOCK_INITVAL;
+
+    /* The linear stream table must be aligned to its size. */
+    size_t strtab_size = (1UL << smmuv3.strtab.log2size) * SMMUV3_STE_DWORDS * sizeof(uint64_t);
+    smmuv3.strtab.base =
+        (volatile uint64_t*)mem_alloc_page(NUM_PAGES(strtab_size), SEC_HYP_GLOBAL, true);
+    if (smmuv3.strtab.base == NULL) {
+        ERROR("smmuv3 could not allocate stream table");
+    }
+
+    /* All streams start as invalid, so their transactions are aborted. */
+    memset((void*)smmuv3.strtab.base, 0, strtab_size);
+    smmuv3_sync_to_smmu(smmuv3.strtab.base, strtab_size);
+
+    paddr_t strtab_pa;
+    mem_translate(&cpu()->as, (vaddr_t)smmuv3.strtab.base, &strtab_pa);
+    smmuv3.hw->STRTAB_BASE = SMMUV3_STRTAB_BASE_RA | (strtab_pa & SMMUV3_STRTAB_BASE_ADDR_MSK);
+    smmuv3.hw->STRTAB_BASE_CFG =
+        SMMUV3_STRTAB_BASE_CFG_LINEAR | SMMUV3_STRTAB_BASE_CFG_LOG2SIZE(smmuv3.strtab.log2size);
+}
+
+static void smmuv3_init_cmdq()
+{
+    size_t cmdqs = bit32_extract(smmuv3.hw->IDR1, SMMUV3_IDR1_CMDQS_OFF, SMMUV3_IDR1_CMDQS_LEN);
+    if (cmdqs == 0) {
+        /* At least one command and its CMD_SYNC must fit in the queue */
+        ERROR("smmuv3 command queue too small");
+    }
+    smmuv3.cmdq.log2size = min(cmdqs, SMMUV3_CMDQ_MAX_LOG2SIZE);
+    smmuv3.cmdq.lock = SPINLOCK_INITVAL;
+    smmuv3.cmdq.prod = 0;
+
+    size_t cmdq_size = (1UL << smmuv3.cmdq.log2size) * sizeof(struct smmuv3_cmd);
+    smmuv3.cmdq.base =
+        (volatile struct smmuv3_cmd*)mem_alloc_page(NUM_PAGES(cmdq_size), SEC_HYP_GLOBAL, true);
+    if (smmuv3.cmdq.base == NULL) {
+        ERROR("smmuv3 could not allocate command queue");
+    }
+
+    paddr_t cmdq_pa;
+    mem_translate(&cpu()->as, (vaddr_t)smmuv3.cmdq.base, &cmdq_pa);
+    smmuv3.hw->CMDQ_BASE = SMMUV3_CMDQ_BASE_RA | (cmdq_pa & SMMUV3_CMDQ_BASE_ADDR_MSK) |
+        SMMUV3_CMDQ_BASE_LOG2SIZE(smmuv3.cmdq.log2size);
+    smmuv3.hw->CMDQ_PROD = 0;
+    smmuv3.hw->CMDQ_CONS = 0;
+}
+
+void smmuv3_init()
+{
+    vaddr_t smmu_regs = mem_alloc_map_dev(&cpu()->as, SEC_HYP_GLOBAL, INVALID_VA,
+        platform.arch.smmu.base, NUM_PAGES(sizeof(struct smmuv3_hw)));
+
+    smmuv3.hw = (struct smmuv3_hw*)smmu_regs;
+
+    smmuv3_check_features();
+
+    /* Disable the smmu and abort all incoming transactions while it is being set up. */
+    smmuv3_write_cr0(0);
+    smmuv3.hw->GBPA = SMMUV3_GBPA_UPDATE | SMMUV3_GBPA_ABORT;
+    while (smmuv3.hw->GBPA & SMMUV3_GBPA_UPDATE) { }
+
+    smmuv3.hw->CR1 = smmuv3.coherent ? SMMUV3_CR1_CACHEABLE : 0;
+    smmuv3.hw->CR2 = SMMUV3_CR2_RECINVSID;
+
+    smmuv3_init_strtab();
+    smmuv3_init_cmdq();
+
+    smmuv3_write_cr0(SMMUV3_CR0_CMDQEN);
+
+    /* Clear any configuration or translation cached before reset. */
+    struct smmuv3_cmd_batch batch = { .num = 0 };
+    smmuv3_batch_add(&batch,
+        (struct smmuv3_cmd){ .dw = { SMMUV3_CMD_OPCODE(SMMUV3_CMD_CFGI_ALL),
+                                 SMMUV3_CMD_1_CFGI_ALL_RANGE } });
+    smmuv3_batch_add(&batch,
+        (struct smmuv3_cmd){ .dw = { SMMUV3_CMD_OPCODE(SMMUV3_CMD_TLBI_NSNH_ALL), 0 } });
+    /* EL2 translation regimes, and their invalidation commands, only exist with IDR0.HYP */
+    if (smmuv3.hw->IDR0 & SMMUV3_IDR0_HYP_BIT) {
+        smmuv3_batch_add(&batch,
+            (struct smmuv3_cmd){ .dw = { SMMUV3_CMD_OPCODE(SMMUV3_CMD_TLBI_EL2_ALL), 0 } });
+    }
+    smmuv3_batch_submit(&batch);
+
+    smmuv3_write_cr0(SMMUV3_CR0_CMDQEN | SMMUV3_CR0_SMMUEN);
+}
+
+static void smmuv3_write_ste(volatile uint64_t* ste, paddr_t root_pt, asid_t vm_id)
+{
+    /**
+     * This should closely match to the VTCR configuration set up in vmm_arch_init as we're
+     * sharing page table between the VM and its streams.
+     */
+    ste[1] = SMMUV3_STE_1_SHCFG_INCOMING;
+    ste[2] = SMMUV3_STE_2_S2VMID(vm_id) | SMMUV3_STE_2_S2T0SZ(64 - parange_table[parange]) |
+        ((parange_table[parange] < 44) ? SMMUV3_STE_2_S2SL0_1 : SMMUV3_STE_2_S2SL0_0) |
+        SMMUV3_STE_2_S2IR0_WB_RA_WA | SMMUV3_STE_2_S2OR0_WB_RA_WA | SMMUV3_STE_2_S2SH0_IS |
+        SMMUV3_STE_2_S2TG_4K | SMMUV3_STE_2_S2PS(parange) | SMMUV3_STE_2_S2AA64 |
+        SMMUV3_STE_2_S2R;
+    ste[3] = root_pt & SMMUV3_STE_3_S2TTB_MSK;
+    for (size_t i = 4; i < SMMUV3_STE_DWORDS; i++) {
+        ste[i] = 0;
+    }
+
+    /* The entry may only become valid once all its other fields are visible to the smmu. */
+    smmuv3_sync_to_smmu(ste, SMMUV3_STE_DWORDS * sizeof(uint64_t));
+    fence_sync_write();
+    ste[0] = SMMUV3_STE_0_V | SMMUV3_STE_0_CFG_S2_TRANS;
+    smmuv3_sync_to_smmu(ste, sizeof(uint64_t));
+}
+
+/**
+ * Point every stream matching id outside of mask to the stage 2 tables at root_pt. All the
+ * configuration invalidations and a final invalidation of the vm's tlb entries are submitted in a
+ * single batch.
+ */
+bool smmuv3_attach(streamid_t mask, streamid_t id, paddr_t root_pt, asid_t vm_id)
+{
+    struct smmuv3_cmd_batch batch = { .num = 0 };
+    size_t ste_num = 1UL << smmuv3.strtab.log2size;
+    bool found = false;
+    bool ok = true;
+
+    spin_lock(&smmuv3.strtab.lock);
+    for (size_t sid = (id & ~mask); (sid < ste_num) && ok; sid++) {
+        if (((sid ^ id) & ~mask) != 0) {
+            continue;
+        }
+
+        found = true;
+        volatile uint64_t* ste = &smmuv3.strtab.base[sid * SMMUV3_STE_DWORDS];
+        if (ste[0] & SMMUV3_STE_0_V) {
+            if ((ste[2] & SMMUV3_STE_2_S2VMID(-1)) != SMMUV3_STE_2_S2VMID(vm_id)) {
+                INFO("iommu: smmuv3 stream %d already assigned to another vm", sid);
+                ok = false;
+            }
+            continue;
+        }
+
+        smmuv3_write_ste(ste, root_pt, vm_id);
+        smmuv3_batch_add(&batch, smmuv3_cmd_cfgi_ste((streamid_t)sid));
+    }
+    spin_unlock(&smmuv3.strtab.lock);
+
+    if (!found) {
+        INFO("iommu: smmuv3 stream %d out of stream table range", id);
+        ok = false;
+    }
+
+    smmuv3_batch_add(&batch, smmuv3_cmd_tlbi_s12_vmall(vm_id));
+    smmuv3_batch_submit(&batch);
+
+    return ok;
+}
+
+/**
+ * Invalidate the smmu tlb entries of an ipa range of the vm. Small ranges are invalidated page by
+ * page, all in a single batch. A zero size or a large range drops the whole vmid.
+ */
+void smmuv3_inv_range(asid_t vm_id, vaddr_t ipa, size_t size)
+{
+    struct smmuv3_cmd_batch batch = { .num = 0 };
+    size_t num_pages = NUM_PAGES(size);
+
+    if (smmuv3.hw == NULL) {
+        return;
+    }
+
+    if (num_pages == 0 || num_pages > SMMUV3_TLBI_RANGE_MAX_PAGES) {
+        smmuv3_batch_add(&batch, smmuv3_cmd_tlbi_s12_vmall(vm_id));
+    } else {
+        for (size_t i = 0; i < num_pages; i++) {
+            smmuv3_batch_add(&batch, smmuv3_cmd_tlbi_s2_ipa(vm_id, ipa + (i * PAGE_SIZE)));
+        }
+    }
+
+    smmuv3_batch_submit(&batch);
+}
@@ -12,6 +12,19 @@ void vcpu_arch_profile_init(struct vcpu* vcpu, struct vm* vm)
 {
     paddr_t root_pt_pa;
     mem_translate(&cpu()->as, (vaddr_t)vm->as.pt.root, &root_pt_pa);
+
+    /**
+     * The VM's page tables are navigated through a recursive entry in the hypervisor root table,
+     * but the master, which created the address space, is the only one which has it installed.
+     * The other VM cpus also walk them (e.g. to install the VM image), so point their own root
+     * table at the VM's.
+     */
+    if (cpu()->id != vm->master) {
+        pte_set(cpu()->as.pt.root + vm->as.pt.arch.rec_ind, root_pt_pa, PTE_TABLE, PTE_HYP_FLAGS);
+        fence_sync();
+        ISB();
+    }
+
     sysreg_vttbr_el2_write((((uint64_t)vm->id << VTTBR_VMID_OFF) & VTTBR_VMID_MSK) |
         (root_pt_pa & ~VTTBR_VMID_MSK));
 
@@ -25,15 +25,31 @@ struct cpu_arch_profile {
             perms_t el1;
         } perms[MPU_ARCH_MAX_NUM_ENTRIES];
         /**
-         * We maintain an ordered list of the regions currently in the mpu to simplify the merging
-         * algorithm when mapping an overllaping region.
+         * Regions accessible only by the guest may be evicted when the mpu runs out of entries.
+         * They are kept in the vmpu and mapped back on the next fault on them. The least recently
+         * (re)mapped region is the first to go.
+         */
+        unsigned long lru[MPU_ARCH_MAX_NUM_ENTRIES];
+        unsigned long lru_clock;
+        /**
+         * The entry mapped back by the last refill is not evicted by the next one. Otherwise, two
+         * regions accessed by the same instruction could keep evicting each other when only one
+         * entry is evictable. The refill fails instead.
+         */
+        mpid_t last_refill;
+        bool refilling;
+        /**
+         * We maintain an array of the regions currently in the mpu sorted by base address to
+         * simplify the merging algorithm when mapping an overllaping region. It mirrors the bounds
+         * of each region so they can be binary searched without reading back the mpu registers.
          */
         struct {
-            struct list list;
-            struct mpu_node {
-                node_t node;
+            size_t num;
+            struct mpu_order_entry {
+                vaddr_t base;
+                vaddr_t limit;
                 mpid_t mpid;
-            } node[MPU_ARCH_MAX_NUM_ENTRIES];
+            } entries[MPU_ARCH_MAX_NUM_ENTRIES];
         } order;
     } mpu;
 };
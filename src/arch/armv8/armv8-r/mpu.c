@@ -26,20 +26,60 @@ static void mpu_entry_get_region(mpid_t mpid, struct mp_region* mpe)
     mpe->as_sec = SEC_UNKNOWN;
 }
 
-static int mpu_node_cmp(node_t* _n1, node_t* _n2)
+/**
+ * Find the first region in the order array whose limit is above addr, i.e., the first region that
+ * either contains addr or lies after it. As regions do not overlap, their limits are sorted just
+ * like their bases.
+ */
+static size_t mpu_order_search(vaddr_t addr)
 {
-    struct mpu_node* n1 = (struct mpu_node*)_n1;
-    struct mpu_node* n2 = (struct mpu_node*)_n2;
-    struct mp_region r1;
-    struct mp_region r2;
-    mpu_entry_get_region(n1->mpid, &r1);
-    mpu_entry_get_region(n2->mpid, &r2);
-    if (r1.base > r2.base) {
-        return 1;
-    } else if (r1.base < r2.base) {
-        return -1;
-    } else {
-        return 0;
+    struct mpu_order_entry* entries = cpu()->arch.profile.mpu.order.entries;
+    size_t low = 0;
+    size_t high = cpu()->arch.profile.mpu.order.num;
+
+    while (low < high) {
+        size_t mid = low + ((high - low) / 2);
+        if (entries[mid].limit <= addr) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+static void mpu_order_insert(mpid_t mpid, struct mp_region* mpr)
+{
+    struct mpu_order_entry* entries = cpu()->arch.profile.mpu.order.entries;
+    size_t num = cpu()->arch.profile.mpu.order.num;
+    size_t i = mpu_order_search(mpr->base);
+
+    for (size_t j = num; j > i; j--) {
+        entries[j] = entries[j - 1];
+    }
+    entries[i] = (struct mpu_order_entry){
+        .base = mpr->base,
+        .limit = mpr->base + mpr->size,
+        .mpid = mpid,
+    };
+    cpu()->arch.profile.mpu.order.num = num + 1;
+}
+
+static void mpu_order_remove(mpid_t mpid)
+{
+    struct mpu_order_entry* entries = cpu()->arch.profile.mpu.order.entries;
+    size_t num = cpu()->arch.profile.mpu.order.num;
+
+    // Removing an entry shifts the rest of the array anyway, so we simply look it up by mpid
+    for (size_t i = 0; i < num; i++) {
+        if (entries[i].mpid == mpid) {
+            for (size_t j = i; j < (num - 1); j++) {
+                entries[j] = entries[j + 1];
+            }
+            cpu()->arch.profile.mpu.order.num = num - 1;
+            break;
+        }
     }
 }
 
@@ -52,20 +92,20 @@ static void mpu_entry_set(mpid_t mpid, struct mp_region* mpr)
     sysreg_prbar_el2_write((mpr->base & PRBAR_BASE_MSK) | mpr->mem_flags.prbar);
     sysreg_prlar_el2_write((lim & PRLAR_LIMIT_MSK) | mpr->mem_flags.prlar);
 
-    list_insert_ordered(&cpu()->arch.profile.mpu.order.list,
-        (node_t*)&cpu()->arch.profile.mpu.order.node[mpid], mpu_node_cmp);
+    mpu_order_insert(mpid, mpr);
+    cpu()->arch.profile.mpu.lru[mpid] = ++cpu()->arch.profile.mpu.lru_clock;
 }
 
 static void mpu_entry_modify(mpid_t mpid, struct mp_region* mpr)
 {
-    list_rm(&cpu()->arch.profile.mpu.order.list, (node_t*)&cpu()->arch.profile.mpu.order.node[mpid]);
+    mpu_order_remove(mpid);
 
     mpu_entry_set(mpid, mpr);
 }
 
 static bool mpu_entry_clear(mpid_t mpid)
 {
-    list_rm(&cpu()->arch.profile.mpu.order.list, (node_t*)&cpu()->arch.profile.mpu.order.node[mpid]);
+    mpu_order_remove(mpid);
 
     sysreg_prselr_el2_write(mpid);
     ISB();
@@ -154,7 +194,42 @@ static inline mem_attrs_t mpu_entry_attrs(struct mp_region* mpr)
     return (mem_attrs_t)flags.raw;
 }
 
-static mpid_t mpu_entry_allocate()
+/**
+ * Evict the least recently mapped region that only the guest can access. The region is still in the
+ * guest's vmpu, so it is mapped back when the guest faults on it. The freed entry is handed to the
+ * caller, still allocated.
+ *
+ * @keep:   An entry the caller is working on, which must not be evicted.
+ */
+static mpid_t mpu_entry_evict(mpid_t keep)
+{
+    struct mpu_order_entry* order = cpu()->arch.profile.mpu.order.entries;
+    unsigned long* lru = cpu()->arch.profile.mpu.lru;
+    mpid_t victim = INVALID_MPID;
+
+    for (size_t i = 0; i < cpu()->arch.profile.mpu.order.num; i++) {
+        mpid_t mpid = order[i].mpid;
+        if ((mpid == keep) || mpu_entry_locked(mpid) ||
+            (cpu()->arch.profile.mpu.perms[mpid].el2 != PERM_NONE) ||
+            (cpu()->arch.profile.mpu.refilling && (mpid == cpu()->arch.profile.mpu.last_refill))) {
+            continue;
+        }
+
+        if ((victim == INVALID_MPID) || (lru[mpid] < lru[victim])) {
+            victim = mpid;
+        }
+    }
+
+    if (victim != INVALID_MPID) {
+        mpu_entry_clear(victim);
+        cpu()->arch.profile.mpu.perms[victim].el1 = PERM_NONE;
+        cpu()->arch.profile.mpu.perms[victim].el2 = PERM_NONE;
+    }
+
+    return victim;
+}
+
+static mpid_t mpu_entry_allocate(mpid_t keep)
 {
     mpid_t reg_num = INVALID_MPID;
     for (mpid_t i = 0; i < mpu_num_entries(); i++) {
@@ -164,6 +239,11 @@ static mpid_t mpu_entry_allocate()
             break;
         }
     }
+
+    if (reg_num == INVALID_MPID) {
+        reg_num = mpu_entry_evict(keep);
+    }
+
     return reg_num;
 }
 
@@ -232,9 +312,16 @@ bool mpu_map(priv_t priv, struct mp_region* mpr)
         bottom_mpid = INVALID_MPID;
         top_mpid = INVALID_MPID;
 
-        struct list* mpu_order_list = &cpu()->arch.profile.mpu.order.list;
-        list_foreach ((*mpu_order_list), struct mpu_node, entry) {
-            mpid_t mpid = entry->mpid;
+        // Every region before the one found by the search ends before the new region starts, so
+        // the walk starts at the first region that might overlap it.
+        struct mpu_order_entry* order = cpu()->arch.profile.mpu.order.entries;
+        size_t first = mpu_order_search(new_reg->base);
+        if (first > 0) {
+            prev = order[first - 1].mpid;
+        }
+
+        for (size_t i = first; i < cpu()->arch.profile.mpu.order.num; i++) {
+            mpid_t mpid = order[i].mpid;
             struct mp_region overlapped_reg;
 
             mpu_entry_get_region(mpid, &overlapped_reg);
@@ -321,7 +408,7 @@ bool mpu_map(priv_t priv, struct mp_region* mpr)
             mpu_entry_set_perms(&middle, overlap_perms);
 
             if (bottom_size > 0) {
-                bottom_mpid = mpu_entry_allocate();
+                bottom_mpid = mpu_entry_allocate(mpid);
                 if (bottom_mpid == INVALID_MPID) {
                     failed = true;
                     break;
@@ -329,7 +416,7 @@ bool mpu_map(priv_t priv, struct mp_region* mpr)
             }
 
             if (top_size > 0) {
-                top_mpid = mpu_entry_allocate();
+                top_mpid = mpu_entry_allocate(mpid);
                 if (top_mpid == INVALID_MPID) {
                     failed = true;
                     break;
@@ -440,9 +527,13 @@ bool mpu_map(priv_t priv, struct mp_region* mpr)
                 mpu_entry_update_priv_perms(priv, merge_mpid, new_perms);
                 mpu_entry_modify(merge_mpid, new_reg);
             } else {
-                mpid_t mpid = mpu_entry_allocate();
+                mpid_t mpid = mpu_entry_allocate(INVALID_MPID);
                 if (mpid == INVALID_MPID) {
-                    ERROR("failed to allocate mpu entry");
+                    // Nothing left to evict (e.g., while refilling, every other entry is locked or
+                    // is the one just refilled). Let the caller handle it, for a refill this means
+                    // reporting the guest abort.
+                    failed = true;
+                    break;
                 }
                 mpu_entry_update_priv_perms(priv, mpid, new_perms);
                 mpu_entry_set(mpid, new_reg);
@@ -472,20 +563,15 @@ bool mpu_unmap(priv_t priv, struct mp_region* mpr)
         mpid_t mpid = INVALID_MPID;
         struct mp_region reg;
 
-        struct list* mpu_order_list = &cpu()->arch.profile.mpu.order.list;
-        list_foreach ((*mpu_order_list), struct mpu_node, entry) {
-            mpu_entry_get_region(entry->mpid, &reg);
-
-            if ((mpr->base + mpr->size) < reg.base) {
+        struct mpu_order_entry* order = cpu()->arch.profile.mpu.order.entries;
+        for (size_t i = mpu_order_search(mpr->base); i < cpu()->arch.profile.mpu.order.num; i++) {
+            if ((mpr->base + mpr->size) <= order[i].base) {
                 break;
             }
 
-            if (!mpu_entry_has_priv(entry->mpid, priv)) {
-                continue;
-            }
-
-            if (mem_regions_overlap(&reg, mpr)) {
-                mpid = entry->mpid;
+            if (mpu_entry_has_priv(order[i].mpid, priv)) {
+                mpid = order[i].mpid;
+                mpu_entry_get_region(mpid, &reg);
                 break;
             }
         }
@@ -518,7 +604,7 @@ bool mpu_unmap(priv_t priv, struct mp_region* mpr)
             struct mp_region top = reg;
             top.base = mpr_limit;
             top.size = top_size;
-            mpid_t top_mpid = mpu_entry_allocate();
+            mpid_t top_mpid = mpu_entry_allocate(mpid);
             cpu()->arch.profile.mpu.perms[top_mpid] = orig_perms;
             mpu_entry_set(top_mpid, &top);
         }
@@ -526,7 +612,7 @@ bool mpu_unmap(priv_t priv, struct mp_region* mpr)
         if (bottom_size > 0) {
             struct mp_region bottom = reg;
             bottom.size = bottom_size;
-            mpid_t bottom_mpid = mpu_entry_allocate();
+            mpid_t bottom_mpid = mpu_entry_allocate(mpid);
             cpu()->arch.profile.mpu.perms[bottom_mpid] = orig_perms;
             mpu_entry_set(bottom_mpid, &bottom);
         }
@@ -541,14 +627,68 @@ bool mpu_unmap(priv_t priv, struct mp_region* mpr)
     return size_left == 0;
 }
 
+bool mpu_refill(priv_t priv, struct mp_region* mpr, vaddr_t addr)
+{
+    struct mpu_order_entry* order = cpu()->arch.profile.mpu.order.entries;
+    size_t num = cpu()->arch.profile.mpu.order.num;
+    vaddr_t base = mpr->base;
+    vaddr_t limit = mpr->base + mpr->size;
+    size_t i = mpu_order_search(addr);
+
+    if ((i < num) && (order[i].base <= addr) && mpu_entry_has_priv(order[i].mpid, priv)) {
+        // The address is mapped, so the fault was not caused by an evicted region
+        return false;
+    }
+
+    // Only map the part of the region around addr that is not mapped for this privilege anymore.
+    // Other parts of it might still be (e.g., if they were merged with other regions).
+    for (size_t j = i; j > 0; j--) {
+        if (order[j - 1].limit <= base) {
+            break;
+        }
+        if (mpu_entry_has_priv(order[j - 1].mpid, priv)) {
+            base = order[j - 1].limit;
+            break;
+        }
+    }
+
+    for (size_t j = i; j < num; j++) {
+        if (order[j].base >= limit) {
+            break;
+        }
+        if (mpu_entry_has_priv(order[j].mpid, priv)) {
+            limit = order[j].base;
+            break;
+        }
+    }
+
+    struct mp_region hole = *mpr;
+    hole.base = base;
+    hole.size = limit - base;
+
+    cpu()->arch.profile.mpu.refilling = true;
+    bool refilled = mpu_map(priv, &hole);
+    cpu()->arch.profile.mpu.refilling = false;
+
+    if (refilled) {
+        i = mpu_order_search(addr);
+        if ((i < cpu()->arch.profile.mpu.order.num) && (order[i].base <= addr)) {
+            cpu()->arch.profile.mpu.last_refill = order[i].mpid;
+        }
+    }
+
+    return refilled;
+}
+
 void mpu_init()
 {
     bitmap_clear_consecutive(cpu()->arch.profile.mpu.bitmap, 0, mpu_num_entries());
-    list_init(&cpu()->arch.profile.mpu.order.list);
+    cpu()->arch.profile.mpu.order.num = 0;
+    cpu()->arch.profile.mpu.lru_clock = 0;
+    cpu()->arch.profile.mpu.last_refill = INVALID_MPID;
+    cpu()->arch.profile.mpu.refilling = false;
 
     for (mpid_t mpid = 0; mpid < mpu_num_entries(); mpid++) {
-        cpu()->arch.profile.mpu.order.node[mpid].mpid = mpid;
-
         if (mpu_entry_valid(mpid)) {
             bitmap_set(cpu()->arch.profile.mpu.bitmap, mpid);
             bitmap_set(cpu()->arch.profile.mpu.locked, mpid);
@@ -560,8 +700,9 @@ void mpu_init()
             cpu()->arch.profile.mpu.perms[mpid].el1 = PERM_NONE;
             cpu()->arch.profile.mpu.perms[mpid].el2 = PERM_RWX;
 
-            list_insert_ordered(&cpu()->arch.profile.mpu.order.list,
-                (node_t*)&cpu()->arch.profile.mpu.order.node[mpid], mpu_node_cmp);
+            struct mp_region mpr;
+            mpu_entry_get_region(mpid, &mpr);
+            mpu_order_insert(mpid, &mpr);
         }
     }
 }
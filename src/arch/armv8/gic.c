@@ -9,6 +9,7 @@
 #include <arch/gicv2.h>
 #elif (GIC_VERSION == GICV3)
 #include <arch/gicv3.h>
+#include <arch/gicv4.h>
 #else
 #error "unknown GIV version " GIC_VERSION
 #endif
@@ -82,6 +83,9 @@ void gic_init()
         gic_map_mmio();
         gicd_init();
         NUM_LRS = gich_num_lrs();
+#if (GIC_VERSION == GICV3)
+        gicv4_init();
+#endif
     }
 
     cpu_sync_and_clear_msgs(&cpu_glb_sync);
@@ -100,6 +104,9 @@ void gic_handle()
         if (res == HANDLED_BY_HYP) {
             gicc_dir(ack);
         }
+    } else if (id >= GIC_FIRST_LPI) {
+        /* vPE doorbells only need to wake up the cpu. LPIs have no active state to deactivate */
+        gicc_eoir(ack);
     }
 }
 
@@ -21,6 +21,9 @@ volatile struct gich_hw* gich;
 
 static cpuid_t gic_cpu_map[GIC_MAX_TARGETS];
 
+/* Banked private priority registers written since gic_cpu_init, per cpu */
+static uint32_t gicd_priv_prio_dirty[PLAT_CPU_NUM];
+
 size_t NUM_LRS;
 
 size_t gich_num_lrs()
@@ -59,13 +62,19 @@ void gicc_save_state(struct gicc_state* state)
     state->HPPIR = gicc->HPPIR;
     state->priv_ISENABLER = gicd->ISENABLER[0];
 
+    state->priv_prio_dirty = gicd_priv_prio_dirty[cpu()->id];
     for (size_t i = 0; i < GIC_NUM_PRIO_REGS(GIC_CPU_PRIV); i++) {
-        state->priv_IPRIORITYR[i] = gicd->IPRIORITYR[i];
+        if (bit32_get(state->priv_prio_dirty, i)) {
+            state->priv_IPRIORITYR[i] = gicd->IPRIORITYR[i];
+        }
     }
 
     state->HCR = gich->HCR;
-    for (size_t i = 0; i < gich_num_lrs(); i++) {
-        state->LR[i] = gich->LR[i];
+    state->live_lrs = ~gich_get_elrsr() & BIT64_MASK(0, NUM_LRS);
+    for (size_t i = 0; i < NUM_LRS; i++) {
+        if (bit64_get(state->live_lrs, i)) {
+            state->LR[i] = gich->LR[i];
+        }
     }
 }
 
@@ -81,12 +90,13 @@ void gicc_restore_state(struct gicc_state* state)
     gicd->ISENABLER[0] = state->priv_ISENABLER;
 
     for (size_t i = 0; i < GIC_NUM_PRIO_REGS(GIC_CPU_PRIV); i++) {
-        gicd->IPRIORITYR[i] = state->priv_IPRIORITYR[i];
+        gicd->IPRIORITYR[i] =
+            bit32_get(state->priv_prio_dirty, i) ? state->priv_IPRIORITYR[i] : (uint32_t)-1;
     }
 
     gich->HCR = state->HCR;
-    for (size_t i = 0; i < gich_num_lrs(); i++) {
-        gich->LR[i] = state->LR[i];
+    for (size_t i = 0; i < NUM_LRS; i++) {
+        gich->LR[i] = bit64_get(state->live_lrs, i) ? state->LR[i] : 0;
     }
 }
 
@@ -109,6 +119,7 @@ void gic_cpu_init()
     for (size_t i = 0; i < GIC_NUM_PRIO_REGS(GIC_CPU_PRIV); i++) {
         gicd->IPRIORITYR[i] = -1;
     }
+    gicd_priv_prio_dirty[cpu()->id] = 0;
 
     gicc_init();
 }
@@ -142,6 +153,15 @@ static inline uint8_t gic_translate_cpu_to_trgt(uint8_t cpu_targets)
     return gic_targets;
 }
 
+void gic_send_sgi_mask(cpumap_t cpu_targets, irqid_t sgi_num)
+{
+    if (sgi_num < GIC_MAX_SGIS) {
+        gicd->SGIR = ((uint32_t)gic_translate_cpu_to_trgt((uint8_t)cpu_targets)
+                         << GICD_SGIR_CPUTRGLST_OFF) |
+            (sgi_num & GICD_SGIR_SGIINTID_MSK);
+    }
+}
+
 void gicd_set_trgt(irqid_t int_id, uint8_t cpu_targets)
 {
     size_t reg_ind = GIC_TARGET_REG(int_id);
@@ -159,6 +179,10 @@ void gicd_set_trgt(irqid_t int_id, uint8_t cpu_targets)
 void gic_set_prio(irqid_t int_id, uint8_t prio)
 {
     gicd_set_prio(int_id, prio);
+    if (gic_is_priv(int_id)) {
+        gicd_priv_prio_dirty[cpu()->id] =
+            bit32_set(gicd_priv_prio_dirty[cpu()->id], GIC_PRIO_REG(int_id));
+    }
 }
 
 uint8_t gic_get_prio(irqid_t int_id)
@@ -5,6 +5,7 @@
 
 #include <arch/gic.h>
 #include <arch/gicv3.h>
+#include <arch/gicv4.h>
 
 #include <cpu.h>
 #include <mem.h>
@@ -13,13 +14,16 @@
 #include <fences.h>
 
 extern volatile struct gicd_hw* gicd;
-volatile struct gicr_hw* gicr;
+volatile struct gicr_hw* gicr[PLAT_CPU_NUM];
 
 static spinlock_t gicd_lock = SPINLOCK_INITVAL;
 static spinlock_t gicr_lock = SPINLOCK_INITVAL;
 
 size_t NUM_LRS;
 
+/* Private priority registers written since gicr_init, per redistributor */
+static uint32_t gicr_prio_dirty[PLAT_CPU_NUM];
+
 size_t gich_num_lrs()
 {
     return ((sysreg_ich_vtr_el2_read() & ICH_VTR_MSK) >> ICH_VTR_OFF) + 1;
@@ -40,32 +44,39 @@ static inline void gicc_init()
 
 static inline void gicr_init()
 {
-    gicr[cpu()->id].WAKER &= ~GICR_WAKER_ProcessorSleep_BIT;
-    while (gicr[cpu()->id].WAKER & GICR_WAKER_ChildrenASleep_BIT) { }
+    gicr[cpu()->id]->WAKER &= ~GICR_WAKER_ProcessorSleep_BIT;
+    while (gicr[cpu()->id]->WAKER & GICR_WAKER_ChildrenASleep_BIT) { }
 
-    gicr[cpu()->id].IGROUPR0 = -1;
-    gicr[cpu()->id].ICENABLER0 = -1;
-    gicr[cpu()->id].ICPENDR0 = -1;
-    gicr[cpu()->id].ICACTIVER0 = -1;
+    gicr[cpu()->id]->IGROUPR0 = -1;
+    gicr[cpu()->id]->ICENABLER0 = -1;
+    gicr[cpu()->id]->ICPENDR0 = -1;
+    gicr[cpu()->id]->ICACTIVER0 = -1;
 
     for (size_t i = 0; i < GIC_NUM_PRIO_REGS(GIC_CPU_PRIV); i++) {
-        gicr[cpu()->id].IPRIORITYR[i] = -1;
+        gicr[cpu()->id]->IPRIORITYR[i] = -1;
     }
+    gicr_prio_dirty[cpu()->id] = 0;
 }
 
 void gicc_save_state(struct gicc_state* state)
 {
     state->PMR = sysreg_icc_pmr_el1_read();
     state->BPR = sysreg_icc_bpr1_el1_read();
-    state->priv_ISENABLER = gicr[cpu()->id].ISENABLER0;
+    state->priv_ISENABLER = gicr[cpu()->id]->ISENABLER0;
 
+    state->priv_prio_dirty = gicr_prio_dirty[cpu()->id];
     for (size_t i = 0; i < GIC_NUM_PRIO_REGS(GIC_CPU_PRIV); i++) {
-        state->priv_IPRIORITYR[i] = gicr[cpu()->id].IPRIORITYR[i];
+        if (bit32_get(state->priv_prio_dirty, i)) {
+            state->priv_IPRIORITYR[i] = gicr[cpu()->id]->IPRIORITYR[i];
+        }
     }
 
     state->HCR = sysreg_ich_hcr_el2_read();
-    for (size_t i = 0; i < gich_num_lrs(); i++) {
-        state->LR[i] = gich_read_lr(i);
+    state->live_lrs = ~gich_get_elrsr() & BIT64_MASK(0, NUM_LRS);
+    for (size_t i = 0; i < NUM_LRS; i++) {
+        if (bit64_get(state->live_lrs, i)) {
+            state->LR[i] = gich_read_lr(i);
+        }
     }
 }
 
@@ -76,21 +87,23 @@ void gicc_restore_state(struct gicc_state* state)
     sysreg_icc_igrpen1_el1_write(ICC_IGRPEN_EL1_ENB_BIT);
     sysreg_icc_pmr_el1_write(state->PMR);
     sysreg_icc_bpr1_el1_write(state->BPR);
-    gicr[cpu()->id].ISENABLER0 = state->priv_ISENABLER;
+    gicr[cpu()->id]->ISENABLER0 = state->priv_ISENABLER;
 
     for (size_t i = 0; i < GIC_NUM_PRIO_REGS(GIC_CPU_PRIV); i++) {
-        gicr[cpu()->id].IPRIORITYR[i] = state->priv_IPRIORITYR[i];
+        gicr[cpu()->id]->IPRIORITYR[i] =
+            bit32_get(state->priv_prio_dirty, i) ? state->priv_IPRIORITYR[i] : (uint32_t)-1;
     }
 
     sysreg_ich_hcr_el2_write(state->HCR);
-    for (size_t i = 0; i < gich_num_lrs(); i++) {
-        gich_write_lr(i, state->LR[i]);
+    for (size_t i = 0; i < NUM_LRS; i++) {
+        gich_write_lr(i, bit64_get(state->live_lrs, i) ? state->LR[i] : 0);
     }
 }
 
 void gic_cpu_init()
 {
     gicr_init();
+    gicv4_cpu_init();
     gicc_init();
 }
 
@@ -98,8 +111,22 @@ void gic_map_mmio()
 {
     gicd = (void*)mem_alloc_map_dev(&cpu()->as, SEC_HYP_GLOBAL, INVALID_VA,
         platform.arch.gic.gicd_addr, NUM_PAGES(sizeof(struct gicd_hw)));
-    gicr = (void*)mem_alloc_map_dev(&cpu()->as, SEC_HYP_GLOBAL, INVALID_VA,
-        platform.arch.gic.gicr_addr, NUM_PAGES(sizeof(struct gicr_hw) * PLAT_CPU_NUM));
+
+    /**
+     * GICv4 redistributors have two extra frames (vLPI and reserved) after the RD_base and
+     * SGI_base frames.
+     */
+    size_t gicr_stride = sizeof(struct gicr_hw);
+    if (bit32_extract(gicd->ID[GICD_PIDR2_IND], GIC_PIDR2_ARCHREV_OFF, GIC_PIDR2_ARCHREV_LEN) >=
+        GIC_ARCHREV_GICV4) {
+        gicr_stride *= 2;
+    }
+
+    vaddr_t gicr_base = mem_alloc_map_dev(&cpu()->as, SEC_HYP_GLOBAL, INVALID_VA,
+        platform.arch.gic.gicr_addr, NUM_PAGES(gicr_stride * PLAT_CPU_NUM));
+    for (size_t i = 0; i < PLAT_CPU_NUM; i++) {
+        gicr[i] = (volatile struct gicr_hw*)(gicr_base + (i * gicr_stride));
+    }
 }
 
 void gicr_set_prio(irqid_t int_id, uint8_t prio, cpuid_t gicr_id)
@@ -110,8 +137,9 @@ void gicr_set_prio(irqid_t int_id, uint8_t prio, cpuid_t gicr_id)
 
     spin_lock(&gicr_lock);
 
-    gicr[gicr_id].IPRIORITYR[reg_ind] =
-        (gicr[gicr_id].IPRIORITYR[reg_ind] & ~mask) | ((prio << off) & mask);
+    gicr[gicr_id]->IPRIORITYR[reg_ind] =
+        (gicr[gicr_id]->IPRIORITYR[reg_ind] & ~mask) | ((prio << off) & mask);
+    gicr_prio_dirty[gicr_id] = bit32_set(gicr_prio_dirty[gicr_id], reg_ind);
 
     spin_unlock(&gicr_lock);
 }
@@ -123,7 +151,7 @@ uint8_t gicr_get_prio(irqid_t int_id, cpuid_t gicr_id)
 
     spin_lock(&gicr_lock);
 
-    uint8_t prio = gicr[gicr_id].IPRIORITYR[reg_ind] >> off & BIT32_MASK(off, GIC_PRIO_BITS);
+    uint8_t prio = gicr[gicr_id]->IPRIORITYR[reg_ind] >> off & BIT32_MASK(off, GIC_PRIO_BITS);
 
     spin_unlock(&gicr_lock);
 
@@ -139,9 +167,9 @@ void gicr_set_icfgr(irqid_t int_id, uint8_t cfg, cpuid_t gicr_id)
     spin_lock(&gicr_lock);
 
     if (reg_ind == 0) {
-        gicr[gicr_id].ICFGR0 = (gicr[gicr_id].ICFGR0 & ~mask) | ((cfg << off) & mask);
+        gicr[gicr_id]->ICFGR0 = (gicr[gicr_id]->ICFGR0 & ~mask) | ((cfg << off) & mask);
     } else {
-        gicr[gicr_id].ICFGR1 = (gicr[gicr_id].ICFGR1 & ~mask) | ((cfg << off) & mask);
+        gicr[gicr_id]->ICFGR1 = (gicr[gicr_id]->ICFGR1 & ~mask) | ((cfg << off) & mask);
     }
 
     spin_unlock(&gicr_lock);
@@ -151,9 +179,9 @@ void gicr_set_pend(irqid_t int_id, bool pend, cpuid_t gicr_id)
 {
     spin_lock(&gicr_lock);
     if (pend) {
-        gicr[gicr_id].ISPENDR0 = (1U) << (int_id);
+        gicr[gicr_id]->ISPENDR0 = (1U) << (int_id);
     } else {
-        gicr[gicr_id].ICPENDR0 = (1U) << (int_id);
+        gicr[gicr_id]->ICPENDR0 = (1U) << (int_id);
     }
     spin_unlock(&gicr_lock);
 }
@@ -161,7 +189,7 @@ void gicr_set_pend(irqid_t int_id, bool pend, cpuid_t gicr_id)
 bool gicr_get_pend(irqid_t int_id, cpuid_t gicr_id)
 {
     if (gic_is_priv(int_id)) {
-        return !!(gicr[gicr_id].ISPENDR0 & GIC_INT_MASK(int_id));
+        return !!(gicr[gicr_id]->ISPENDR0 & GIC_INT_MASK(int_id));
     } else {
         return false;
     }
@@ -172,9 +200,9 @@ void gicr_set_act(irqid_t int_id, bool act, cpuid_t gicr_id)
     spin_lock(&gicr_lock);
 
     if (act) {
-        gicr[gicr_id].ISACTIVER0 = GIC_INT_MASK(int_id);
+        gicr[gicr_id]->ISACTIVER0 = GIC_INT_MASK(int_id);
     } else {
-        gicr[gicr_id].ICACTIVER0 = GIC_INT_MASK(int_id);
+        gicr[gicr_id]->ICACTIVER0 = GIC_INT_MASK(int_id);
     }
 
     spin_unlock(&gicr_lock);
@@ -183,7 +211,7 @@ void gicr_set_act(irqid_t int_id, bool act, cpuid_t gicr_id)
 bool gicr_get_act(irqid_t int_id, cpuid_t gicr_id)
 {
     if (gic_is_priv(int_id)) {
-        return !!(gicr[gicr_id].ISACTIVER0 & GIC_INT_MASK(int_id));
+        return !!(gicr[gicr_id]->ISACTIVER0 & GIC_INT_MASK(int_id));
     } else {
         return false;
     }
@@ -195,9 +223,9 @@ void gicr_set_enable(irqid_t int_id, bool en, cpuid_t gicr_id)
 
     spin_lock(&gicr_lock);
     if (en) {
-        gicr[gicr_id].ISENABLER0 = bit;
+        gicr[gicr_id]->ISENABLER0 = bit;
     } else {
-        gicr[gicr_id].ICENABLER0 = bit;
+        gicr[gicr_id]->ICENABLER0 = bit;
     }
     spin_unlock(&gicr_lock);
 }
@@ -226,6 +254,40 @@ void gic_send_sgi(cpuid_t cpu_target, irqid_t sgi_num)
     }
 }
 
+void gic_send_sgi_mask(cpumap_t cpu_targets, irqid_t sgi_num)
+{
+    if (sgi_num >= GIC_MAX_SGIS) {
+        return;
+    }
+
+    /**
+     * Issue a single ICC_SGI1R write per cluster, using its target list to cover all the targeted
+     * cpus which share the same affinity level 1. Bits beyond the platform's cpus are dropped, and
+     * the first cpu of each pass is always cleared, so every pass makes progress.
+     */
+    cpu_targets &= BIT_MASK(0, platform.cpu_num);
+    while (cpu_targets != 0) {
+        cpuid_t first = (cpuid_t)bit_ffs(cpu_targets);
+        unsigned long aff1 = MPIDR_AFF_LVL(cpu_id_to_mpidr(first), 1);
+        uint64_t trgtlist = 0;
+
+        for (cpuid_t i = first; i < platform.cpu_num; i++) {
+            if (bit_get(cpu_targets, i)) {
+                unsigned long mpidr = cpu_id_to_mpidr(i) & MPIDR_AFF_MSK;
+                if (MPIDR_AFF_LVL(mpidr, 1) == aff1) {
+                    trgtlist |= (1UL << MPIDR_AFF_LVL(mpidr, 0));
+                    cpu_targets = bit_clear(cpu_targets, i);
+                }
+            }
+        }
+        cpu_targets = bit_clear(cpu_targets, first);
+
+        uint64_t sgi =
+            (aff1 << ICC_SGIR_AFF1_OFFSET) | trgtlist | (sgi_num << ICC_SGIR_SGIINTID_OFF);
+        sysreg_icc_sgi1r_el1_write(sgi);
+    }
+}
+
 void gic_set_prio(irqid_t int_id, uint8_t prio)
 {
     if (!gic_is_priv(int_id)) {
@@ -0,0 +1,573 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <arch/gicv4.h>
+
+#include <bit.h>
+#include <cpu.h>
+#include <mem.h>
+#include <cache.h>
+#include <fences.h>
+#include <string.h>
+#include <platform.h>
+#include <config.h>
+
+#define GITS_CMD_VPEID_OFF       (32)
+#define GITS_CMD_ADDR_MSK        BIT64_MASK(16, 36)
+#define GITS_CMD_ITT_MSK         BIT64_MASK(8, 44)
+#define GITS_CMD_DB_OFF          (32)
+#define GITS_CMD_VMOVI_D_BIT     (1ULL << 0)
+#define GITS_CMD_VMAPP_ALLOC_BIT (1ULL << 8)
+#define GITS_CMD_VMAPP_PTZ_BIT   (1ULL << 9)
+#define GITS_CMD_VSGI_EN_BIT     (1ULL << 8)
+#define GITS_CMD_VSGI_CLEAR_BIT  (1ULL << 9)
+#define GITS_CMD_VSGI_GRP1_BIT   (1ULL << 10)
+#define GITS_CMD_VSGI_PRIO_OFF   (20)
+#define GITS_CMD_VSGI_PRIO_LEN   (4)
+#define GITS_CMD_VSGI_INTID_OFF  (32)
+
+#define GITS_CMD_SIZE            (32)
+#define GITS_CMDQ_NUM            (PAGE_SIZE / GITS_CMD_SIZE)
+
+/* vLPIs rely on their vPE's default doorbell, so are mapped with the invalid INTID */
+#define GITS_NO_DOORBELL         (1023)
+
+struct gits_priv {
+    volatile struct gits_hw* hw;
+    spinlock_t lock;
+    struct gits_cmd* cmdq;
+    size_t cmdq_wr;
+    bool cmdq_flush;
+    bool pta;
+    size_t itte_size;
+    size_t event_bits;
+    uint64_t vpropbaser;
+    paddr_t lpi_prop;
+    paddr_t vconf;
+};
+
+static struct gits_priv gits = { .lock = SPINLOCK_INITVAL };
+
+bool gicv4_vsgi_support;
+
+static inline volatile struct gicr_vlpi_hw* gicr_vlpi(cpuid_t gicr_id)
+{
+    /* The vLPI frame follows the RD_base and SGI_base frames */
+    return (volatile struct gicr_vlpi_hw*)(gicr[gicr_id] + 1);
+}
+
+static void* gicv4_alloc_table(size_t size, paddr_t* pa)
+{
+    size_t num_pages = NUM_PAGES(ALIGN(size, GICV4_TABLE_ALIGN));
+    void* table = mem_alloc_page(num_pages, SEC_HYP_GLOBAL, true);
+    if (table == NULL) {
+        ERROR("gicv4: failed to allocate table");
+    }
+
+    memset(table, 0, num_pages * PAGE_SIZE);
+    cache_flush_range((vaddr_t)table, num_pages * PAGE_SIZE);
+
+    mem_translate(&cpu()->as, (vaddr_t)table, pa);
+    if (*pa % GICV4_TABLE_ALIGN) {
+        ERROR("gicv4: table is not properly aligned");
+    }
+
+    return table;
+}
+
+static void gits_cmd_push(struct gits_cmd* cmd)
+{
+    size_t next = (gits.cmdq_wr + 1) % GITS_CMDQ_NUM;
+    if (next == bit64_extract(gits.hw->CREADR, GITS_CMDQ_OFF, GITS_CMDQ_LEN)) {
+        /* The queue is full, so hand the commands pushed so far to the its to make room */
+        fence_sync_write();
+        gits.hw->CWRITER = (uint64_t)gits.cmdq_wr << GITS_CMDQ_OFF;
+        while (next == bit64_extract(gits.hw->CREADR, GITS_CMDQ_OFF, GITS_CMDQ_LEN)) { }
+    }
+
+    gits.cmdq[gits.cmdq_wr] = *cmd;
+    if (gits.cmdq_flush) {
+        cache_flush_range((vaddr_t)&gits.cmdq[gits.cmdq_wr], sizeof(struct gits_cmd));
+    }
+
+    gits.cmdq_wr = next;
+}
+
+static void gits_cmd_vsync(vpeid_t vpeid)
+{
+    struct gits_cmd vsync = { { GITS_CMD_VSYNC, (uint64_t)vpeid << GITS_CMD_VPEID_OFF, 0, 0 } };
+    gits_cmd_push(&vsync);
+}
+
+static void gits_cmdq_wait()
+{
+    fence_sync_write();
+    gits.hw->CWRITER = (uint64_t)gits.cmdq_wr << GITS_CMDQ_OFF;
+
+    uint64_t creadr;
+    do {
+        creadr = gits.hw->CREADR;
+        if (creadr & GITS_CREADR_STALLED_BIT) {
+            ERROR("gicv4: its command queue stalled");
+        }
+    } while (bit64_extract(creadr, GITS_CMDQ_OFF, GITS_CMDQ_LEN) != gits.cmdq_wr);
+}
+
+static void gits_cmd_sync(vpeid_t vpeid)
+{
+    gits_cmd_vsync(vpeid);
+    gits_cmdq_wait();
+}
+
+static void gits_send_cmd(struct gits_cmd* cmd, vpeid_t vpeid)
+{
+    spin_lock(&gits.lock);
+    gits_cmd_push(cmd);
+    gits_cmd_sync(vpeid);
+    spin_unlock(&gits.lock);
+}
+
+static void gits_init_cmdq()
+{
+    paddr_t cmdq_pa;
+    gits.cmdq = mem_alloc_page(1, SEC_HYP_GLOBAL, false);
+    if (gits.cmdq == NULL) {
+        ERROR("gicv4: failed to allocate its command queue");
+    }
+    memset(gits.cmdq, 0, PAGE_SIZE);
+    cache_flush_range((vaddr_t)gits.cmdq, PAGE_SIZE);
+    mem_translate(&cpu()->as, (vaddr_t)gits.cmdq, &cmdq_pa);
+
+    gits.hw->CBASER = GITS_CBASER_VALID_BIT | (GIC_BASER_RAWAWB << GITS_CBASER_ICACHE_OFF) |
+        (cmdq_pa & GITS_CBASER_PA_MSK) | (GIC_BASER_INNER_SH << GITS_CBASER_SH_OFF);
+    gits.cmdq_flush = bit64_extract(gits.hw->CBASER, GITS_CBASER_SH_OFF, GITS_CBASER_SH_LEN) ==
+        GIC_BASER_NON_SH;
+    gits.cmdq_wr = 0;
+    gits.hw->CWRITER = 0;
+}
+
+static ssize_t gits_find_baser(size_t type)
+{
+    for (size_t i = 0; i < GITS_BASER_NUM; i++) {
+        if (bit64_extract(gits.hw->BASER[i], GITS_BASER_TYPE_OFF, GITS_BASER_TYPE_LEN) == type) {
+            return (ssize_t)i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Backs an ITS table with a flat table of num_entries. Try 4KiB pages first, but some
+ * implementations only support a fixed page size, so use whatever sticks. Returns the BASER value
+ * accepted by the ITS.
+ */
+static uint64_t gits_init_baser(size_t index, size_t num_entries, paddr_t* table_pa)
+{
+    uint64_t baser = gits.hw->BASER[index];
+    size_t esz = bit64_extract(baser, GITS_BASER_ESZ_OFF, GITS_BASER_ESZ_LEN) + 1;
+    gits.hw->BASER[index] = bit64_insert(baser, 0, GITS_BASER_PGSZ_OFF, GITS_BASER_PGSZ_LEN);
+    size_t pgsz = bit64_extract(gits.hw->BASER[index], GITS_BASER_PGSZ_OFF, GITS_BASER_PGSZ_LEN);
+    size_t table_size = ALIGN(num_entries * esz, GICV4_TABLE_ALIGN);
+    size_t table_pages = table_size / (PAGE_SIZE << (2 * pgsz));
+
+    if (table_pages > (1UL << GITS_BASER_SIZE_LEN)) {
+        ERROR("gicv4: its table too large");
+    }
+
+    gicv4_alloc_table(table_size, table_pa);
+
+    baser &= BIT64_MASK(GITS_BASER_TYPE_OFF, GITS_BASER_TYPE_LEN) |
+        BIT64_MASK(GITS_BASER_ESZ_OFF, GITS_BASER_ESZ_LEN);
+    baser |= GITS_BASER_VALID_BIT | (GIC_BASER_RAWAWB << GITS_BASER_ICACHE_OFF) |
+        (*table_pa & GITS_BASER_PA_MSK) | (GIC_BASER_INNER_SH << GITS_BASER_SH_OFF) |
+        (pgsz << GITS_BASER_PGSZ_OFF) | (table_pages - 1);
+    gits.hw->BASER[index] = baser;
+
+    return gits.hw->BASER[index];
+}
+
+static void gits_init_vpe_table()
+{
+    ssize_t vpe_baser = gits_find_baser(GITS_BASER_TYPE_VPE);
+    if (vpe_baser < 0) {
+        ERROR("gicv4: its does not provide a vpe table");
+    }
+
+    /**
+     * vPE ids are the physical cpu ids, as each cpu runs a single vcpu.
+     */
+    paddr_t table_pa;
+    uint64_t baser = gits_init_baser((size_t)vpe_baser, PLAT_CPU_NUM, &table_pa);
+    size_t esz = bit64_extract(baser, GITS_BASER_ESZ_OFF, GITS_BASER_ESZ_LEN) + 1;
+    size_t pgsz = bit64_extract(baser, GITS_BASER_PGSZ_OFF, GITS_BASER_PGSZ_LEN);
+
+    /**
+     * Redistributors share the vPE table with the ITS, so they are pointed at the exact same
+     * table as it was accepted by the ITS.
+     */
+    gits.vpropbaser = GICR_VPROPBASER_VALID_BIT;
+    gits.vpropbaser |= bit64_insert(0, esz - 1, GICR_VPROPBASER_ESZ_OFF, GICR_VPROPBASER_ESZ_LEN);
+    gits.vpropbaser |= bit64_insert(0, pgsz, GICR_VPROPBASER_PGSZ_OFF, GICR_VPROPBASER_PGSZ_LEN);
+    gits.vpropbaser |= table_pa & BIT64_MASK(GICR_VPROPBASER_PA_OFF, GICR_VPROPBASER_PA_LEN);
+    gits.vpropbaser |= bit64_insert(0,
+        bit64_extract(baser, GITS_BASER_SH_OFF, GITS_BASER_SH_LEN), GICR_VPROPBASER_SH_OFF,
+        GICR_VPROPBASER_SH_LEN);
+    gits.vpropbaser |= bit64_insert(0,
+        bit64_extract(baser, GITS_BASER_ICACHE_OFF, GITS_BASER_ICACHE_LEN),
+        GICR_VPROPBASER_ICACHE_OFF, GICR_VPROPBASER_ICACHE_LEN);
+    gits.vpropbaser |= bit64_insert(0,
+        bit64_extract(baser, GITS_BASER_SIZE_OFF, GITS_BASER_SIZE_LEN), GICR_VPROPBASER_SIZE_OFF,
+        GICR_VPROPBASER_SIZE_LEN);
+}
+
+/**
+ * Only the devices assigned to VMs with a vITS are ever mapped on the ITS, so the device table
+ * only needs to cover the highest of their device ids.
+ */
+static void gits_init_device_table()
+{
+    deviceid_t max_devid = 0;
+    bool has_devs = false;
+
+    for (size_t i = 0; i < config.vmlist_size; i++) {
+        struct vm_platform* vm_platform = &config.vmlist[i].platform;
+        if (vm_platform->arch.gic.gits_addr == 0) {
+            continue;
+        }
+        for (size_t j = 0; j < vm_platform->dev_num; j++) {
+            if (vm_platform->devs[j].id != 0) {
+                max_devid = max(max_devid, vm_platform->devs[j].id);
+                has_devs = true;
+            }
+        }
+    }
+
+    if (!has_devs) {
+        return;
+    }
+
+    size_t devbits = bit64_extract(gits.hw->TYPER, GITS_TYPER_DEVBITS_OFF, GITS_TYPER_DEVBITS_LEN);
+    if (((uint64_t)max_devid >> (devbits + 1)) != 0) {
+        ERROR("gicv4: its does not support device id %u", max_devid);
+    }
+
+    /* Without a device table the ITS keeps device mappings internally */
+    ssize_t dev_baser = gits_find_baser(GITS_BASER_TYPE_DEVICE);
+    if (dev_baser >= 0) {
+        paddr_t table_pa;
+        gits_init_baser((size_t)dev_baser, (size_t)max_devid + 1, &table_pa);
+    }
+}
+
+void gicv4_init()
+{
+    if (platform.arch.gic.gits_addr == 0) {
+        return;
+    }
+
+    gits.hw = (void*)mem_alloc_map_dev(&cpu()->as, SEC_HYP_GLOBAL, INVALID_VA,
+        platform.arch.gic.gits_addr, NUM_PAGES(sizeof(struct gits_hw)));
+
+    uint64_t typer = gits.hw->TYPER;
+    if (!(typer & GITS_TYPER_VIRTUAL_BIT) || !(typer & GITS_TYPER_VMAPP_BIT) ||
+        !(gicd->TYPER2 & GICD_TYPER2_nASSGIcap_BIT)) {
+        INFO("gicv4: no GICv4.1 vSGI support, SGIs are emulated");
+        return;
+    }
+    gits.pta = !!(typer & GITS_TYPER_PTA_BIT);
+    gits.itte_size = bit64_extract(typer, GITS_TYPER_ITTESZ_OFF, GITS_TYPER_ITTESZ_LEN) + 1;
+    gits.event_bits = bit64_extract(typer, GITS_TYPER_IDBITS_OFF, GITS_TYPER_IDBITS_LEN) + 1;
+
+    gits.hw->CTLR &= ~GITS_CTLR_EN_BIT;
+    while (!(gits.hw->CTLR & GITS_CTLR_QUIESCENT_BIT)) { }
+
+    gits_init_cmdq();
+    gits_init_vpe_table();
+    gits_init_device_table();
+
+    /**
+     * The only physical LPIs are the vPE doorbells, one per cpu, with the highest priority. VMs
+     * without a vITS have no vLPIs, so they share a single, all-disabled vLPI configuration table.
+     */
+    uint8_t* lpi_prop = gicv4_alloc_table(GICV4_LPI_PROP_SIZE, &gits.lpi_prop);
+    for (cpuid_t cpuid = 0; cpuid < PLAT_CPU_NUM; cpuid++) {
+        lpi_prop[GICV4_DOORBELL_LPI(cpuid) - GIC_FIRST_LPI] =
+            GIC_LPI_PROP_RES1_BIT | GIC_LPI_PROP_EN_BIT;
+    }
+    cache_flush_range((vaddr_t)lpi_prop, GICV4_LPI_PROP_SIZE);
+    gicv4_alloc_table(GICV4_LPI_PROP_SIZE, &gits.vconf);
+
+    gits.hw->CTLR |= GITS_CTLR_EN_BIT;
+
+    gicv4_vsgi_support = true;
+}
+
+void gicv4_cpu_init()
+{
+    if (!gicv4_vsgi_support) {
+        return;
+    }
+
+    volatile struct gicr_hw* rd = gicr[cpu()->id];
+    volatile struct gicr_vlpi_hw* vlpi = gicr_vlpi(cpu()->id);
+
+    if (!(rd->TYPER & GICR_TYPER_VLPIS_BIT) || !(rd->TYPER & GICR_TYPER_RVPEID_BIT)) {
+        ERROR("gicv4: redistributor does not support GICv4.1");
+    }
+
+    vlpi->VPENDBASER = 0;
+    while (vlpi->VPENDBASER & GICR_VPENDBASER_DIRTY_BIT) { }
+    vlpi->VPROPBASER = gits.vpropbaser;
+
+    paddr_t pend_pa;
+    gicv4_alloc_table(GICV4_LPI_PEND_SIZE, &pend_pa);
+    rd->PROPBASER = (gits.lpi_prop & GICR_PROPBASER_PA_MSK) |
+        (GIC_BASER_RAWAWB << GICR_PROPBASER_ICACHE_OFF) |
+        (GIC_BASER_INNER_SH << GICR_PROPBASER_SH_OFF) | (GICV4_LPI_ID_BITS - 1);
+    rd->PENDBASER = (pend_pa & GICR_PENDBASER_PA_MSK) |
+        (GIC_BASER_RAWAWB << GICR_PENDBASER_ICACHE_OFF) |
+        (GIC_BASER_INNER_SH << GICR_PENDBASER_SH_OFF) | GICR_PENDBASER_PTZ_BIT;
+    fence_sync_write();
+    rd->CTLR |= GICR_CTLR_ENLPI_BIT;
+}
+
+void* gicv4_vconf_alloc(paddr_t* vconf)
+{
+    return gicv4_alloc_table(GICV4_LPI_PROP_SIZE, vconf);
+}
+
+void gicv4_vpe_init(vpeid_t vpeid, paddr_t vconf)
+{
+    uint64_t target;
+    paddr_t vpt_pa;
+
+    gicv4_alloc_table(GICV4_LPI_PEND_SIZE, &vpt_pa);
+
+    if (gits.pta) {
+        paddr_t rd_pa;
+        mem_translate(&cpu()->as, (vaddr_t)gicr[cpu()->id], &rd_pa);
+        target = rd_pa;
+    } else {
+        target = bit64_extract(gicr[cpu()->id]->TYPER, GICR_TYPER_PRCNUM_OFF,
+                     GICR_TYPER_PRCNUM_LEN)
+            << 16;
+    }
+
+    if (vconf == 0) {
+        vconf = gits.vconf;
+    }
+
+    struct gits_cmd vmapp = { {
+        GITS_CMD_VMAPP | GITS_CMD_VMAPP_ALLOC_BIT | GITS_CMD_VMAPP_PTZ_BIT |
+            (vconf & GITS_CMD_ADDR_MSK),
+        ((uint64_t)vpeid << GITS_CMD_VPEID_OFF) | GICV4_DOORBELL_LPI(cpu()->id),
+        GITS_CMD_VALID_BIT | (target & GITS_CMD_ADDR_MSK),
+        (vpt_pa & GITS_CMD_ADDR_MSK) | (GICV4_LPI_ID_BITS - 1),
+    } };
+    gits_send_cmd(&vmapp, vpeid);
+
+    /**
+     * Each cpu runs a single vcpu, so its vPE is resident unless the vcpu waits for interrupts
+     * with the cpu idle.
+     */
+    gicv4_vpe_schedule(vpeid);
+}
+
+void gicv4_vpe_schedule(vpeid_t vpeid)
+{
+    volatile struct gicr_vlpi_hw* vlpi = gicr_vlpi(cpu()->id);
+
+    vlpi->VPENDBASER = GICR_VPENDBASER_VALID_BIT | GICR_VPENDBASER_VGRP0EN_BIT |
+        GICR_VPENDBASER_VGRP1EN_BIT | vpeid;
+    while (vlpi->VPENDBASER & GICR_VPENDBASER_DIRTY_BIT) { }
+}
+
+/**
+ * Makes the current cpu's vPE non-resident and asks for its default doorbell, so the cpu is woken
+ * up once a vLPI or vSGI becomes pending for it. If one already was (PendingLast), nothing would
+ * ring the doorbell, so the vPE is made resident again and false is returned.
+ */
+bool gicv4_vpe_deschedule()
+{
+    volatile struct gicr_vlpi_hw* vlpi = gicr_vlpi(cpu()->id);
+    uint64_t vpendbaser = vlpi->VPENDBASER;
+    vpeid_t vpeid = bit64_extract(vpendbaser, GICR_VPENDBASER_VPEID_OFF, GICR_VPENDBASER_VPEID_LEN);
+
+    vpendbaser &= ~(GICR_VPENDBASER_VALID_BIT | GICR_VPENDBASER_PENDLAST_BIT);
+    vlpi->VPENDBASER = vpendbaser | GICR_VPENDBASER_DB_BIT;
+    do {
+        vpendbaser = vlpi->VPENDBASER;
+    } while (vpendbaser & GICR_VPENDBASER_DIRTY_BIT);
+
+    if (vpendbaser & GICR_VPENDBASER_PENDLAST_BIT) {
+        gicv4_vpe_schedule(vpeid);
+        return false;
+    }
+
+    return true;
+}
+
+void gicv4_vsgi_config(vpeid_t vpeid, irqid_t sgi, bool enable, uint8_t prio, bool clear)
+{
+    struct gits_cmd vsgi = { {
+        GITS_CMD_VSGI | GITS_CMD_VSGI_GRP1_BIT | ((uint64_t)sgi << GITS_CMD_VSGI_INTID_OFF) |
+            bit64_insert(0, prio >> (GIC_PRIO_BITS - GITS_CMD_VSGI_PRIO_LEN),
+                GITS_CMD_VSGI_PRIO_OFF, GITS_CMD_VSGI_PRIO_LEN),
+        (uint64_t)vpeid << GITS_CMD_VPEID_OFF,
+        0,
+        0,
+    } };
+
+    if (enable) {
+        vsgi.dw[0] |= GITS_CMD_VSGI_EN_BIT;
+    }
+    if (clear) {
+        vsgi.dw[0] |= GITS_CMD_VSGI_CLEAR_BIT;
+    }
+
+    gits_send_cmd(&vsgi, vpeid);
+}
+
+void gicv4_vsgi_send(vpeid_t vpeid, irqid_t sgi)
+{
+    gits.hw->SGIR = bit64_insert(0, vpeid, GITS_SGIR_VPEID_OFF, GITS_SGIR_VPEID_LEN) |
+        bit64_insert(0, sgi, GITS_SGIR_VINTID_OFF, GITS_SGIR_VINTID_LEN);
+}
+
+uint16_t gicv4_vsgi_get_pend(vpeid_t vpeid)
+{
+    volatile struct gicr_vlpi_hw* vlpi = gicr_vlpi(cpu()->id);
+    uint32_t pendr;
+
+    vlpi->VSGIR = vpeid;
+    do {
+        pendr = vlpi->VSGIPENDR;
+    } while (pendr & GICR_VSGIPENDR_BUSY_BIT);
+
+    return (uint16_t)(pendr & GICR_VSGIPENDR_PEND_MSK);
+}
+
+size_t gicv4_its_event_bits()
+{
+    return gits.event_bits;
+}
+
+uint32_t gicv4_its_iidr()
+{
+    return gits.hw->IIDR;
+}
+
+uint32_t gicv4_its_id(size_t index)
+{
+    return gits.hw->ID[index];
+}
+
+void* gicv4_its_itt_alloc(size_t event_bits, paddr_t* itt, size_t* num_pages)
+{
+    *num_pages = NUM_PAGES((1UL << event_bits) * gits.itte_size);
+    void* table = mem_alloc_page(*num_pages, SEC_HYP_GLOBAL, false);
+    if (table != NULL) {
+        memset(table, 0, *num_pages * PAGE_SIZE);
+        cache_flush_range((vaddr_t)table, *num_pages * PAGE_SIZE);
+        mem_translate(&cpu()->as, (vaddr_t)table, itt);
+    }
+
+    return table;
+}
+
+static void gits_batch_add(struct gits_cmd_batch* batch, vpeid_t vpeid, struct gits_cmd cmd)
+{
+    if (batch->num >= GITS_CMD_BATCH_MAX) {
+        gicv4_its_batch_submit(batch);
+    }
+    batch->cmds[batch->num++] = cmd;
+    batch->vpes |= 1UL << vpeid;
+}
+
+void gicv4_its_batch_submit(struct gits_cmd_batch* batch)
+{
+    if (batch->num == 0) {
+        return;
+    }
+
+    spin_lock(&gits.lock);
+    for (size_t i = 0; i < batch->num; i++) {
+        gits_cmd_push(&batch->cmds[i]);
+    }
+    for (vpeid_t vpeid = 0; vpeid < PLAT_CPU_NUM; vpeid++) {
+        if (batch->vpes & (1UL << vpeid)) {
+            gits_cmd_vsync(vpeid);
+        }
+    }
+    gits_cmdq_wait();
+    spin_unlock(&gits.lock);
+
+    batch->num = 0;
+    batch->vpes = 0;
+}
+
+void gicv4_its_mapd(struct gits_cmd_batch* batch, vpeid_t vpeid, deviceid_t devid,
+    size_t event_bits, paddr_t itt, bool valid)
+{
+    struct gits_cmd mapd = { {
+        GITS_CMD_MAPD | ((uint64_t)devid << GITS_CMD_DEVID_OFF),
+        bit64_insert(0, event_bits - 1, GITS_CMD_SIZE_OFF, GITS_CMD_SIZE_LEN),
+        (valid ? GITS_CMD_VALID_BIT : 0) | (itt & GITS_CMD_ITT_MSK),
+        0,
+    } };
+
+    gits_batch_add(batch, vpeid, mapd);
+}
+
+void gicv4_its_vmapti(struct gits_cmd_batch* batch, vpeid_t vpeid, deviceid_t devid,
+    uint32_t eventid, irqid_t vintid)
+{
+    struct gits_cmd vmapti = { {
+        GITS_CMD_VMAPTI | ((uint64_t)devid << GITS_CMD_DEVID_OFF),
+        eventid | ((uint64_t)vpeid << GITS_CMD_VPEID_OFF),
+        vintid | ((uint64_t)GITS_NO_DOORBELL << GITS_CMD_DB_OFF),
+        0,
+    } };
+
+    gits_batch_add(batch, vpeid, vmapti);
+}
+
+void gicv4_its_vmovi(struct gits_cmd_batch* batch, vpeid_t vpeid, deviceid_t devid,
+    uint32_t eventid)
+{
+    struct gits_cmd vmovi = { {
+        GITS_CMD_VMOVI | ((uint64_t)devid << GITS_CMD_DEVID_OFF),
+        eventid | ((uint64_t)vpeid << GITS_CMD_VPEID_OFF),
+        GITS_CMD_VMOVI_D_BIT | ((uint64_t)GITS_NO_DOORBELL << GITS_CMD_DB_OFF),
+        0,
+    } };
+
+    gits_batch_add(batch, vpeid, vmovi);
+}
+
+/**
+ * Issues one of the commands which only take a device and an event (DISCARD, INV, INT and CLEAR).
+ * These equally apply to events mapped to vLPIs.
+ */
+void gicv4_its_event_cmd(struct gits_cmd_batch* batch, vpeid_t vpeid, uint8_t cmd,
+    deviceid_t devid, uint32_t eventid)
+{
+    struct gits_cmd event_cmd = { {
+        cmd | ((uint64_t)devid << GITS_CMD_DEVID_OFF),
+        eventid,
+        0,
+        0,
+    } };
+
+    gits_batch_add(batch, vpeid, event_cmd);
+}
+
+void gicv4_its_vinvall(struct gits_cmd_batch* batch, vpeid_t vpeid)
+{
+    struct gits_cmd vinvall = { { GITS_CMD_VINVALL, (uint64_t)vpeid << GITS_CMD_VPEID_OFF, 0, 0 } };
+
+    gits_batch_add(batch, vpeid, vinvall);
+}
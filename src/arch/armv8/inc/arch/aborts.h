@@ -8,4 +8,8 @@
 
 #include <bao.h>
 
+vaddr_t aborts_fault_addr();
+bool aborts_data_emulate(unsigned long iss, vaddr_t addr, unsigned long il);
+bool aborts_sync_fast_handler();
+
 #endif /* __ABORTS_H__ */
@@ -8,6 +8,7 @@
 
 #include <bao.h>
 
-#define CACHE_MAX_LVL 8
+#define CACHE_MAX_LVL   8
+#define CACHE_LINE_SIZE 64
 
 #endif /* __ARCH_CACHE_H__ */
@@ -16,6 +16,7 @@
 #define GICV3                     (3)
 
 #define GIC_FIRST_SPECIAL_INTID   (1020)
+#define GIC_FIRST_LPI             (8192)
 #define GIC_MAX_INTERUPTS         1024
 #define GIC_MAX_VALID_INTERRUPTS  (GIC_FIRST_SPECIAL_INTID)
 #define GIC_MAX_SGIS              16
@@ -62,6 +63,7 @@
 #define GICD_CTLR_EN_BIT          (0x1)
 #define GICD_CTLR_ENA_BIT         (0x2)
 #define GICD_CTLR_ARE_NS_BIT      (0x10)
+#define GICD_CTLR_nASSGIreq_BIT   (0x100)
 
 /*  Interrupt Controller Type Register, GICD_TYPER */
 
@@ -79,6 +81,18 @@
 #define GICD_TYPER_IDBITS_OFF     (19)
 #define GICD_TYPER_IDBITS_LEN     (5)
 #define GICD_TYPER_IDBITS_MSK     BIT32_MASK(GICD_TYPER_IDBITS_OFF, GICD_TYPER_IDBITS_LEN)
+#define GICD_TYPER_LPIS_BIT       (1U << 17)
+
+/*  Interrupt Controller Type Register 2, GICD_TYPER2 */
+
+#define GICD_TYPER2_nASSGIcap_BIT (1U << 8)
+
+/*  Peripheral ID2 Register, GICD_PIDR2 */
+
+#define GICD_PIDR2_IND            (6)
+#define GIC_PIDR2_ARCHREV_OFF     (4)
+#define GIC_PIDR2_ARCHREV_LEN     (4)
+#define GIC_ARCHREV_GICV4         (4)
 
 /* Software Generated Interrupt Register, GICD_SGIR */
 
@@ -105,7 +119,7 @@ struct gicd_hw {
     uint32_t CTLR;
     uint32_t TYPER;
     uint32_t IIDR;
-    uint8_t pad0[0x0010 - 0x000C];
+    uint32_t TYPER2;
     uint32_t STATUSR;
     uint8_t pad1[0x0040 - 0x0014];
     uint32_t SETSPI_NSR;
@@ -143,8 +157,13 @@ struct gicd_hw {
 
 #define GICR_CTRL_DS_BIT              (1 << 6)
 #define GICR_CTRL_DS_DPG1NS           (1 << 25)
+#define GICR_CTLR_ENLPI_BIT           (1 << 0)
+#define GICR_TYPER_PLPIS_BIT          (1ULL << 0)
+#define GICR_TYPER_VLPIS_BIT          (1ULL << 1)
 #define GICR_TYPER_LAST_OFF           (4)
+#define GICR_TYPER_RVPEID_BIT         (1ULL << 7)
 #define GICR_TYPER_PRCNUM_OFF         (8)
+#define GICR_TYPER_PRCNUM_LEN         (16)
 #define GICR_TYPER_AFFVAL_OFF         (32)
 #define GICR_WAKER_ProcessorSleep_BIT (0x2)
 #define GICR_WAKER_ChildrenASleep_BIT (0x4)
@@ -377,6 +396,11 @@ extern volatile struct gich_hw* gich;
 
 enum int_state { INV, PEND, ACT, PENDACT };
 
+/**
+ * Only the private priority registers changed since the cpu interface was initialized
+ * (priv_prio_dirty) and the list registers holding an interrupt (live_lrs) are saved. On restore,
+ * the remaining ones are reset to the lowest priority and to an empty list register, respectively.
+ */
 struct gicc_state {
     uint32_t CTLR;
     uint32_t PMR;
@@ -386,9 +410,11 @@ struct gicc_state {
     uint32_t RPR;
     uint32_t HPPIR;
     uint32_t priv_ISENABLER;
+    uint32_t priv_prio_dirty;
     uint32_t priv_IPRIORITYR[GIC_NUM_PRIO_REGS(GIC_CPU_PRIV)];
 
     uint32_t HCR;
+    uint64_t live_lrs;
     unsigned long LR[GIC_NUM_LIST_REGS];
 };
 
@@ -397,6 +423,7 @@ extern size_t NUM_LRS;
 void gic_init();
 void gic_cpu_init();
 void gic_send_sgi(cpuid_t cpu_target, irqid_t sgi_num);
+void gic_send_sgi_mask(cpumap_t cpu_targets, irqid_t sgi_num);
 
 void gicc_save_state(struct gicc_state* state);
 void gicc_restore_state(struct gicc_state* state);
@@ -431,7 +458,7 @@ uint8_t gicr_get_prio(irqid_t int_id, cpuid_t gicr_id);
 void gic_maintenance_handler(irqid_t irq_id);
 
 extern volatile struct gicd_hw* gicd;
-extern volatile struct gicr_hw* gicr;
+extern volatile struct gicr_hw* gicr[];
 
 size_t gich_num_lrs();
 
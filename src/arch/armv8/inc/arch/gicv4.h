@@ -0,0 +1,260 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __GICV4_H__
+#define __GICV4_H__
+
+#include <bao.h>
+#include <arch/gic.h>
+
+/* ITS Control Register, GITS_CTLR */
+
+#define GITS_CTLR_EN_BIT            (1U << 0)
+#define GITS_CTLR_QUIESCENT_BIT     (1U << 31)
+
+/* ITS Type Register, GITS_TYPER */
+
+#define GITS_TYPER_PHYSICAL_BIT     (1ULL << 0)
+#define GITS_TYPER_VIRTUAL_BIT      (1ULL << 1)
+#define GITS_TYPER_ITTESZ_OFF       (4)
+#define GITS_TYPER_ITTESZ_LEN       (4)
+#define GITS_TYPER_IDBITS_OFF       (8)
+#define GITS_TYPER_IDBITS_LEN       (5)
+#define GITS_TYPER_DEVBITS_OFF      (13)
+#define GITS_TYPER_DEVBITS_LEN      (5)
+#define GITS_TYPER_HCC_OFF          (24)
+#define GITS_TYPER_HCC_LEN          (8)
+#define GITS_TYPER_PTA_BIT          (1ULL << 19)
+#define GITS_TYPER_VMAPP_BIT        (1ULL << 40)
+
+/* ITS Translation Table Descriptors, GITS_BASER<n> */
+
+#define GITS_BASER_NUM              (8)
+#define GITS_BASER_VALID_BIT        (1ULL << 63)
+#define GITS_BASER_INDIRECT_BIT     (1ULL << 62)
+#define GITS_BASER_ICACHE_OFF       (59)
+#define GITS_BASER_ICACHE_LEN       (3)
+#define GITS_BASER_TYPE_OFF         (56)
+#define GITS_BASER_TYPE_LEN         (3)
+#define GITS_BASER_TYPE_NONE        (0)
+#define GITS_BASER_TYPE_DEVICE      (1)
+#define GITS_BASER_TYPE_VPE         (2)
+#define GITS_BASER_ESZ_OFF          (48)
+#define GITS_BASER_ESZ_LEN          (5)
+#define GITS_BASER_PA_OFF           (12)
+#define GITS_BASER_PA_LEN           (36)
+#define GITS_BASER_PA_MSK           BIT64_MASK(GITS_BASER_PA_OFF, GITS_BASER_PA_LEN)
+#define GITS_BASER_SH_OFF           (10)
+#define GITS_BASER_SH_LEN           (2)
+#define GITS_BASER_PGSZ_OFF         (8)
+#define GITS_BASER_PGSZ_LEN         (2)
+#define GITS_BASER_SIZE_OFF         (0)
+#define GITS_BASER_SIZE_LEN         (8)
+
+/* ITS Command Queue Descriptor, GITS_CBASER */
+
+#define GITS_CBASER_VALID_BIT       (1ULL << 63)
+#define GITS_CBASER_ICACHE_OFF      (59)
+#define GITS_CBASER_PA_OFF          (12)
+#define GITS_CBASER_PA_LEN          (40)
+#define GITS_CBASER_PA_MSK          BIT64_MASK(GITS_CBASER_PA_OFF, GITS_CBASER_PA_LEN)
+#define GITS_CBASER_SH_OFF          (10)
+#define GITS_CBASER_SH_LEN          (2)
+#define GITS_CBASER_SIZE_OFF        (0)
+#define GITS_CBASER_SIZE_LEN        (8)
+#define GITS_CREADR_STALLED_BIT     (1ULL << 0)
+#define GITS_CMDQ_OFF               (5)
+#define GITS_CMDQ_LEN               (15)
+
+/* ITS commands */
+
+#define GITS_CMD_MOVI               (0x01)
+#define GITS_CMD_INT                (0x03)
+#define GITS_CMD_CLEAR              (0x04)
+#define GITS_CMD_SYNC               (0x05)
+#define GITS_CMD_MAPD               (0x08)
+#define GITS_CMD_MAPC               (0x09)
+#define GITS_CMD_MAPTI              (0x0a)
+#define GITS_CMD_MAPI               (0x0b)
+#define GITS_CMD_INV                (0x0c)
+#define GITS_CMD_INVALL             (0x0d)
+#define GITS_CMD_MOVALL             (0x0e)
+#define GITS_CMD_DISCARD            (0x0f)
+#define GITS_CMD_VMOVI              (0x21)
+#define GITS_CMD_VSGI               (0x23)
+#define GITS_CMD_VSYNC              (0x25)
+#define GITS_CMD_VMAPP              (0x29)
+#define GITS_CMD_VMAPTI             (0x2a)
+#define GITS_CMD_VINVALL            (0x2d)
+
+#define GITS_CMD_ID_OFF             (0)
+#define GITS_CMD_ID_LEN             (8)
+#define GITS_CMD_DEVID_OFF          (32)
+#define GITS_CMD_DEVID_LEN          (32)
+#define GITS_CMD_EVENTID_OFF        (0)
+#define GITS_CMD_EVENTID_LEN        (32)
+#define GITS_CMD_INTID_OFF          (32)
+#define GITS_CMD_INTID_LEN          (32)
+#define GITS_CMD_SIZE_OFF           (0)
+#define GITS_CMD_SIZE_LEN           (5)
+#define GITS_CMD_ICID_OFF           (0)
+#define GITS_CMD_ICID_LEN           (16)
+#define GITS_CMD_RDBASE_OFF         (16)
+#define GITS_CMD_RDBASE_LEN         (35)
+#define GITS_CMD_VALID_BIT          (1ULL << 63)
+
+struct gits_cmd {
+    uint64_t dw[4];
+};
+
+/**
+ * Commands are accumulated in a batch and only handed to the its when the batch is submitted,
+ * followed by a single VSYNC for each vPE they target. A batch that fills up is submitted on its
+ * own.
+ */
+#define GITS_CMD_BATCH_MAX          (16)
+
+struct gits_cmd_batch {
+    size_t num;
+    cpumap_t vpes;
+    struct gits_cmd cmds[GITS_CMD_BATCH_MAX];
+};
+
+/* Cacheability and shareability encodings used for the ITS and redistributor tables */
+
+#define GIC_BASER_RAWAWB            (0x7ULL)
+#define GIC_BASER_NON_SH            (0x0ULL)
+#define GIC_BASER_INNER_SH          (0x1ULL)
+
+/* ITS vSGI Register, GITS_SGIR */
+
+#define GITS_SGIR_VPEID_OFF         (32)
+#define GITS_SGIR_VPEID_LEN         (16)
+#define GITS_SGIR_VINTID_OFF        (0)
+#define GITS_SGIR_VINTID_LEN        (4)
+
+struct gits_hw {
+    /* ITS control frame */
+    uint32_t CTLR;
+    uint32_t IIDR;
+    uint64_t TYPER;
+    uint8_t pad0[0x0080 - 0x0010];
+    uint64_t CBASER;
+    uint64_t CWRITER;
+    uint64_t CREADR;
+    uint8_t pad1[0x0100 - 0x0098];
+    uint64_t BASER[GITS_BASER_NUM];
+    uint8_t pad2[0xFFD0 - 0x0140];
+    uint32_t ID[(0x10000 - 0xFFD0) / sizeof(uint32_t)];
+
+    /* Translation frame */
+    uint8_t translater_base[0] __attribute__((aligned(0x10000)));
+    uint8_t pad3[0x0040 - 0x0000];
+    uint32_t TRANSLATER;
+
+    /* vSGI frame (GICv4.1) */
+    uint8_t sgir_base[0] __attribute__((aligned(0x10000)));
+    uint8_t pad4[0x0020 - 0x0000];
+    uint64_t SGIR;
+} __attribute__((__packed__, aligned(0x10000)));
+
+/* Redistributor vLPI frame registers */
+
+#define GICR_VPROPBASER_VALID_BIT   (1ULL << 63)
+#define GICR_VPROPBASER_ESZ_OFF     (59)
+#define GICR_VPROPBASER_ESZ_LEN     (3)
+#define GICR_VPROPBASER_IND_BIT     (1ULL << 55)
+#define GICR_VPROPBASER_PGSZ_OFF    (53)
+#define GICR_VPROPBASER_PGSZ_LEN    (2)
+#define GICR_VPROPBASER_PA_OFF      (12)
+#define GICR_VPROPBASER_PA_LEN      (40)
+#define GICR_VPROPBASER_SH_OFF      (10)
+#define GICR_VPROPBASER_SH_LEN      (2)
+#define GICR_VPROPBASER_ICACHE_OFF  (7)
+#define GICR_VPROPBASER_ICACHE_LEN  (3)
+#define GICR_VPROPBASER_SIZE_OFF    (0)
+#define GICR_VPROPBASER_SIZE_LEN    (7)
+
+#define GICR_VPENDBASER_VALID_BIT   (1ULL << 63)
+#define GICR_VPENDBASER_DB_BIT      (1ULL << 62)
+#define GICR_VPENDBASER_PENDLAST_BIT (1ULL << 61)
+#define GICR_VPENDBASER_DIRTY_BIT   (1ULL << 60)
+#define GICR_VPENDBASER_VGRP0EN_BIT (1ULL << 59)
+#define GICR_VPENDBASER_VGRP1EN_BIT (1ULL << 58)
+#define GICR_VPENDBASER_VPEID_OFF   (0)
+#define GICR_VPENDBASER_VPEID_LEN   (16)
+
+#define GICR_VSGIPENDR_BUSY_BIT     (1U << 31)
+#define GICR_VSGIPENDR_PEND_MSK     BIT32_MASK(0, GIC_MAX_SGIS)
+
+struct gicr_vlpi_hw {
+    uint8_t pad0[0x0070 - 0x0000];
+    uint64_t VPROPBASER;
+    uint64_t VPENDBASER;
+    uint32_t VSGIR;
+    uint8_t pad1[0x0088 - 0x0084];
+    uint32_t VSGIPENDR;
+} __attribute__((__packed__, aligned(0x10000)));
+
+/* Physical LPI tables, GICR_PROPBASER and GICR_PENDBASER */
+
+#define GICR_PROPBASER_IDBITS_OFF   (0)
+#define GICR_PROPBASER_IDBITS_LEN   (5)
+#define GICR_PROPBASER_ICACHE_OFF   (7)
+#define GICR_PROPBASER_SH_OFF       (10)
+#define GICR_PROPBASER_PA_MSK       BIT64_MASK(12, 40)
+#define GICR_PROPBASER_WR_MSK       (BIT64_MASK(0, 52) | BIT64_MASK(56, 3))
+#define GICR_PENDBASER_WR_MSK       (BIT64_MASK(7, 45) | BIT64_MASK(56, 3) | (1ULL << 62))
+#define GICR_PENDBASER_ICACHE_OFF   (7)
+#define GICR_PENDBASER_SH_OFF       (10)
+#define GICR_PENDBASER_PA_MSK       BIT64_MASK(16, 36)
+#define GICR_PENDBASER_PTZ_BIT      (1ULL << 62)
+
+/* LPI configuration table entries */
+
+#define GIC_LPI_PROP_EN_BIT         (1U << 0)
+#define GIC_LPI_PROP_RES1_BIT       (1U << 1)
+#define GIC_LPI_PROP_PRIO_MSK       BIT32_MASK(2, 6)
+
+/**
+ * Number of LPI INTID bits backing the physical LPI tables, each vPE's virtual pending table and
+ * the vLPI configuration tables. Physical LPIs are only used as vPE doorbells, one per cpu.
+ */
+#define GICV4_LPI_ID_BITS           (14)
+#define GICV4_LPI_PROP_SIZE         ((1UL << GICV4_LPI_ID_BITS) - GIC_FIRST_LPI)
+#define GICV4_LPI_PEND_SIZE         ((1UL << GICV4_LPI_ID_BITS) / 8)
+#define GICV4_TABLE_ALIGN           (0x10000)
+#define GICV4_DOORBELL_LPI(CPU)     (GIC_FIRST_LPI + (CPU))
+
+typedef uint16_t vpeid_t;
+
+extern bool gicv4_vsgi_support;
+
+void gicv4_init();
+void gicv4_cpu_init();
+void* gicv4_vconf_alloc(paddr_t* vconf);
+void gicv4_vpe_init(vpeid_t vpeid, paddr_t vconf);
+bool gicv4_vpe_deschedule();
+void gicv4_vpe_schedule(vpeid_t vpeid);
+void gicv4_vsgi_config(vpeid_t vpeid, irqid_t sgi, bool enable, uint8_t prio, bool clear);
+void gicv4_vsgi_send(vpeid_t vpeid, irqid_t sgi);
+uint16_t gicv4_vsgi_get_pend(vpeid_t vpeid);
+
+size_t gicv4_its_event_bits();
+uint32_t gicv4_its_iidr();
+uint32_t gicv4_its_id(size_t index);
+void* gicv4_its_itt_alloc(size_t event_bits, paddr_t* itt, size_t* num_pages);
+void gicv4_its_batch_submit(struct gits_cmd_batch* batch);
+void gicv4_its_mapd(struct gits_cmd_batch* batch, vpeid_t vpeid, deviceid_t devid,
+    size_t event_bits, paddr_t itt, bool valid);
+void gicv4_its_vmapti(struct gits_cmd_batch* batch, vpeid_t vpeid, deviceid_t devid,
+    uint32_t eventid, irqid_t vintid);
+void gicv4_its_vmovi(struct gits_cmd_batch* batch, vpeid_t vpeid, deviceid_t devid,
+    uint32_t eventid);
+void gicv4_its_event_cmd(struct gits_cmd_batch* batch, vpeid_t vpeid, uint8_t cmd,
+    deviceid_t devid, uint32_t eventid);
+void gicv4_its_vinvall(struct gits_cmd_batch* batch, vpeid_t vpeid);
+
+#endif /* __GICV4_H__ */
@@ -8,7 +8,7 @@
 
 #include <bao.h>
 #ifdef MEM_PROT_MMU
-#include <arch/smmuv2.h>
+#include <arch/iommu.h>
 #endif
 
 struct arch_platform {
@@ -18,6 +18,7 @@ struct arch_platform {
         paddr_t gicv_addr;
         paddr_t gicd_addr;
         paddr_t gicr_addr;
+        paddr_t gits_addr;
 
         irqid_t maintenance_id;
     } gic;
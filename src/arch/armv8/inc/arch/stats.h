@@ -0,0 +1,20 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef ARCH_STATS_H
+#define ARCH_STATS_H
+
+#include <bao.h>
+#include <arch/sysregs.h>
+
+/* Synchronous exits are classified by the ESR_EL2 exception class, a 6-bit field */
+#define STATS_ARCH_EXIT_NUM (64)
+
+static inline uint64_t stats_arch_timestamp(void)
+{
+    return sysreg_cntpct_el0_read();
+}
+
+#endif /* ARCH_STATS_H */
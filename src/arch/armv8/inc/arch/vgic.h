@@ -8,7 +8,9 @@
 
 #include <bao.h>
 #include <arch/gic.h>
+#include <arch/gicv4.h>
 #include <list.h>
+#include <platform_defs.h>
 
 struct vm;
 struct vcpu;
@@ -20,6 +22,7 @@ struct vgic_dscrp;
 struct vgic_int {
     node_t node;
     struct vcpu* owner;
+    struct vgic_spilled* spilled;
 #if (GIC_VERSION != GICV2)
     unsigned long route;
     union {
@@ -54,15 +57,80 @@ struct vgicd {
     uint32_t CTLR;
     uint32_t TYPER;
     uint32_t IIDR;
+    uint32_t TYPER2;
 };
 
 struct vgicr {
     spinlock_t lock;
     uint64_t TYPER;
+    uint64_t PROPBASER;
+    uint64_t PENDBASER;
     uint32_t CTLR;
     uint32_t IIDR;
 };
 
+#if (GIC_VERSION != GICV2)
+
+/**
+ * The vITS only accepts the VM's assigned devices, i.e., the ones with a device id in its config.
+ * Guest device and collection tables are not used: their mappings are kept here, and each mapped
+ * event is backed by a GICv4.1 vLPI mapping in the physical ITS.
+ */
+#define VGITS_EVENT_BITS_MAX (11)
+#define VGITS_COLL_NUM       (PLAT_CPU_NUM)
+
+struct vgits_event {
+    irqid_t vintid;
+    uint16_t icid;
+    bool valid;
+};
+
+struct vgits_dev {
+    deviceid_t id;
+    bool valid;
+    size_t event_bits;
+    struct vgits_event* events;
+    void* itt;
+    size_t itt_pages;
+};
+
+struct vgits {
+    spinlock_t lock;
+    bool enabled;
+    uint64_t TYPER;
+    uint64_t CBASER;
+    struct gits_cmd* cmdq;
+    size_t cmdq_num;
+    size_t cwriter;
+    size_t creadr;
+    uint8_t* lpi_prop;
+    size_t lpi_prop_size;
+    uint8_t* vconf;
+    paddr_t vconf_pa;
+    size_t dev_num;
+    struct vgits_dev* devs;
+    vcpuid_t colls[VGITS_COLL_NUM];
+    struct gits_cmd_batch batch;
+    struct emul_mem emul;
+};
+
+#endif
+
+/**
+ * Interrupts which could not be placed in a list register are queued in priority buckets, each
+ * covering the priorities sharing the same 5 most significant bits (the minimum a GIC must
+ * implement). The bitmap tracks non-empty buckets, so the highest priority spilled interrupt is
+ * found without walking every queued interrupt.
+ */
+#define VGIC_SPILLED_BUCKETS        (32)
+#define VGIC_SPILLED_BUCKET(prio)   ((prio) >> (GIC_PRIO_BITS - 5))
+
+struct vgic_spilled {
+    spinlock_t lock;
+    uint32_t bitmap;
+    struct list buckets[VGIC_SPILLED_BUCKETS];
+};
+
 struct vgic_priv {
 #if (GIC_VERSION != GICV2)
     struct vgicr vgicr;
@@ -73,9 +141,13 @@ struct vgic_priv {
 
 void vgic_init(struct vm* vm, const struct vgic_dscrp* vgic_dscrp);
 void vgic_cpu_init(struct vcpu* vcpu);
+void vgic_cpu_vpe_init(struct vcpu* vcpu);
 void vgic_set_hw(struct vm* vm, irqid_t id);
 void vgic_inject(struct vcpu* vcpu, irqid_t id, vcpuid_t source);
 void vgic_inject_hw(struct vcpu* vcpu, irqid_t id);
+void vgic_spilled_init(struct vgic_spilled* spilled);
+bool vgic_vcpu_standby_enter(struct vcpu* vcpu);
+void vgic_vcpu_standby_exit(struct vcpu* vcpu);
 
 /* VGIC INTERNALS */
 
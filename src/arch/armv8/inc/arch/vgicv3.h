@@ -24,4 +24,33 @@ static inline bool vgic_int_vcpu_is_target(struct vcpu* vcpu, struct vgic_int* i
     return local || routed_here || any;
 }
 
+/**
+ * 64-bit registers might be accessed a word at a time. Return the accessed part of a register's
+ * value and merge the written part into it, respectively.
+ */
+static inline uint64_t vgic_reg64_read(struct emul_access* acc, uint64_t reg)
+{
+    if (acc->width == 4) {
+        return (acc->addr & 0x4) ? (reg >> 32) : (reg & BIT64_MASK(0, 32));
+    }
+    return reg;
+}
+
+static inline uint64_t vgic_reg64_write(struct emul_access* acc, uint64_t reg)
+{
+    uint64_t val = vcpu_readreg(cpu()->vcpu, acc->reg);
+    if (acc->width == 4) {
+        return bit64_insert(reg, val, (acc->addr & 0x4) ? 32 : 0, 32);
+    }
+    return val;
+}
+
+void vgits_init(struct vm* vm, const struct vgic_dscrp* vgic_dscrp);
+void vgits_enable_lpis(struct vm* vm, uint64_t propbaser);
+
+static inline bool vgits_present(struct vm* vm)
+{
+    return vm->arch.vgits.emul.handler != NULL;
+}
+
 #endif /* __VGICV3_H__ */
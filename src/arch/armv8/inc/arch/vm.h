@@ -11,7 +11,7 @@
 #include <arch/vgic.h>
 #include <arch/psci.h>
 #ifdef MEM_PROT_MMU
-#include <arch/smmuv2.h>
+#include <arch/iommu.h>
 #endif
 #include <list.h>
 
@@ -20,6 +20,8 @@ struct arch_vm_platform {
         paddr_t gicd_addr;
         paddr_t gicc_addr;
         paddr_t gicr_addr;
+        /* vITS base address, if any, exposing the devices' MSIs as vLPIs (requires GICv4.1) */
+        paddr_t gits_addr;
         size_t interrupt_num;
     } gic;
 
@@ -38,18 +40,20 @@ struct arch_vm_platform {
 struct vm_arch {
     struct vgicd vgicd;
     vaddr_t vgicr_addr;
-    struct list vgic_spilled;
-    spinlock_t vgic_spilled_lock;
+    struct vgic_spilled vgic_spilled;
     struct emul_mem vgicd_emul;
     struct emul_mem vgicr_emul;
     struct emul_reg icc_sgir_emul;
     struct emul_reg icc_sre_emul;
+#if (GIC_VERSION != GICV2)
+    struct vgits vgits;
+#endif
 };
 
 struct vcpu_arch {
     unsigned long vmpidr;
     struct vgic_priv vgic_priv;
-    struct list vgic_spilled;
+    struct vgic_spilled vgic_spilled;
     struct psci_ctx psci_ctx;
 };
 
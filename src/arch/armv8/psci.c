@@ -55,6 +55,14 @@ int32_t psci_cpu_suspend_handler(uint32_t power_state, unsigned long entrypoint,
     uint32_t state_type = power_state & PSCI_STATE_TYPE_BIT;
     int32_t ret;
 
+    /**
+     * With GICv4.1, vSGIs and vLPIs don't interrupt the cpu while its vPE is resident, so it is
+     * made non-resident to get its doorbell. If an interrupt already is pending, return at once.
+     */
+    if (!vgic_vcpu_standby_enter(cpu()->vcpu)) {
+        return PSCI_E_SUCCESS;
+    }
+
     if (state_type) {
         // PSCI_STATE_TYPE_POWERDOWN:
         spin_lock(&cpu()->vcpu->arch.psci_ctx.lock);
@@ -74,6 +82,8 @@ int32_t psci_cpu_suspend_handler(uint32_t power_state, unsigned long entrypoint,
         ret = PSCI_E_SUCCESS;
     }
 
+    vgic_vcpu_standby_exit(cpu()->vcpu);
+
     return ret;
 }
 
@@ -10,6 +10,7 @@
 #include <arch/vgicv2.h>
 #elif (GIC_VERSION == GICV3)
 #include <arch/gicv3.h>
+#include <arch/gicv4.h>
 #include <arch/vgicv3.h>
 #else
 #error "unknown GIV version " GIC_VERSION
@@ -61,6 +62,15 @@ static inline bool vgic_int_is_hw(struct vgic_int* interrupt)
     return !(interrupt->id < GIC_MAX_SGIS) && interrupt->hw;
 }
 
+/**
+ * Once the guest opts for SGIs without active state (GICD_CTLR.nASSGIreq), its SGIs are injected
+ * by the GICv4.1 directly into the target vPE and never go through the list registers.
+ */
+static inline bool vgic_int_is_vsgi(struct vcpu* vcpu, struct vgic_int* interrupt)
+{
+    return gic_is_sgi(interrupt->id) && (vcpu->vm->arch.vgicd.CTLR & GICD_CTLR_nASSGIreq_BIT);
+}
+
 static inline int64_t gich_get_lr(struct vgic_int* interrupt, unsigned long* lr)
 {
     if (!interrupt->in_lr || interrupt->owner->phys_id != cpu()->id) {
@@ -135,11 +145,7 @@ void vgic_send_sgi_msg(struct vcpu* vcpu, cpumap_t pcpu_mask, irqid_t int_id)
         VGIC_MSG_DATA(cpu()->vcpu->vm->id, 0, int_id, 0, cpu()->vcpu->id),
     };
 
-    for (size_t i = 0; i < platform.cpu_num; i++) {
-        if (pcpu_mask & (1ull << i)) {
-            cpu_send_msg(i, &msg);
-        }
-    }
+    cpu_send_msg_mask(pcpu_mask, &msg);
 }
 
 void vgic_route(struct vcpu* vcpu, struct vgic_int* interrupt)
@@ -160,11 +166,7 @@ void vgic_route(struct vcpu* vcpu, struct vgic_int* interrupt)
         };
         vgic_yield_ownership(vcpu, interrupt);
         cpumap_t trgtlist = vgic_int_ptarget_mask(vcpu, interrupt) & ~(1ull << vcpu->phys_id);
-        for (size_t i = 0; i < platform.cpu_num; i++) {
-            if (trgtlist & (1ull << i)) {
-                cpu_send_msg(i, &msg);
-            }
-        }
+        cpu_send_msg_mask(trgtlist, &msg);
     }
 }
 
@@ -281,20 +283,34 @@ bool vgic_remove_lr(struct vcpu* vcpu, struct vgic_int* interrupt)
     return ret;
 }
 
-void vgic_add_spilled(struct vcpu* vcpu, struct vgic_int* interrupt)
+void vgic_spilled_init(struct vgic_spilled* spilled)
 {
-    spin_lock(&vcpu->vm->arch.vgic_spilled_lock);
-    struct list* spilled_list = NULL;
-    if (gic_is_priv(interrupt->id)) {
-        spilled_list = &vcpu->arch.vgic_spilled;
-    } else {
-        spilled_list = &vcpu->vm->arch.vgic_spilled;
+    spilled->lock = SPINLOCK_INITVAL;
+    spilled->bitmap = 0;
+    for (size_t i = 0; i < VGIC_SPILLED_BUCKETS; i++) {
+        list_init(&spilled->buckets[i]);
     }
-    list_push(spilled_list, (node_t*)interrupt);
-    spin_unlock(&vcpu->vm->arch.vgic_spilled_lock);
+}
+
+void vgic_add_spilled(struct vcpu* vcpu, struct vgic_int* interrupt)
+{
+    struct vgic_spilled* spilled = interrupt->spilled;
+    size_t bucket = VGIC_SPILLED_BUCKET(interrupt->prio);
+    spin_lock(&spilled->lock);
+    list_push(&spilled->buckets[bucket], (node_t*)interrupt);
+    spilled->bitmap = bit32_set(spilled->bitmap, bucket);
+    spin_unlock(&spilled->lock);
     gich_set_hcr(gich_get_hcr() | GICH_HCR_NPIE_BIT);
 }
 
+static void vgic_spilled_rm(struct vgic_spilled* spilled, struct list* list, struct vgic_int* irq)
+{
+    list_rm(list, &irq->node);
+    if (list_empty(list)) {
+        spilled->bitmap = bit32_clear(spilled->bitmap, (size_t)(list - spilled->buckets));
+    }
+}
+
 void vgic_spill_lr(struct vcpu* vcpu, unsigned lr_ind)
 {
     unsigned long lr = gich_read_lr(lr_ind);
@@ -390,6 +406,23 @@ static inline void vgic_update_enable(struct vcpu* vcpu)
     }
 }
 
+static void vgic_update_vsgi(struct vm* vm)
+{
+#if (GIC_VERSION != GICV2)
+    bool vsgi = !!(vm->arch.vgicd.CTLR & GICD_CTLR_nASSGIreq_BIT);
+    for (vcpuid_t vcpuid = 0; vcpuid < vm->cpu_num; vcpuid++) {
+        struct vcpu* vcpu = vm_get_vcpu(vm, vcpuid);
+        for (irqid_t id = 0; id < GIC_MAX_SGIS; id++) {
+            struct vgic_int* interrupt = &vcpu->arch.vgic_priv.interrupts[id];
+            spin_lock(&interrupt->lock);
+            gicv4_vsgi_config(interrupt->phys.redist, id, vsgi && interrupt->enabled,
+                interrupt->prio, false);
+            spin_unlock(&interrupt->lock);
+        }
+    }
+#endif
+}
+
 void vgicd_emul_misc_access(struct emul_access* acc, struct vgic_reg_handler_info* handlers,
     bool gicr_access, cpuid_t vgicr_id)
 {
@@ -400,8 +433,18 @@ void vgicd_emul_misc_access(struct emul_access* acc, struct vgic_reg_handler_inf
         case GICD_REG_IND(CTLR):
             if (acc->write) {
                 uint32_t prev_ctrl = vgicd->CTLR;
-                vgicd->CTLR = vcpu_readreg(cpu()->vcpu, acc->reg) & VGIC_ENABLE_MASK;
-                if (prev_ctrl ^ vgicd->CTLR) {
+                uint32_t ctrl_mask = VGIC_ENABLE_MASK;
+                /* nASSGIreq can only be changed while the distributor is disabled */
+                if ((vgicd->TYPER2 & GICD_TYPER2_nASSGIcap_BIT) &&
+                    !(prev_ctrl & VGIC_ENABLE_MASK)) {
+                    ctrl_mask |= GICD_CTLR_nASSGIreq_BIT;
+                }
+                vgicd->CTLR = (prev_ctrl & ~ctrl_mask) |
+                    (vcpu_readreg(cpu()->vcpu, acc->reg) & ctrl_mask);
+                if ((prev_ctrl ^ vgicd->CTLR) & GICD_CTLR_nASSGIreq_BIT) {
+                    vgic_update_vsgi(cpu()->vcpu->vm);
+                }
+                if ((prev_ctrl ^ vgicd->CTLR) & VGIC_ENABLE_MASK) {
                     vgic_update_enable(cpu()->vcpu);
                     struct cpu_msg msg = {
                         VGIC_IPI_ID,
@@ -424,6 +467,11 @@ void vgicd_emul_misc_access(struct emul_access* acc, struct vgic_reg_handler_inf
                 vcpu_writereg(cpu()->vcpu, acc->reg, vgicd->IIDR);
             }
             break;
+        case GICD_REG_IND(TYPER2):
+            if (!acc->write) {
+                vcpu_writereg(cpu()->vcpu, acc->reg, vgicd->TYPER2);
+            }
+            break;
     }
 }
 
@@ -542,6 +590,11 @@ bool vgic_int_set_pend(struct vcpu* vcpu, struct vgic_int* interrupt, unsigned l
 
 unsigned long vgic_int_get_pend(struct vcpu* vcpu, struct vgic_int* interrupt)
 {
+#if (GIC_VERSION != GICV2)
+    if (vgic_int_is_vsgi(vcpu, interrupt)) {
+        return bit32_get(gicv4_vsgi_get_pend(interrupt->phys.redist), interrupt->id) ? 1 : 0;
+    }
+#endif
     return (interrupt->state & PEND) ? 1 : 0;
 }
 
@@ -611,6 +664,26 @@ bool vgic_int_set_prio(struct vcpu* vcpu, struct vgic_int* interrupt, unsigned l
 {
     uint8_t prev_prio = interrupt->prio;
     interrupt->prio = (uint8_t)prio & BIT_MASK(8 - GICH_LR_PRIO_LEN, GICH_LR_PRIO_LEN);
+
+    /* A spilled interrupt must move to the bucket of its new priority */
+    size_t prev_bucket = VGIC_SPILLED_BUCKET(prev_prio);
+    size_t bucket = VGIC_SPILLED_BUCKET(interrupt->prio);
+    if (prev_bucket != bucket) {
+        /* Private interrupts are spilled to their own vcpu's queue, not the accessing vcpu's */
+        struct vgic_spilled* spilled = interrupt->spilled;
+        struct list* prev_list = &spilled->buckets[prev_bucket];
+        spin_lock(&spilled->lock);
+        list_foreach ((*prev_list), struct vgic_int, temp_irq) {
+            if (temp_irq == interrupt) {
+                vgic_spilled_rm(spilled, prev_list, interrupt);
+                list_push(&spilled->buckets[bucket], &interrupt->node);
+                spilled->bitmap = bit32_set(spilled->bitmap, bucket);
+                break;
+            }
+        }
+        spin_unlock(&spilled->lock);
+    }
+
     return prev_prio != prio;
 }
 
@@ -640,11 +713,45 @@ void vgic_emul_razwi(struct emul_access* acc, struct vgic_reg_handler_info* hand
     }
 }
 
+static void vgic_vsgi_set_field(struct vgic_reg_handler_info* handlers, struct vcpu* vcpu,
+    struct vgic_int* interrupt, unsigned long data)
+{
+#if (GIC_VERSION != GICV2)
+    vpeid_t vpeid = interrupt->phys.redist;
+
+    switch (handlers->regid) {
+        case VGIC_ISPENDR_ID:
+            if (data) {
+                gicv4_vsgi_send(vpeid, interrupt->id);
+            }
+            break;
+        case VGIC_ICPENDR_ID:
+            if (data) {
+                gicv4_vsgi_config(vpeid, interrupt->id, interrupt->enabled, interrupt->prio, true);
+            }
+            break;
+        case VGIC_ISENABLER_ID:
+        case VGIC_ICENABLER_ID:
+        case VGIC_IPRIORITYR_ID:
+            if (handlers->update_field(vcpu, interrupt, data)) {
+                gicv4_vsgi_config(vpeid, interrupt->id, interrupt->enabled, interrupt->prio,
+                    false);
+            }
+            break;
+        default:
+            /* SGIs have neither active state nor configurable trigger mode */
+            break;
+    }
+#endif
+}
+
 void vgic_int_set_field(struct vgic_reg_handler_info* handlers, struct vcpu* vcpu,
     struct vgic_int* interrupt, unsigned long data)
 {
     spin_lock(&interrupt->lock);
-    if (vgic_get_ownership(vcpu, interrupt)) {
+    if (vgic_int_is_vsgi(vcpu, interrupt)) {
+        vgic_vsgi_set_field(handlers, vcpu, interrupt, data);
+    } else if (vgic_get_ownership(vcpu, interrupt)) {
         vgic_remove_lr(vcpu, interrupt);
         if (handlers->update_field(vcpu, interrupt, data) && vgic_int_is_hw(interrupt)) {
             handlers->update_hw(vcpu, interrupt);
@@ -968,36 +1075,85 @@ void vgic_ipi_handler(uint32_t event, uint64_t data)
     }
 }
 
+static inline bool vgic_int_higher_prio(struct vgic_int* a, struct vgic_int* b)
+{
+    return (b == NULL) || (a->prio < b->prio) || ((a->prio == b->prio) && (a->id < b->id));
+}
+
 /**
- * Must be called holding the vgic_spilled_lock
+ * Must be called holding the spilled queue lock. Buckets are scanned from the highest priority
+ * one, so only the first non-empty bucket holding an interrupt in the requested state is walked.
+ * A bucket spans several priorities, so within it we still select by priority and id.
  */
-static inline struct vgic_int* vgic_highest_prio_spilled(struct vcpu* vcpu, unsigned flags,
+static struct vgic_int* vgic_spilled_highest(struct vgic_spilled* spilled, unsigned flags,
     struct list** outlist)
 {
-    struct vgic_int* irq = NULL;
-    struct list* spilled_lists[] = {
-        &vcpu->arch.vgic_spilled,
-        &vcpu->vm->arch.vgic_spilled,
-    };
-    size_t spilled_list_size = sizeof(spilled_lists) / sizeof(struct list*);
-    for (size_t i = 0; i < spilled_list_size; i++) {
-        struct list* list = spilled_lists[i];
+    uint32_t bitmap = spilled->bitmap;
+    ssize_t bucket = bit32_ffs(bitmap);
+
+    while (bucket >= 0) {
+        struct vgic_int* irq = NULL;
+        struct list* list = &spilled->buckets[bucket];
         list_foreach ((*list), struct vgic_int, temp_irq) {
-            if (!(vgic_get_state(temp_irq) & flags)) {
-                continue;
-            }
-            bool irq_is_null = irq == NULL;
-            uint8_t irq_prio = irq_is_null ? GIC_LOWEST_PRIO : irq->prio;
-            irqid_t irq_id = irq_is_null ? GIC_MAX_VALID_INTERRUPTS : irq->id;
-            bool is_higher_prio = (temp_irq->prio < irq_prio);
-            bool is_same_prio = temp_irq->prio == irq_prio;
-            bool is_lower_id = temp_irq->id < irq_id;
-            if (is_higher_prio || (is_same_prio && is_lower_id)) {
+            if ((vgic_get_state(temp_irq) & flags) && vgic_int_higher_prio(temp_irq, irq)) {
                 irq = temp_irq;
-                *outlist = list;
             }
         }
+        if (irq != NULL) {
+            *outlist = list;
+            return irq;
+        }
+        bitmap = bit32_clear(bitmap, (size_t)bucket);
+        bucket = bit32_ffs(bitmap);
+    }
+
+    return NULL;
+}
+
+/**
+ * Locks the vcpu's private spilled queue and, only if it holds any interrupt, the vm's shared
+ * one. This way vcpus do not serialize on the vm-wide lock when no SPIs are spilled. Returns
+ * whether the shared queue was locked and must be considered.
+ */
+static bool vgic_spilled_lock(struct vcpu* vcpu)
+{
+    bool shared = false;
+    spin_lock(&vcpu->arch.vgic_spilled.lock);
+    if (vcpu->vm->arch.vgic_spilled.bitmap != 0) {
+        spin_lock(&vcpu->vm->arch.vgic_spilled.lock);
+        shared = true;
+    }
+    return shared;
+}
+
+static void vgic_spilled_unlock(struct vcpu* vcpu, bool shared)
+{
+    if (shared) {
+        spin_unlock(&vcpu->vm->arch.vgic_spilled.lock);
+    }
+    spin_unlock(&vcpu->arch.vgic_spilled.lock);
+}
+
+/**
+ * Must be called holding the spilled queue locks, see vgic_spilled_lock.
+ */
+static inline struct vgic_int* vgic_highest_prio_spilled(struct vcpu* vcpu, bool shared,
+    unsigned flags, struct vgic_spilled** outspilled, struct list** outlist)
+{
+    struct list* list = NULL;
+    struct vgic_int* irq = vgic_spilled_highest(&vcpu->arch.vgic_spilled, flags, outlist);
+    *outspilled = &vcpu->arch.vgic_spilled;
+
+    if (shared) {
+        struct vgic_int* shared_irq =
+            vgic_spilled_highest(&vcpu->vm->arch.vgic_spilled, flags, &list);
+        if (shared_irq != NULL && vgic_int_higher_prio(shared_irq, irq)) {
+            irq = shared_irq;
+            *outspilled = &vcpu->vm->arch.vgic_spilled;
+            *outlist = list;
+        }
     }
+
     return irq;
 }
 
@@ -1006,15 +1162,16 @@ static void vgic_refill_lrs(struct vcpu* vcpu, bool npie)
     uint64_t elrsr = gich_get_elrsr();
     ssize_t lr_ind = bit64_ffs(elrsr & BIT64_MASK(0, NUM_LRS));
     unsigned flags = npie ? PEND : ACT | PEND;
-    spin_lock(&vcpu->vm->arch.vgic_spilled_lock);
+    bool shared = vgic_spilled_lock(vcpu);
     while (lr_ind >= 0) {
+        struct vgic_spilled* spilled = NULL;
         struct list* list = NULL;
-        struct vgic_int* irq = vgic_highest_prio_spilled(vcpu, flags, &list);
+        struct vgic_int* irq = vgic_highest_prio_spilled(vcpu, shared, flags, &spilled, &list);
         if (irq != NULL) {
             spin_lock(&irq->lock);
             bool got_ownership = vgic_get_ownership(vcpu, irq);
             if (got_ownership) {
-                list_rm(list, &irq->node);
+                vgic_spilled_rm(spilled, list, irq);
                 vgic_write_lr(vcpu, irq, lr_ind);
             }
             spin_unlock(&irq->lock);
@@ -1030,13 +1187,16 @@ static void vgic_refill_lrs(struct vcpu* vcpu, bool npie)
         elrsr = gich_get_elrsr();
         lr_ind = bit64_ffs(elrsr & BIT64_MASK(0, NUM_LRS));
     }
-    spin_unlock(&vcpu->vm->arch.vgic_spilled_lock);
+    vgic_spilled_unlock(vcpu, shared);
 }
 
 static void vgic_eoir_highest_spilled_active(struct vcpu* vcpu)
 {
+    struct vgic_spilled* spilled = NULL;
     struct list* list = NULL;
-    struct vgic_int* interrupt = vgic_highest_prio_spilled(vcpu, ACT, &list);
+    bool shared = vgic_spilled_lock(vcpu);
+    struct vgic_int* interrupt = vgic_highest_prio_spilled(vcpu, shared, ACT, &spilled, &list);
+    vgic_spilled_unlock(vcpu, shared);
 
     if (interrupt != NULL) {
         spin_lock(&interrupt->lock);
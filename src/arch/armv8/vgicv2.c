@@ -132,6 +132,7 @@ void vgic_init(struct vm* vm, const struct vgic_dscrp* vgic_dscrp)
     vm->arch.vgicd.TYPER = ((vtyper_itln << GICD_TYPER_ITLN_OFF) & GICD_TYPER_ITLN_MSK) |
         (((vm->cpu_num - 1) << GICD_TYPER_CPUNUM_OFF) & GICD_TYPER_CPUNUM_MSK);
     vm->arch.vgicd.IIDR = gicd->IIDR;
+    vm->arch.vgicd.TYPER2 = 0;
 
     size_t n = NUM_PAGES(sizeof(struct gicc_hw));
     mem_alloc_map_dev(&vm->as, SEC_VM_ANY, (vaddr_t)vgic_dscrp->gicc_addr,
@@ -145,6 +146,7 @@ void vgic_init(struct vm* vm, const struct vgic_dscrp* vgic_dscrp)
 
     for (size_t i = 0; i < vm->arch.vgicd.int_num; i++) {
         vm->arch.vgicd.interrupts[i].owner = NULL;
+        vm->arch.vgicd.interrupts[i].spilled = &vm->arch.vgic_spilled;
         vm->arch.vgicd.interrupts[i].lock = SPINLOCK_INITVAL;
         vm->arch.vgicd.interrupts[i].id = i + GIC_CPU_PRIV;
         vm->arch.vgicd.interrupts[i].state = INV;
@@ -161,14 +163,14 @@ void vgic_init(struct vm* vm, const struct vgic_dscrp* vgic_dscrp)
         .handler = vgicd_emul_handler };
     vm_emul_add_mem(vm, &vm->arch.vgicd_emul);
 
-    list_init(&vm->arch.vgic_spilled);
-    vm->arch.vgic_spilled_lock = SPINLOCK_INITVAL;
+    vgic_spilled_init(&vm->arch.vgic_spilled);
 }
 
 void vgic_cpu_init(struct vcpu* vcpu)
 {
     for (size_t i = 0; i < GIC_CPU_PRIV; i++) {
         vcpu->arch.vgic_priv.interrupts[i].owner = vcpu;
+        vcpu->arch.vgic_priv.interrupts[i].spilled = &vcpu->arch.vgic_spilled;
         vcpu->arch.vgic_priv.interrupts[i].lock = SPINLOCK_INITVAL;
         vcpu->arch.vgic_priv.interrupts[i].id = i;
         vcpu->arch.vgic_priv.interrupts[i].state = INV;
@@ -185,5 +187,14 @@ void vgic_cpu_init(struct vcpu* vcpu)
         vcpu->arch.vgic_priv.interrupts[i].enabled = true;
     }
 
-    list_init(&vcpu->arch.vgic_spilled);
+    vgic_spilled_init(&vcpu->arch.vgic_spilled);
 }
+
+void vgic_cpu_vpe_init(struct vcpu* vcpu) { }
+
+bool vgic_vcpu_standby_enter(struct vcpu* vcpu)
+{
+    return true;
+}
+
+void vgic_vcpu_standby_exit(struct vcpu* vcpu) { }
@@ -5,6 +5,7 @@
 
 #include <arch/vgic.h>
 #include <arch/vgicv3.h>
+#include <arch/gicv4.h>
 
 #include <bit.h>
 #include <spinlock.h>
@@ -15,7 +16,7 @@
 
 #define GICR_IS_REG(REG, offset)                    \
     (((offset) >= offsetof(struct gicr_hw, REG)) && \
-        (offset) < (offsetof(struct gicr_hw, REG) + sizeof(gicr[0].REG)))
+        (offset) < (offsetof(struct gicr_hw, REG) + sizeof(gicr[0]->REG)))
 #define GICR_REG_OFF(REG)   (offsetof(struct gicr_hw, REG) & 0x1ffff)
 #define GICR_REG_MASK(ADDR) ((ADDR) & 0x1ffff)
 #define GICD_REG_MASK(ADDR) ((ADDR) & (GIC_VERSION == GICV2 ? 0xfffUL : 0xffffUL))
@@ -80,8 +81,36 @@ void vgic_int_set_route_hw(struct vcpu* vcpu, struct vgic_int* interrupt)
 void vgicr_emul_ctrl_access(struct emul_access* acc, struct vgic_reg_handler_info* handlers,
     bool gicr_access, vcpuid_t vgicr_id)
 {
+    struct vm* vm = cpu()->vcpu->vm;
+    struct vgicr* vgicr = &vm_get_vcpu(vm, vgicr_id)->arch.vgic_priv.vgicr;
+
+    if (!acc->write) {
+        vcpu_writereg(cpu()->vcpu, acc->reg, vgicr->CTLR);
+    } else if (vgits_present(vm) && !(vgicr->CTLR & GICR_CTLR_ENLPI_BIT) &&
+        (vcpu_readreg(cpu()->vcpu, acc->reg) & GICR_CTLR_ENLPI_BIT)) {
+        /* Once enabled, LPIs can't be disabled (GICR_CTLR.EnableLPIs is then RES1) */
+        vgicr->CTLR |= GICR_CTLR_ENLPI_BIT;
+        vgits_enable_lpis(vm, vgicr->PROPBASER);
+    }
+}
+
+void vgicr_emul_lpi_baser_access(struct emul_access* acc, struct vgic_reg_handler_info* handlers,
+    bool gicr_access, vcpuid_t vgicr_id)
+{
+    struct vm* vm = cpu()->vcpu->vm;
+    struct vgicr* vgicr = &vm_get_vcpu(vm, vgicr_id)->arch.vgic_priv.vgicr;
+    bool propbaser = GICR_IS_REG(PROPBASER, GICR_REG_MASK(acc->addr - vm->arch.vgicr_addr));
+    uint64_t* reg = propbaser ? &vgicr->PROPBASER : &vgicr->PENDBASER;
+    uint64_t wr_msk = propbaser ? GICR_PROPBASER_WR_MSK : GICR_PENDBASER_WR_MSK;
+
+    if (!vgits_present(vm)) {
+        return vgic_emul_razwi(acc, handlers, gicr_access, vgicr_id);
+    }
+
     if (!acc->write) {
-        vcpu_writereg(cpu()->vcpu, acc->reg, 0);
+        vcpu_writereg(cpu()->vcpu, acc->reg, vgic_reg64_read(acc, *reg));
+    } else if (!(vgicr->CTLR & GICR_CTLR_ENLPI_BIT)) {
+        *reg = vgic_reg64_write(acc, *reg) & wr_msk;
     }
 }
 
@@ -112,7 +141,7 @@ void vgicr_emul_pidr_access(struct emul_access* acc, struct vgic_reg_handler_inf
         unsigned long val = 0;
         cpuid_t pgicr_id = vm_translate_to_pcpuid(cpu()->vcpu->vm, vgicr_id);
         if (pgicr_id != INVALID_CPUID) {
-            val = gicr[pgicr_id].ID[((acc->addr & 0xff) - 0xd0) / 4];
+            val = gicr[pgicr_id]->ID[((acc->addr & 0xff) - 0xd0) / 4];
         }
         vcpu_writereg(cpu()->vcpu, acc->reg, val);
     }
@@ -183,6 +212,10 @@ struct vgic_reg_handler_info vgicr_typer_info = {
     vgicr_emul_typer_access,
     0b1100,
 };
+struct vgic_reg_handler_info vgicr_lpi_baser_info = {
+    vgicr_emul_lpi_baser_access,
+    0b1100,
+};
 struct vgic_reg_handler_info vgicr_pidr_info = {
     vgicr_emul_pidr_access,
     0b0100,
@@ -229,6 +262,9 @@ bool vgicr_emul_handler(struct emul_access* acc)
                 handler_info = &vgicr_typer_info;
             } else if (GICR_IS_REG(IPRIORITYR, acc_offset)) {
                 handler_info = &ipriorityr_info;
+            } else if (GICR_IS_REG(PROPBASER, acc_offset) ||
+                GICR_IS_REG(PENDBASER, acc_offset)) {
+                handler_info = &vgicr_lpi_baser_info;
             } else if (GICR_IS_REG(ID, acc_offset)) {
                 handler_info = &vgicr_pidr_info;
             } else {
@@ -270,7 +306,20 @@ bool vgic_icc_sgir_handler(struct emul_access* acc)
             trgtlist = vm_translate_to_pcpu_mask(cpu()->vcpu->vm, ICC_SGIR_TRGLSTFLT(sgir),
                 cpu()->vcpu->vm->cpu_num);
         }
-        vgic_send_sgi_msg(cpu()->vcpu, trgtlist, int_id);
+
+        if (cpu()->vcpu->vm->arch.vgicd.CTLR & GICD_CTLR_nASSGIreq_BIT) {
+            /**
+             * The vPE ids are the physical cpu ids, so the vSGI goes straight to the target vcpus
+             * without interrupting them.
+             */
+            for (cpuid_t pcpu = 0; pcpu < PLAT_CPU_NUM; pcpu++) {
+                if (trgtlist & (1U << pcpu)) {
+                    gicv4_vsgi_send(pcpu, int_id);
+                }
+            }
+        } else {
+            vgic_send_sgi_msg(cpu()->vcpu, trgtlist, int_id);
+        }
     }
 
     return true;
@@ -294,6 +343,14 @@ void vgic_init(struct vm* vm, const struct vgic_dscrp* vgic_dscrp)
         (((vm->cpu_num - 1) << GICD_TYPER_CPUNUM_OFF) & GICD_TYPER_CPUNUM_MSK) |
         (((10 - 1) << GICD_TYPER_IDBITS_OFF) & GICD_TYPER_IDBITS_MSK);
     vm->arch.vgicd.IIDR = gicd->IIDR;
+    vm->arch.vgicd.TYPER2 = gicv4_vsgi_support ? GICD_TYPER2_nASSGIcap_BIT : 0;
+
+    vgits_init(vm, vgic_dscrp);
+    if (vgits_present(vm)) {
+        vm->arch.vgicd.TYPER = (vm->arch.vgicd.TYPER & ~GICD_TYPER_IDBITS_MSK) |
+            GICD_TYPER_LPIS_BIT |
+            (((GICV4_LPI_ID_BITS - 1) << GICD_TYPER_IDBITS_OFF) & GICD_TYPER_IDBITS_MSK);
+    }
 
     size_t vgic_int_size = vm->arch.vgicd.int_num * sizeof(struct vgic_int);
     vm->arch.vgicd.interrupts = mem_alloc_page(NUM_PAGES(vgic_int_size), SEC_HYP_VM, false);
@@ -303,6 +360,7 @@ void vgic_init(struct vm* vm, const struct vgic_dscrp* vgic_dscrp)
 
     for (size_t i = 0; i < vm->arch.vgicd.int_num; i++) {
         vm->arch.vgicd.interrupts[i].owner = NULL;
+        vm->arch.vgicd.interrupts[i].spilled = &vm->arch.vgic_spilled;
         vm->arch.vgicd.interrupts[i].lock = SPINLOCK_INITVAL;
         vm->arch.vgicd.interrupts[i].id = i + GIC_CPU_PRIV;
         vm->arch.vgicd.interrupts[i].state = INV;
@@ -325,9 +383,15 @@ void vgic_init(struct vm* vm, const struct vgic_dscrp* vgic_dscrp)
         uint64_t typer = (uint64_t)vcpu->id << GICR_TYPER_PRCNUM_OFF;
         typer |= ((uint64_t)vcpu->arch.vmpidr & MPIDR_AFF_MSK) << GICR_TYPER_AFFVAL_OFF;
         typer |= !!(vcpu->id == vcpu->vm->cpu_num - 1) << GICR_TYPER_LAST_OFF;
+        if (vgits_present(vm)) {
+            typer |= GICR_TYPER_PLPIS_BIT;
+        }
         vcpu->arch.vgic_priv.vgicr.TYPER = typer;
+        vcpu->arch.vgic_priv.vgicr.CTLR = 0;
+        vcpu->arch.vgic_priv.vgicr.PROPBASER = 0;
+        vcpu->arch.vgic_priv.vgicr.PENDBASER = 0;
 
-        vcpu->arch.vgic_priv.vgicr.IIDR = gicr[cpu()->id].IIDR;
+        vcpu->arch.vgic_priv.vgicr.IIDR = gicr[cpu()->id]->IIDR;
     }
 
     vm->arch.vgicr_emul = (struct emul_mem){ .va_base = vgic_dscrp->gicr_addr,
@@ -343,14 +407,14 @@ void vgic_init(struct vm* vm, const struct vgic_dscrp* vgic_dscrp)
         .handler = vgic_icc_sre_handler };
     vm_emul_add_reg(vm, &vm->arch.icc_sre_emul);
 
-    list_init(&vm->arch.vgic_spilled);
-    vm->arch.vgic_spilled_lock = SPINLOCK_INITVAL;
+    vgic_spilled_init(&vm->arch.vgic_spilled);
 }
 
 void vgic_cpu_init(struct vcpu* vcpu)
 {
     for (size_t i = 0; i < GIC_CPU_PRIV; i++) {
         vcpu->arch.vgic_priv.interrupts[i].owner = NULL;
+        vcpu->arch.vgic_priv.interrupts[i].spilled = &vcpu->arch.vgic_spilled;
         vcpu->arch.vgic_priv.interrupts[i].lock = SPINLOCK_INITVAL;
         vcpu->arch.vgic_priv.interrupts[i].id = i;
         vcpu->arch.vgic_priv.interrupts[i].state = INV;
@@ -367,5 +431,27 @@ void vgic_cpu_init(struct vcpu* vcpu)
         vcpu->arch.vgic_priv.interrupts[i].cfg = 0b10;
     }
 
-    list_init(&vcpu->arch.vgic_spilled);
+    vgic_spilled_init(&vcpu->arch.vgic_spilled);
+}
+
+void vgic_cpu_vpe_init(struct vcpu* vcpu)
+{
+    if (gicv4_vsgi_support) {
+        gicv4_vpe_init(vcpu->phys_id, vcpu->vm->arch.vgits.vconf_pa);
+    }
+}
+
+bool vgic_vcpu_standby_enter(struct vcpu* vcpu)
+{
+    if (!gicv4_vsgi_support) {
+        return true;
+    }
+    return gicv4_vpe_deschedule();
+}
+
+void vgic_vcpu_standby_exit(struct vcpu* vcpu)
+{
+    if (gicv4_vsgi_support) {
+        gicv4_vpe_schedule(vcpu->phys_id);
+    }
 }
@@ -0,0 +1,503 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <arch/vgic.h>
+#include <arch/vgicv3.h>
+#include <arch/gicv4.h>
+
+#include <bit.h>
+#include <cpu.h>
+#include <mem.h>
+#include <cache.h>
+#include <string.h>
+#include <vm.h>
+#include <config.h>
+#include <platform.h>
+
+#define VGITS_IS_REG(REG, offset)                   \
+    (((offset) >= offsetof(struct gits_hw, REG)) && \
+        ((offset) < (offsetof(struct gits_hw, REG) + sizeof(((struct gits_hw*)0)->REG))))
+
+#define VGITS_ITTESZ               (8)
+#define VGITS_CBASER_WR_MSK        (GITS_CBASER_VALID_BIT | GITS_CBASER_PA_MSK | BIT64_MASK(0, 8))
+#define VGITS_TRANSLATER_FRAME_OFF (0x10000)
+
+/**
+ * Maximum number of guest commands translated per trap. The rest are left for the next CWRITER
+ * write or CREADR poll, so a large guest queue does not keep the cpu in the hypervisor.
+ */
+#define VGITS_CMD_BURST_MAX        (32)
+
+static inline struct vgits_dev* vgits_get_dev(struct vgits* vgits, deviceid_t devid)
+{
+    for (size_t i = 0; i < vgits->dev_num; i++) {
+        if (vgits->devs[i].id == devid) {
+            return &vgits->devs[i];
+        }
+    }
+    return NULL;
+}
+
+static struct vgits_event* vgits_get_event(struct vgits* vgits, struct gits_cmd* cmd,
+    struct vgits_dev** dev)
+{
+    deviceid_t devid = bit64_extract(cmd->dw[0], GITS_CMD_DEVID_OFF, GITS_CMD_DEVID_LEN);
+    uint32_t eventid = bit64_extract(cmd->dw[1], GITS_CMD_EVENTID_OFF, GITS_CMD_EVENTID_LEN);
+
+    *dev = vgits_get_dev(vgits, devid);
+    if (*dev == NULL || !(*dev)->valid || (eventid >> (*dev)->event_bits) != 0) {
+        return NULL;
+    }
+
+    return &(*dev)->events[eventid];
+}
+
+static inline uint32_t vgits_event_id(struct vgits_dev* dev, struct vgits_event* event)
+{
+    return (uint32_t)(event - dev->events);
+}
+
+static inline struct vcpu* vgits_coll_vcpu(struct vm* vm, struct vgits* vgits, size_t icid)
+{
+    if (icid >= vm->cpu_num || vgits->colls[icid] == INVALID_CPUID) {
+        return NULL;
+    }
+    return vm_get_vcpu(vm, vgits->colls[icid]);
+}
+
+static bool vgits_guest_range_valid(struct vm* vm, paddr_t addr, size_t size)
+{
+    for (size_t i = 0; i < vm->config->platform.region_num; i++) {
+        struct vm_mem_region* reg = &vm->config->platform.regions[i];
+        if (range_in_range(addr, size, reg->base, reg->size)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * The guest's LPI configuration table is never read by the hardware. Instead, the entry of a vLPI
+ * is copied to the VM's vLPI configuration table whenever it is mapped or invalidated.
+ */
+static void vgits_sync_lpi_prop(struct vgits* vgits, irqid_t vintid)
+{
+    size_t index = vintid - GIC_FIRST_LPI;
+    uint8_t prop = 0;
+
+    if (vgits->lpi_prop != NULL && index < vgits->lpi_prop_size) {
+        prop = vgits->lpi_prop[index];
+    }
+
+    vgits->vconf[index] = prop;
+    cache_flush_range((vaddr_t)&vgits->vconf[index], sizeof(uint8_t));
+}
+
+static void vgits_inv_coll(struct vm* vm, struct vgits* vgits, size_t icid)
+{
+    struct vcpu* vcpu = vgits_coll_vcpu(vm, vgits, icid);
+    if (vcpu == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < vgits->dev_num; i++) {
+        struct vgits_dev* dev = &vgits->devs[i];
+        for (size_t j = 0; dev->valid && j < (1UL << dev->event_bits); j++) {
+            if (dev->events[j].valid && dev->events[j].icid == icid) {
+                vgits_sync_lpi_prop(vgits, dev->events[j].vintid);
+            }
+        }
+    }
+
+    gicv4_its_vinvall(&vgits->batch, vcpu->phys_id);
+}
+
+static void vgits_unmap_dev(struct vgits* vgits, struct vgits_dev* dev)
+{
+    if (!dev->valid) {
+        return;
+    }
+
+    /* The its must be done with the device's ITT before it is freed */
+    gicv4_its_mapd(&vgits->batch, cpu()->vcpu->phys_id, dev->id, dev->event_bits, 0, false);
+    gicv4_its_batch_submit(&vgits->batch);
+    mem_unmap(&cpu()->as, (vaddr_t)dev->itt, dev->itt_pages, true);
+    mem_unmap(&cpu()->as, (vaddr_t)dev->events,
+        NUM_PAGES((1UL << dev->event_bits) * sizeof(struct vgits_event)), true);
+    dev->valid = false;
+}
+
+static void vgits_cmd_mapd(struct vgits* vgits, struct gits_cmd* cmd)
+{
+    deviceid_t devid = bit64_extract(cmd->dw[0], GITS_CMD_DEVID_OFF, GITS_CMD_DEVID_LEN);
+    size_t event_bits = bit64_extract(cmd->dw[1], GITS_CMD_SIZE_OFF, GITS_CMD_SIZE_LEN) + 1;
+    size_t guest_event_bits =
+        bit64_extract(vgits->TYPER, GITS_TYPER_IDBITS_OFF, GITS_TYPER_IDBITS_LEN) + 1;
+    struct vgits_dev* dev = vgits_get_dev(vgits, devid);
+
+    if (dev == NULL) {
+        return;
+    }
+
+    /* Remapping a device discards all of its previous mappings */
+    vgits_unmap_dev(vgits, dev);
+
+    if (!(cmd->dw[2] & GITS_CMD_VALID_BIT) || event_bits > guest_event_bits) {
+        return;
+    }
+
+    size_t events_size = (1UL << event_bits) * sizeof(struct vgits_event);
+    dev->events = mem_alloc_page(NUM_PAGES(events_size), SEC_HYP_VM, false);
+    if (dev->events == NULL) {
+        return;
+    }
+    memset(dev->events, 0, events_size);
+
+    paddr_t itt_pa;
+    dev->itt = gicv4_its_itt_alloc(event_bits, &itt_pa, &dev->itt_pages);
+    if (dev->itt == NULL) {
+        mem_unmap(&cpu()->as, (vaddr_t)dev->events, NUM_PAGES(events_size), true);
+        return;
+    }
+
+    dev->event_bits = event_bits;
+    gicv4_its_mapd(&vgits->batch, cpu()->vcpu->phys_id, devid, event_bits, itt_pa, true);
+    dev->valid = true;
+}
+
+static void vgits_cmd_mapc(struct vm* vm, struct vgits* vgits, struct gits_cmd* cmd)
+{
+    size_t icid = bit64_extract(cmd->dw[2], GITS_CMD_ICID_OFF, GITS_CMD_ICID_LEN);
+    vcpuid_t target = bit64_extract(cmd->dw[2], GITS_CMD_RDBASE_OFF, GITS_CMD_RDBASE_LEN);
+
+    if (icid >= vm->cpu_num) {
+        return;
+    }
+
+    if (!(cmd->dw[2] & GITS_CMD_VALID_BIT)) {
+        vgits->colls[icid] = INVALID_CPUID;
+        return;
+    }
+
+    if (target >= vm->cpu_num) {
+        return;
+    }
+
+    /**
+     * Events follow their collection, so moving a collection with mapped events moves all of their
+     * vLPIs (and pending state) to the new target vPE.
+     */
+    bool moved = vgits->colls[icid] != INVALID_CPUID && vgits->colls[icid] != target;
+    vgits->colls[icid] = target;
+    vpeid_t vpeid = vm_get_vcpu(vm, target)->phys_id;
+
+    for (size_t i = 0; moved && i < vgits->dev_num; i++) {
+        struct vgits_dev* dev = &vgits->devs[i];
+        for (size_t j = 0; dev->valid && j < (1UL << dev->event_bits); j++) {
+            if (dev->events[j].valid && dev->events[j].icid == icid) {
+                gicv4_its_vmovi(&vgits->batch, vpeid, dev->id, (uint32_t)j);
+            }
+        }
+    }
+}
+
+static void vgits_cmd_mapti(struct vm* vm, struct vgits* vgits, struct gits_cmd* cmd)
+{
+    uint8_t cmd_id = bit64_extract(cmd->dw[0], GITS_CMD_ID_OFF, GITS_CMD_ID_LEN);
+    size_t icid = bit64_extract(cmd->dw[2], GITS_CMD_ICID_OFF, GITS_CMD_ICID_LEN);
+    struct vgits_dev* dev;
+    struct vgits_event* event = vgits_get_event(vgits, cmd, &dev);
+    struct vcpu* vcpu = vgits_coll_vcpu(vm, vgits, icid);
+
+    if (event == NULL || event->valid || vcpu == NULL) {
+        return;
+    }
+
+    irqid_t vintid = vgits_event_id(dev, event);
+    if (cmd_id == GITS_CMD_MAPTI) {
+        vintid = bit64_extract(cmd->dw[1], GITS_CMD_INTID_OFF, GITS_CMD_INTID_LEN);
+    }
+
+    if (vintid < GIC_FIRST_LPI || (vintid >> GICV4_LPI_ID_BITS) != 0) {
+        return;
+    }
+
+    vgits_sync_lpi_prop(vgits, vintid);
+    gicv4_its_vmapti(&vgits->batch, vcpu->phys_id, dev->id, vgits_event_id(dev, event),
+        vintid);
+    *event = (struct vgits_event){ .vintid = vintid, .icid = icid, .valid = true };
+}
+
+static void vgits_cmd_movi(struct vm* vm, struct vgits* vgits, struct gits_cmd* cmd)
+{
+    size_t icid = bit64_extract(cmd->dw[2], GITS_CMD_ICID_OFF, GITS_CMD_ICID_LEN);
+    struct vgits_dev* dev;
+    struct vgits_event* event = vgits_get_event(vgits, cmd, &dev);
+    struct vcpu* vcpu = vgits_coll_vcpu(vm, vgits, icid);
+
+    if (event == NULL || !event->valid || vcpu == NULL) {
+        return;
+    }
+
+    gicv4_its_vmovi(&vgits->batch, vcpu->phys_id, dev->id, vgits_event_id(dev, event));
+    event->icid = icid;
+}
+
+static void vgits_cmd_event(struct vm* vm, struct vgits* vgits, struct gits_cmd* cmd)
+{
+    uint8_t cmd_id = bit64_extract(cmd->dw[0], GITS_CMD_ID_OFF, GITS_CMD_ID_LEN);
+    struct vgits_dev* dev;
+    struct vgits_event* event = vgits_get_event(vgits, cmd, &dev);
+
+    if (event == NULL || !event->valid) {
+        return;
+    }
+
+    struct vcpu* vcpu = vgits_coll_vcpu(vm, vgits, event->icid);
+    vpeid_t vpeid = (vcpu != NULL) ? vcpu->phys_id : cpu()->vcpu->phys_id;
+
+    if (cmd_id == GITS_CMD_INV) {
+        vgits_sync_lpi_prop(vgits, event->vintid);
+    } else if (cmd_id == GITS_CMD_DISCARD) {
+        event->valid = false;
+    }
+
+    gicv4_its_event_cmd(&vgits->batch, vpeid, cmd_id, dev->id, vgits_event_id(dev, event));
+}
+
+static void vgits_handle_cmd(struct vm* vm, struct vgits* vgits, struct gits_cmd* cmd)
+{
+    switch (bit64_extract(cmd->dw[0], GITS_CMD_ID_OFF, GITS_CMD_ID_LEN)) {
+        case GITS_CMD_MAPD:
+            vgits_cmd_mapd(vgits, cmd);
+            break;
+        case GITS_CMD_MAPC:
+            vgits_cmd_mapc(vm, vgits, cmd);
+            break;
+        case GITS_CMD_MAPTI:
+        case GITS_CMD_MAPI:
+            vgits_cmd_mapti(vm, vgits, cmd);
+            break;
+        case GITS_CMD_MOVI:
+            vgits_cmd_movi(vm, vgits, cmd);
+            break;
+        case GITS_CMD_DISCARD:
+        case GITS_CMD_INV:
+        case GITS_CMD_INT:
+        case GITS_CMD_CLEAR:
+            vgits_cmd_event(vm, vgits, cmd);
+            break;
+        case GITS_CMD_INVALL:
+            vgits_inv_coll(vm, vgits,
+                bit64_extract(cmd->dw[2], GITS_CMD_ICID_OFF, GITS_CMD_ICID_LEN));
+            break;
+        /**
+         * Physical commands are complete by the time the guest sees CREADR move past them, and
+         * collections are moved along with their events by MAPC, so there is nothing left to do
+         * for SYNC and MOVALL. Malformed or unsupported commands are ignored.
+         */
+        default:
+            break;
+    }
+}
+
+static void vgits_process_cmds(struct vm* vm, struct vgits* vgits)
+{
+    if (!vgits->enabled || vgits->cmdq == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < VGITS_CMD_BURST_MAX && vgits->creadr != vgits->cwriter; i++) {
+        struct gits_cmd cmd = vgits->cmdq[vgits->creadr];
+        vgits_handle_cmd(vm, vgits, &cmd);
+        vgits->creadr = (vgits->creadr + 1) % vgits->cmdq_num;
+    }
+
+    /* The physical commands of the whole burst are waited for at once, before CREADR is exposed */
+    gicv4_its_batch_submit(&vgits->batch);
+}
+
+static void vgits_set_cbaser(struct vm* vm, struct vgits* vgits, uint64_t cbaser)
+{
+    if (vgits->cmdq != NULL) {
+        mem_unmap(&cpu()->as, (vaddr_t)vgits->cmdq,
+            NUM_PAGES(vgits->cmdq_num * sizeof(struct gits_cmd)), false);
+        vgits->cmdq = NULL;
+    }
+
+    /**
+     * The queue is always read through a cacheable mapping, so a cacheable, inner shareable queue
+     * is reported back.
+     */
+    vgits->CBASER = (cbaser & VGITS_CBASER_WR_MSK) | (GIC_BASER_RAWAWB << GITS_CBASER_ICACHE_OFF) |
+        (GIC_BASER_INNER_SH << GITS_CBASER_SH_OFF);
+    vgits->creadr = 0;
+    vgits->cwriter = 0;
+
+    size_t num_pages = bit64_extract(cbaser, GITS_CBASER_SIZE_OFF, GITS_CBASER_SIZE_LEN) + 1;
+    paddr_t base = cbaser & GITS_CBASER_PA_MSK;
+    if ((cbaser & GITS_CBASER_VALID_BIT) &&
+        vgits_guest_range_valid(vm, base, num_pages * PAGE_SIZE)) {
+        vgits->cmdq = (struct gits_cmd*)mem_map_cpy(&vm->as, &cpu()->as, base, INVALID_VA,
+            num_pages);
+        vgits->cmdq_num = (num_pages * PAGE_SIZE) / sizeof(struct gits_cmd);
+    }
+}
+
+bool vgits_emul_handler(struct emul_access* acc)
+{
+    struct vm* vm = cpu()->vcpu->vm;
+    struct vgits* vgits = &vm->arch.vgits;
+    size_t offset = acc->addr - vgits->emul.va_base;
+    unsigned long val = 0;
+
+    if ((acc->width != 4 && acc->width != 8) || !IS_ALIGNED(acc->addr, acc->width)) {
+        return false;
+    }
+
+    spin_lock(&vgits->lock);
+
+    if (offset == offsetof(struct gits_hw, CTLR)) {
+        if (acc->write) {
+            vgits->enabled = !!(vcpu_readreg(cpu()->vcpu, acc->reg) & GITS_CTLR_EN_BIT);
+            vgits_process_cmds(vm, vgits);
+        }
+        val = (vgits->enabled ? GITS_CTLR_EN_BIT : 0) |
+            ((vgits->creadr == vgits->cwriter) ? GITS_CTLR_QUIESCENT_BIT : 0);
+    } else if (offset == offsetof(struct gits_hw, IIDR)) {
+        val = gicv4_its_iidr();
+    } else if (VGITS_IS_REG(TYPER, offset)) {
+        val = vgic_reg64_read(acc, vgits->TYPER);
+    } else if (VGITS_IS_REG(CBASER, offset)) {
+        if (acc->write && !vgits->enabled) {
+            vgits_set_cbaser(vm, vgits, vgic_reg64_write(acc, vgits->CBASER));
+        }
+        val = vgic_reg64_read(acc, vgits->CBASER);
+    } else if (VGITS_IS_REG(CWRITER, offset)) {
+        if (acc->write) {
+            uint64_t cwriter = vgic_reg64_write(acc, (uint64_t)vgits->cwriter << GITS_CMDQ_OFF);
+            size_t index = bit64_extract(cwriter, GITS_CMDQ_OFF, GITS_CMDQ_LEN);
+            if (index < vgits->cmdq_num) {
+                vgits->cwriter = index;
+                vgits_process_cmds(vm, vgits);
+            }
+        }
+        val = vgic_reg64_read(acc, (uint64_t)vgits->cwriter << GITS_CMDQ_OFF);
+    } else if (VGITS_IS_REG(CREADR, offset)) {
+        /* Guests poll CREADR for completion, which drives the commands left by a previous burst */
+        vgits_process_cmds(vm, vgits);
+        val = vgic_reg64_read(acc, (uint64_t)vgits->creadr << GITS_CMDQ_OFF);
+    } else if (VGITS_IS_REG(ID, offset) && acc->width == 4) {
+        size_t index = (offset - offsetof(struct gits_hw, ID)) / sizeof(uint32_t);
+        val = gicv4_its_id(index);
+        if (index == GICD_PIDR2_IND) {
+            /* It is a GICv3 ITS, as vPE commands are not emulated */
+            val = bit32_insert(val, 3, GIC_PIDR2_ARCHREV_OFF, GIC_PIDR2_ARCHREV_LEN);
+        }
+    }
+
+    spin_unlock(&vgits->lock);
+
+    if (!acc->write) {
+        vcpu_writereg(cpu()->vcpu, acc->reg, val);
+    }
+
+    return true;
+}
+
+void vgits_enable_lpis(struct vm* vm, uint64_t propbaser)
+{
+    struct vgits* vgits = &vm->arch.vgits;
+    size_t id_bits = bit64_extract(propbaser, GICR_PROPBASER_IDBITS_OFF,
+                         GICR_PROPBASER_IDBITS_LEN) +
+        1;
+    id_bits = min(id_bits, GICV4_LPI_ID_BITS);
+
+    spin_lock(&vgits->lock);
+
+    /* All redistributors share the guest's LPI configuration table (GICR_TYPER.CommonLPIAff) */
+    if (vgits->lpi_prop == NULL && (1UL << id_bits) > GIC_FIRST_LPI) {
+        size_t size = (1UL << id_bits) - GIC_FIRST_LPI;
+        paddr_t base = propbaser & GICR_PROPBASER_PA_MSK;
+        if (vgits_guest_range_valid(vm, base, size)) {
+            vgits->lpi_prop =
+                (uint8_t*)mem_map_cpy(&vm->as, &cpu()->as, base, INVALID_VA, NUM_PAGES(size));
+            vgits->lpi_prop_size = size;
+            for (size_t icid = 0; icid < vm->cpu_num; icid++) {
+                vgits_inv_coll(vm, vgits, icid);
+            }
+            gicv4_its_batch_submit(&vgits->batch);
+        }
+    }
+
+    spin_unlock(&vgits->lock);
+}
+
+void vgits_init(struct vm* vm, const struct vgic_dscrp* vgic_dscrp)
+{
+    struct vgits* vgits = &vm->arch.vgits;
+
+    vgits->emul.handler = NULL;
+    vgits->vconf_pa = 0;
+    if (vgic_dscrp->gits_addr == 0 || !gicv4_vsgi_support) {
+        return;
+    }
+
+    vgits->lock = SPINLOCK_INITVAL;
+    vgits->enabled = false;
+    vgits->CBASER = 0;
+    vgits->cmdq = NULL;
+    vgits->cwriter = 0;
+    vgits->creadr = 0;
+    vgits->lpi_prop = NULL;
+    vgits->batch.num = 0;
+    vgits->batch.vpes = 0;
+    for (size_t i = 0; i < VGITS_COLL_NUM; i++) {
+        vgits->colls[i] = INVALID_CPUID;
+    }
+
+    vgits->dev_num = 0;
+    for (size_t i = 0; i < vm->config->platform.dev_num; i++) {
+        if (vm->config->platform.devs[i].id != 0) {
+            vgits->dev_num++;
+        }
+    }
+
+    size_t devs_size = vgits->dev_num * sizeof(struct vgits_dev);
+    vgits->devs = NULL;
+    if (devs_size > 0) {
+        vgits->devs = mem_alloc_page(NUM_PAGES(devs_size), SEC_HYP_VM, false);
+        if (vgits->devs == NULL) {
+            ERROR("failed to alloc vgits");
+        }
+    }
+    for (size_t i = 0, j = 0; i < vm->config->platform.dev_num; i++) {
+        if (vm->config->platform.devs[i].id != 0) {
+            vgits->devs[j++] = (struct vgits_dev){ .id = vm->config->platform.devs[i].id };
+        }
+    }
+
+    vgits->vconf = gicv4_vconf_alloc(&vgits->vconf_pa);
+
+    size_t event_bits = min(gicv4_its_event_bits(), VGITS_EVENT_BITS_MAX);
+    vgits->TYPER = GITS_TYPER_PHYSICAL_BIT |
+        bit64_insert(0, VGITS_ITTESZ - 1, GITS_TYPER_ITTESZ_OFF, GITS_TYPER_ITTESZ_LEN) |
+        bit64_insert(0, event_bits - 1, GITS_TYPER_IDBITS_OFF, GITS_TYPER_IDBITS_LEN) |
+        bit64_insert(0, sizeof(deviceid_t) * 8 - 1, GITS_TYPER_DEVBITS_OFF,
+            GITS_TYPER_DEVBITS_LEN) |
+        bit64_insert(0, vm->cpu_num, GITS_TYPER_HCC_OFF, GITS_TYPER_HCC_LEN);
+
+    vgits->emul = (struct emul_mem){ .va_base = vgic_dscrp->gits_addr,
+        .size = ALIGN(offsetof(struct gits_hw, translater_base), PAGE_SIZE),
+        .handler = vgits_emul_handler };
+    vm_emul_add_mem(vm, &vgits->emul);
+
+    /**
+     * Devices write their MSIs straight to the physical translation register, through the VM's
+     * stage 2 translation. Only the page holding it is mapped, not the vSGI frame.
+     */
+    mem_alloc_map_dev(&vm->as, SEC_VM_ANY, vgic_dscrp->gits_addr + VGITS_TRANSLATER_FRAME_OFF,
+        platform.arch.gic.gits_addr + offsetof(struct gits_hw, translater_base), 1);
+}
@@ -15,6 +15,9 @@ void vm_arch_init(struct vm* vm, const struct vm_config* config)
         vgic_init(vm, &config->platform.arch.gic);
     }
     cpu_sync_and_clear_msgs(&vm->sync);
+
+    /* A vcpu's vPE is mapped with its VM's vLPI configuration table, set up by vgic_init */
+    vgic_cpu_vpe_init(cpu()->vcpu);
 }
 
 struct vcpu* vm_get_vcpu_by_mpidr(struct vm* vm, unsigned long mpidr)
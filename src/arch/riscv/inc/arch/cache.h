@@ -8,6 +8,7 @@
 
 #include <bao.h>
 
-#define CACHE_MAX_LVL 8 // Does this make sense in all architectures?
+#define CACHE_LINE_SIZE 64
+#define CACHE_MAX_LVL   8 // Does this make sense in all architectures?
 
 #endif                  /* __ARCH_CACHE_H__ */
@@ -17,6 +17,11 @@
 #define CSR_VSTVAL        0x243
 #define CSR_VSIP          0x244
 #define CSR_VSATP         0x280
+/* Smaia/Ssaia Extension */
+#define CSR_VSISELECT     0x250
+#define CSR_VSIREG        0x251
+#define CSR_VSTOPEI       0x25C
+#define CSR_VSTOPI        0xEB0
 /* Sstc Extension */
 #define CSR_VSTIMECMP     0x24D
 #define CSR_VSTIMECMPH    0x25D
@@ -43,6 +48,12 @@
 #define CSR_STIMECMP      0x14D
 #define CSR_STIMECMPH     0x15D
 
+/* Smaia/Ssaia Extension */
+#define CSR_SISELECT      0x150
+#define CSR_SIREG         0x151
+#define CSR_STOPEI        0x15C
+#define CSR_STOPI         0xDB0
+
 #define STVEC_MODE_OFF    (0)
 #define STVEC_MODE_LEN    (2)
 #define STVEC_MODE_MSK    BIT_MASK(STVEC_MODE_OFF, STVEC_MODE_LEN)
@@ -228,6 +239,13 @@
 #define CSRS(csr, rs) asm volatile("csrs  " XSTR(csr) ", %0\n\r" ::"rK"(rs) : "memory")
 #define CSRC(csr, rs) asm volatile("csrc  " XSTR(csr) ", %0\n\r" ::"rK"(rs) : "memory")
 
+#define CSRRW(csr, rs)                                                                        \
+    ({                                                                                        \
+        unsigned long _temp;                                                                  \
+        asm volatile("csrrw  %0, " XSTR(csr) ", %1\n\r" : "=r"(_temp) : "rK"(rs) : "memory"); \
+        _temp;                                                                                \
+    })
+
 #endif /* __ASSEMBLER__ */
 
 #endif /* __ARCH_CSRS_H__ */
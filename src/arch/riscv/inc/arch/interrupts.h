@@ -7,10 +7,12 @@
 #define __ARCH_INTERRUPTS_H__
 
 #include <bao.h>
-#include <irqc.h>
 
 #define PLIC             (1)
 #define APLIC            (2)
+#define AIA              (3)
+
+#include <irqc.h>
 
 #define ACLINT_PRESENT() DEFINED(ACLINT_SSWI)
 
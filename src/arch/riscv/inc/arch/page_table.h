@@ -89,6 +89,11 @@ static inline paddr_t pte_addr(pte_t* pte)
     return (*pte << 2) & PTE_ADDR_MSK;
 }
 
+static inline pte_flags_t pte_flags(pte_t* pte)
+{
+    return *pte & PTE_FLAGS_MSK & ~PTE_VALID;
+}
+
 static inline bool pte_valid(pte_t* pte)
 {
     return (*pte & PTE_VALID);
@@ -18,6 +18,11 @@ struct arch_platform {
             struct {
                 paddr_t base;
             } aplic;
+            struct {
+                paddr_t base;       // Base of the supervisor-level interrupt files
+                size_t hart_stride; // Distance between the interrupt files of consecutive harts
+                size_t num_ids;     // Highest implemented interrupt identity (riscv,num-ids)
+            } imsic;
         } aia;
     } irqc;
 
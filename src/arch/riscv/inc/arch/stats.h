@@ -0,0 +1,20 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef ARCH_STATS_H
+#define ARCH_STATS_H
+
+#include <bao.h>
+#include <arch/csrs.h>
+
+/* Synchronous exits are classified by scause, which is at most SCAUSE_CODE_SGPF for guest traps */
+#define STATS_ARCH_EXIT_NUM (24)
+
+static inline uint64_t stats_arch_timestamp(void)
+{
+    return CSRR(time);
+}
+
+#endif /* ARCH_STATS_H */
@@ -24,6 +24,11 @@ static inline void tlb_hyp_inv_all()
     sbi_remote_sfence_vma((1 << platform.cpu_num) - 1, 0, 0, 0);
 }
 
+static inline void tlb_hyp_inv_range(vaddr_t va, size_t size)
+{
+    sbi_remote_sfence_vma((1 << platform.cpu_num) - 1, 0, (unsigned long)va, size);
+}
+
 /**
  * TODO: change hart_mask to only take into account the vm physical cpus.
  */
@@ -38,4 +43,13 @@ static inline void tlb_vm_inv_all(asid_t vmid)
     sbi_remote_hfence_gvma_vmid((1 << platform.cpu_num) - 1, 0, 0, 0, vmid);
 }
 
+/**
+ * A whole range is handed to the SBI in a single call, which fences each page or, when the range
+ * is too large to be worth it, the whole VMID.
+ */
+static inline void tlb_vm_inv_range(asid_t vmid, vaddr_t va, size_t size)
+{
+    sbi_remote_hfence_gvma_vmid((1 << platform.cpu_num) - 1, 0, (unsigned long)va, size, vmid);
+}
+
 #endif /* __ARCH_TLB_H__ */
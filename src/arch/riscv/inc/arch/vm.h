@@ -52,6 +52,9 @@ struct arch_vm_platform {
             struct {
                 paddr_t base;
             } aplic;
+            struct {
+                paddr_t base; // Base of the vcpus' interrupt files, one page per vcpu
+            } imsic;
         } aia;
     } irqc;
 };
@@ -45,6 +45,20 @@ void interrupts_arch_ipi_send(cpuid_t target_cpu, irqid_t ipi_id)
     }
 }
 
+void interrupts_arch_ipi_send_mask(cpumap_t cpu_targets, irqid_t ipi_id)
+{
+    if (ACLINT_PRESENT()) {
+        /* The ACLINT SSWI has a separate set register per hart */
+        for (cpuid_t i = 0; i < platform.cpu_num; i++) {
+            if (bit_get(cpu_targets, i)) {
+                aclint_send_ipi(i);
+            }
+        }
+    } else {
+        sbi_send_ipi(cpu_targets, 0);
+    }
+}
+
 void interrupts_arch_cpu_enable(bool en)
 {
     if (en) {
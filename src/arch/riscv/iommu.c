@@ -8,16 +8,27 @@
 #include <interrupts.h>
 #include <string.h>
 #include <arch/spinlock.h>
-#include <bitmap.h>
+#include <fences.h>
 
-// We initially use a 1-LVL DDT with DC in extended format
-// N entries = 4kiB / 64 B p/ entry = 64 Entries
+// DCs are in extended format. Leaf DDT pages hold 4kiB / 64 B p/ DC = 64 DCs and non-leaf DDT
+// pages hold 4kiB / 8 B p/ entry = 512 entries
 #define DDT_N_ENTRIES              (64)
+#define DDT_NL_N_ENTRIES           (512)
+
+// The device_id is split in one DDI per level: DDI[0] = device_id[5:0], DDI[1] = device_id[14:6]
+// and DDI[2] = device_id[23:15]
+#define DDT_DDI0_LEN               (6)
+#define DDT_DDIX_LEN               (9)
+#define DDT_MAX_LVLS               (3)
 
 #define FQ_N_ENTRIES               (64)
 #define FQ_LOG2SZ_1                (5ULL)
 #define FQ_INDEX_MASK              BIT32_MASK(0, FQ_LOG2SZ_1 + 1)
 
+#define CQ_N_ENTRIES               (64)
+#define CQ_LOG2SZ_1                (5ULL)
+#define CQ_INDEX_MASK              BIT32_MASK(0, CQ_LOG2SZ_1 + 1)
+
 #define RV_IOMMU_SUPPORTED_VERSION (0x10)
 
 // # Memory-mapped Register Interface
@@ -58,6 +69,13 @@
 #define RV_IOMMU_XQCSR_ON_BIT      (1ULL << 16)
 #define RV_IOMMU_XQCSR_BUSY_BIT    (1ULL << 17)
 
+// CQ CSR
+#define RV_IOMMU_CQCSR_CMD_TO_BIT     (1ULL << 9)
+#define RV_IOMMU_CQCSR_CMD_ILL_BIT    (1ULL << 10)
+#define RV_IOMMU_CQCSR_DEFAULT        (RV_IOMMU_XQCSR_EN_BIT)
+#define RV_IOMMU_CQCSR_ERR \
+    (RV_IOMMU_XQCSR_MF_BIT | RV_IOMMU_CQCSR_CMD_TO_BIT | RV_IOMMU_CQCSR_CMD_ILL_BIT)
+
 // FQ CSR
 #define RV_IOMMU_FQCSR_OF_BIT      (1ULL << 9)
 #define RV_IOMMU_FQCSR_DEFAULT \
@@ -162,6 +180,12 @@ struct riscv_iommu_regmap {
 #define RV_IOMMU_DC_MSIMASK_LEN  (52)
 #define RV_IOMMU_DC_MSIMASK_MASK BIT64_MASK(RV_IOMMU_DC_MSIMASK_OFF, RV_IOMMU_DC_MSIMASK_LEN)
 
+// Non-leaf DDT entries
+#define RV_IOMMU_DDTE_VALID_BIT     (1ULL << 0)
+#define RV_IOMMU_DDTE_PPN_OFF       (10)
+#define RV_IOMMU_DDTE_PPN_LEN       (44)
+#define RV_IOMMU_DDTE_PPN_MASK      BIT64_MASK(RV_IOMMU_DDTE_PPN_OFF, RV_IOMMU_DDTE_PPN_LEN)
+
 struct ddt_entry {
     uint64_t tc;
     uint64_t iohgatp;
@@ -173,6 +197,15 @@ struct ddt_entry {
     uint64_t __rsv;
 } __attribute__((__packed__));
 
+/**
+ * A non-leaf DDT page is followed by a page holding the hypervisor virtual addresses of the next
+ * level tables it points to, so that walks do not need to translate the entries' PPNs back.
+ */
+struct ddt_nl_table {
+    uint64_t entries[DDT_NL_N_ENTRIES];
+    void* next[DDT_NL_N_ENTRIES];
+} __attribute__((__packed__, __aligned__(PAGE_SIZE)));
+
 // # Fault Queue Record
 #define RV_IOMMU_FQ_CAUSE_OFF (0)
 #define RV_IOMMU_FQ_CAUSE_LEN (12)
@@ -190,19 +223,78 @@ struct fq_entry {
     uint64_t iotval2;
 } __attribute__((__packed__));
 
+// # Command Queue Record
+#define RV_IOMMU_CMD_OPCODE_OFF           (0)
+#define RV_IOMMU_CMD_FUNC3_OFF            (7)
+#define RV_IOMMU_CMD_IOTINVAL             (1ULL << RV_IOMMU_CMD_OPCODE_OFF)
+#define RV_IOMMU_CMD_IOFENCE              (2ULL << RV_IOMMU_CMD_OPCODE_OFF)
+#define RV_IOMMU_CMD_IODIR                (3ULL << RV_IOMMU_CMD_OPCODE_OFF)
+
+#define RV_IOMMU_CMD_IOTINVAL_GVMA        (RV_IOMMU_CMD_IOTINVAL | (1ULL << RV_IOMMU_CMD_FUNC3_OFF))
+#define RV_IOMMU_CMD_IOTINVAL_AV_BIT      (1ULL << 10)
+#define RV_IOMMU_CMD_IOTINVAL_GV_BIT      (1ULL << 33)
+#define RV_IOMMU_CMD_IOTINVAL_GSCID_OFF   (44)
+#define RV_IOMMU_CMD_IOTINVAL_GSCID_LEN   (16)
+#define RV_IOMMU_CMD_IOTINVAL_GSCID_MASK \
+    BIT64_MASK(RV_IOMMU_CMD_IOTINVAL_GSCID_OFF, RV_IOMMU_CMD_IOTINVAL_GSCID_LEN)
+#define RV_IOMMU_CMD_IOTINVAL_ADDR_MASK   BIT64_MASK(10, 52)
+
+#define RV_IOMMU_CMD_IOFENCE_C            (RV_IOMMU_CMD_IOFENCE | (0ULL << RV_IOMMU_CMD_FUNC3_OFF))
+#define RV_IOMMU_CMD_IOFENCE_AV_BIT       (1ULL << 10)
+#define RV_IOMMU_CMD_IOFENCE_PR_BIT       (1ULL << 12)
+#define RV_IOMMU_CMD_IOFENCE_PW_BIT       (1ULL << 13)
+#define RV_IOMMU_CMD_IOFENCE_DATA_OFF     (32)
+#define RV_IOMMU_CMD_IOFENCE_ADDR_MASK    BIT64_MASK(0, 62)
+
+#define RV_IOMMU_CMD_IODIR_INVAL_DDT      (RV_IOMMU_CMD_IODIR | (0ULL << RV_IOMMU_CMD_FUNC3_OFF))
+#define RV_IOMMU_CMD_IODIR_DV_BIT         (1ULL << 33)
+#define RV_IOMMU_CMD_IODIR_DID_OFF        (40)
+#define RV_IOMMU_CMD_IODIR_DID_LEN        (24)
+#define RV_IOMMU_CMD_IODIR_DID_MASK \
+    BIT64_MASK(RV_IOMMU_CMD_IODIR_DID_OFF, RV_IOMMU_CMD_IODIR_DID_LEN)
+
+struct cq_entry {
+    uint64_t dw0;
+    uint64_t dw1;
+} __attribute__((__packed__));
+
+/**
+ * Commands are gathered in a batch and handed to the IOMMU with a single cqt write, followed by a
+ * single IOFENCE.C. A batch that fills up is submitted on its own. The batch must leave room in the
+ * CQ for the fence.
+ */
+#define RV_IOMMU_CMD_BATCH_MAX         (32)
+
+/**
+ * Ranges spanning more pages than this are invalidated with a single IOTINVAL.GVMA for the whole
+ * GSCID instead of one command per page.
+ */
+#define RV_IOMMU_INV_RANGE_MAX_PAGES   (RV_IOMMU_CMD_BATCH_MAX)
+
+struct rv_iommu_cmd_batch {
+    size_t num;
+    struct cq_entry cmds[RV_IOMMU_CMD_BATCH_MAX];
+};
+
 // # Memory-mapped and in-memory structures
-//  TODO: Add CQ
 struct riscv_iommu_hw {
     volatile struct riscv_iommu_regmap* reg_ptr;
-    volatile struct ddt_entry* ddt;
+    volatile void* ddt;
     volatile struct fq_entry* fq;
+    volatile struct cq_entry* cq;
+    volatile uint32_t* cq_fence;
 };
 
 struct riscv_iommu_priv {
     struct riscv_iommu_hw hw;
 
     spinlock_t ddt_lock;
-    BITMAP_ALLOC(ddt_bitmap, DDT_N_ENTRIES);
+    size_t ddt_lvls;
+
+    spinlock_t cq_lock;
+    uint32_t cqt;
+    uint32_t cq_seq;
+    paddr_t cq_fence_paddr;
 };
 
 struct riscv_iommu_priv rv_iommu;
@@ -287,6 +379,253 @@ void rv_iommu_fq_irq_handler(irqid_t irq_id)
     rv_iommu.hw.reg_ptr->fqh = fqh;
 }
 
+/**
+ * Report CQ errors. The CQ stops fetching commands once one of them is set, so any pending fence
+ * would never complete.
+ */
+static void rv_iommu_cq_check_error(uint32_t cqcsr)
+{
+    if (cqcsr & RV_IOMMU_XQCSR_MF_BIT) {
+        ERROR("RV IOMMU: CQ Memory Fault error!");
+    }
+
+    if (cqcsr & RV_IOMMU_CQCSR_CMD_ILL_BIT) {
+        ERROR("RV IOMMU: CQ Illegal command at index %d", rv_iommu.hw.reg_ptr->cqh);
+    }
+
+    if (cqcsr & RV_IOMMU_CQCSR_CMD_TO_BIT) {
+        ERROR("RV IOMMU: CQ Command timeout!");
+    }
+}
+
+/**
+ * Write num commands followed by an IOFENCE.C to the CQ, publish them with a single cqt update and
+ * wait for the fence to complete, i.e., for all of them to complete.
+ *
+ * The hypervisor runs with interrupts disabled, so completion is polled. The CQ is enabled without
+ * interrupts and the fence does not request a WSI. Instead, it writes a sequence number to memory
+ * and we wait on that word rather than on the cqh register. CQ errors are checked while polling.
+ */
+static void rv_iommu_cq_submit(struct cq_entry* cmds, size_t num)
+{
+    spin_lock(&rv_iommu.cq_lock);
+
+    // The CQ is always drained before the lock is released, so there is room for the whole batch
+    uint32_t cqt = rv_iommu.cqt;
+    uint32_t seq = ++rv_iommu.cq_seq;
+    struct cq_entry fence = {
+        .dw0 = RV_IOMMU_CMD_IOFENCE_C | RV_IOMMU_CMD_IOFENCE_AV_BIT | RV_IOMMU_CMD_IOFENCE_PR_BIT |
+            RV_IOMMU_CMD_IOFENCE_PW_BIT |
+            ((uint64_t)seq << RV_IOMMU_CMD_IOFENCE_DATA_OFF),
+        .dw1 = (rv_iommu.cq_fence_paddr >> 2) & RV_IOMMU_CMD_IOFENCE_ADDR_MASK,
+    };
+
+    for (size_t i = 0; i <= num; i++) {
+        struct cq_entry* cmd = (i < num) ? &cmds[i] : &fence;
+        rv_iommu.hw.cq[cqt].dw0 = cmd->dw0;
+        rv_iommu.hw.cq[cqt].dw1 = cmd->dw1;
+        cqt = (cqt + 1) & CQ_INDEX_MASK;
+    }
+
+    fence_sync_write();
+    rv_iommu.hw.reg_ptr->cqt = cqt;
+    rv_iommu.cqt = cqt;
+
+    while (*rv_iommu.hw.cq_fence != seq) {
+        rv_iommu_cq_check_error(rv_iommu.hw.reg_ptr->cqcsr);
+    }
+    fence_sync_read();
+
+    spin_unlock(&rv_iommu.cq_lock);
+}
+
+static void rv_iommu_batch_submit(struct rv_iommu_cmd_batch* batch)
+{
+    if (batch->num > 0) {
+        rv_iommu_cq_submit(batch->cmds, batch->num);
+        batch->num = 0;
+    }
+}
+
+static void rv_iommu_batch_add(struct rv_iommu_cmd_batch* batch, struct cq_entry cmd)
+{
+    if (batch->num >= RV_IOMMU_CMD_BATCH_MAX) {
+        rv_iommu_batch_submit(batch);
+    }
+    batch->cmds[batch->num++] = cmd;
+}
+
+static inline struct cq_entry rv_iommu_cmd_iotinval_gvma(asid_t gscid, bool addr_valid, vaddr_t va)
+{
+    struct cq_entry cmd = {
+        .dw0 = RV_IOMMU_CMD_IOTINVAL_GVMA | RV_IOMMU_CMD_IOTINVAL_GV_BIT |
+            (((uint64_t)gscid << RV_IOMMU_CMD_IOTINVAL_GSCID_OFF) &
+                RV_IOMMU_CMD_IOTINVAL_GSCID_MASK),
+        .dw1 = 0,
+    };
+
+    if (addr_valid) {
+        cmd.dw0 |= RV_IOMMU_CMD_IOTINVAL_AV_BIT;
+        cmd.dw1 = (va >> 2) & RV_IOMMU_CMD_IOTINVAL_ADDR_MASK;
+    }
+
+    return cmd;
+}
+
+static inline struct cq_entry rv_iommu_cmd_iodir_inval_ddt(deviceid_t dev_id)
+{
+    return (struct cq_entry){
+        .dw0 = RV_IOMMU_CMD_IODIR_INVAL_DDT | RV_IOMMU_CMD_IODIR_DV_BIT |
+            (((uint64_t)dev_id << RV_IOMMU_CMD_IODIR_DID_OFF) & RV_IOMMU_CMD_IODIR_DID_MASK),
+        .dw1 = 0,
+    };
+}
+
+/**
+ * Invalidate the IOTLB entries of a guest physical address range of the VM with the given GSCID.
+ * All per-page invalidations are submitted as a single batch.
+ *
+ * @gscid:  GSCID (VMID) of the VM
+ * @va:     Base guest physical address of the range
+ * @size:   Size of the range. Zero invalidates the whole GSCID
+ */
+static void rv_iommu_inv_gvma(asid_t gscid, vaddr_t va, size_t size)
+{
+    struct rv_iommu_cmd_batch batch = { .num = 0 };
+    size_t num_pages = NUM_PAGES(size);
+
+    if (num_pages == 0 || num_pages > RV_IOMMU_INV_RANGE_MAX_PAGES) {
+        rv_iommu_batch_add(&batch, rv_iommu_cmd_iotinval_gvma(gscid, false, 0));
+    } else {
+        for (size_t i = 0; i < num_pages; i++) {
+            rv_iommu_batch_add(&batch,
+                rv_iommu_cmd_iotinval_gvma(gscid, true, va + (i * PAGE_SIZE)));
+        }
+    }
+
+    rv_iommu_batch_submit(&batch);
+}
+
+/**
+ * Allocate, configure and enable the CQ.
+ */
+static void rv_iommu_cq_init(void)
+{
+    rv_iommu.cq_lock = SPINLOCK_INITVAL;
+    rv_iommu.cqt = 0;
+    rv_iommu.cq_seq = 0;
+
+    // Allocate memory for CQ (aligned to 4kiB). The fence completion word lives right after the
+    // queue, in the same page
+    size_t cq_size = sizeof(struct cq_entry) * CQ_N_ENTRIES;
+    vaddr_t cq_vaddr =
+        (vaddr_t)mem_alloc_page(NUM_PAGES(cq_size + sizeof(uint32_t)), SEC_HYP_GLOBAL, true);
+    memset((void*)cq_vaddr, 0, cq_size + sizeof(uint32_t));
+    rv_iommu.hw.cq = (struct cq_entry*)cq_vaddr;
+    rv_iommu.hw.cq_fence = (uint32_t*)(cq_vaddr + cq_size);
+
+    // Configure cqb with queue size and base address. Clear cqt
+    paddr_t cq_paddr;
+    mem_translate(&cpu()->as, cq_vaddr, &cq_paddr);
+    rv_iommu.cq_fence_paddr = cq_paddr + cq_size;
+    rv_iommu.hw.reg_ptr->cqb = CQ_LOG2SZ_1 | ((cq_paddr >> 2) & RV_IOMMU_XQB_PPN_MASK);
+    rv_iommu.hw.reg_ptr->cqt = 0;
+
+    // Enable CQ (cqcsr), without interrupts as completion is polled, and wait for it to be on
+    rv_iommu.hw.reg_ptr->cqcsr = RV_IOMMU_CQCSR_DEFAULT;
+    while (!(rv_iommu.hw.reg_ptr->cqcsr & RV_IOMMU_XQCSR_ON_BIT)) { }
+}
+
+/**
+ * Number of DDT levels for a given IOMMU mode. Zero if the mode does not use a DDT.
+ */
+static size_t rv_iommu_ddt_lvls(unsigned mode)
+{
+    switch (mode) {
+        case RV_IOMMU_DDTP_MODE_1LVL:
+            return 1;
+        case RV_IOMMU_DDTP_MODE_2LVL:
+            return 2;
+        case RV_IOMMU_DDTP_MODE_3LVL:
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Index of dev_id's entry in a DDT table of the given level. Level 0 tables are the leaf ones.
+ */
+static inline size_t rv_iommu_ddi(deviceid_t dev_id, size_t lvl)
+{
+    if (lvl == 0) {
+        return bit64_extract(dev_id, 0, DDT_DDI0_LEN);
+    }
+    return bit64_extract(dev_id, DDT_DDI0_LEN + ((lvl - 1) * DDT_DDIX_LEN), DDT_DDIX_LEN);
+}
+
+/**
+ * Allocate and clear a DDT table of the given level.
+ *
+ * @lvl:    Level of the table. Level 0 tables hold DCs, others hold non-leaf entries
+ * @paddr:  Returns the physical address of the table
+ *
+ * @returns the table's virtual address or NULL if there is no memory left
+ */
+static void* rv_iommu_ddt_alloc(size_t lvl, paddr_t* paddr)
+{
+    size_t size = (lvl == 0) ? sizeof(struct ddt_entry) * DDT_N_ENTRIES :
+                               sizeof(struct ddt_nl_table);
+    void* table = mem_alloc_page(NUM_PAGES(size), SEC_HYP_GLOBAL, false);
+
+    if (table != NULL) {
+        memset(table, 0, size);
+        mem_translate(&cpu()->as, (vaddr_t)table, paddr);
+    }
+
+    return table;
+}
+
+/**
+ * Walk the DDT down to the DC of dev_id, allocating any missing tables on the way. Must be called
+ * with ddt_lock held.
+ *
+ * @dev_id: device_id to index DDT
+ *
+ * @returns a pointer to the DC or NULL if dev_id is out of range or there is no memory left
+ */
+static volatile struct ddt_entry* rv_iommu_ddt_get_dc(deviceid_t dev_id)
+{
+    size_t lvls = rv_iommu.ddt_lvls;
+
+    if (lvls == 0 || (dev_id >> (DDT_DDI0_LEN + ((lvls - 1) * DDT_DDIX_LEN))) != 0) {
+        return NULL;
+    }
+
+    volatile void* table = rv_iommu.hw.ddt;
+    for (size_t lvl = lvls - 1; lvl > 0; lvl--) {
+        volatile struct ddt_nl_table* nl_table = table;
+        size_t ddi = rv_iommu_ddi(dev_id, lvl);
+
+        if (!(nl_table->entries[ddi] & RV_IOMMU_DDTE_VALID_BIT)) {
+            paddr_t next_paddr;
+            void* next = rv_iommu_ddt_alloc(lvl - 1, &next_paddr);
+            if (next == NULL) {
+                return NULL;
+            }
+            nl_table->next[ddi] = next;
+            // The new table must be cleared before the IOMMU can reach it
+            fence_sync_write();
+            nl_table->entries[ddi] =
+                ((next_paddr >> 2) & RV_IOMMU_DDTE_PPN_MASK) | RV_IOMMU_DDTE_VALID_BIT;
+        }
+
+        table = nl_table->next[ddi];
+    }
+
+    return &((volatile struct ddt_entry*)table)[rv_iommu_ddi(dev_id, 0)];
+}
+
 /**
  * Init and enable RISC-V IOMMU.
  */
@@ -312,8 +651,8 @@ void rv_iommu_init(void)
     // Clear all IP flags (ipsr)
     rv_iommu.hw.reg_ptr->ipsr = RV_IOMMU_IPSR_CLEAR;
 
-    // TODO Allocate memory for CQ Configure cqb with queue size and base address. Clear cqt
-    // Allocate IRQ for CQ Enable CQ (cqcsr)
+    // Allocate, configure and enable the CQ
+    rv_iommu_cq_init();
 
     // Allocate memory for FQ (aligned to 4kiB)
     vaddr_t fq_vaddr = (vaddr_t)mem_alloc_page(NUM_PAGES(sizeof(struct fq_entry) * FQ_N_ENTRIES),
@@ -338,78 +677,78 @@ void rv_iommu_init(void)
     rv_iommu.hw.reg_ptr->fqcsr = RV_IOMMU_FQCSR_DEFAULT;
     // TODO: poll fqcsr.busy
 
-    // Init DDT bitmap
+    // Init the DDT. Only the root table is allocated here, the remaining ones are allocated as
+    // device_ids are added
     rv_iommu.ddt_lock = SPINLOCK_INITVAL;
-    bitmap_clear_consecutive(rv_iommu.ddt_bitmap, 0, DDT_N_ENTRIES);
+    rv_iommu.ddt_lvls = rv_iommu_ddt_lvls(platform.arch.iommu.mode);
 
-    // Allocate a page of memory (aligned) for the DDT
-    vaddr_t ddt_vaddr = (vaddr_t)mem_alloc_page(NUM_PAGES(sizeof(struct ddt_entry) * DDT_N_ENTRIES),
-        SEC_HYP_GLOBAL, true);
-    // Clear entries
-    memset((void*)ddt_vaddr, 0, sizeof(struct ddt_entry) * DDT_N_ENTRIES);
-    rv_iommu.hw.ddt = (struct ddt_entry*)ddt_vaddr;
+    paddr_t ddt_paddr = 0;
+    if (rv_iommu.ddt_lvls > 0) {
+        rv_iommu.hw.ddt = rv_iommu_ddt_alloc(rv_iommu.ddt_lvls - 1, &ddt_paddr);
+        if (rv_iommu.hw.ddt == NULL) {
+            ERROR("RV IOMMU: failed to allocate the DDT");
+        }
+    }
 
     // Configure ddtp with DDT base address and IOMMU mode
-    paddr_t ddt_paddr;
-    mem_translate(&cpu()->as, ddt_vaddr, &ddt_paddr);
     rv_iommu.hw.reg_ptr->ddtp =
         (unsigned long long)platform.arch.iommu.mode | ((ddt_paddr >> 2) & RV_IOMMU_DDTP_PPN_MASK);
     // TODO: poll ddtp.busy
 }
 
 /**
- * Set DDT N bit in the DDT bitmap.
- *
- * @dev_id: device_id to be allocated
- *
- * @returns true on success, false on error
- */
-bool rv_iommu_alloc_did(deviceid_t dev_id)
-{
-    bool allocated;
-    spin_lock(&rv_iommu.ddt_lock);
-
-    // Check if DC already exists
-    if (!bitmap_get(rv_iommu.ddt_bitmap, dev_id)) {
-        bitmap_set(rv_iommu.ddt_bitmap, dev_id);
-        allocated = true;
-    } else {
-        allocated = false; // device_id already exists
-    }
-
-    spin_unlock(&rv_iommu.ddt_lock);
-    return allocated;
-}
-
-/**
- * Program DDT entry with base address of the root PT, VMID and translation configuration. Enable
- * DC.
+ * Program the DC of dev_id with base address of the root PT, VMID and translation configuration.
+ * Enable DC. Any DDT tables missing on the path to the DC are allocated.
  *
  * @dev_id:     device_id to index DDT
  * @vm:         VM to which the device is being assigned
  * @root_pt:    Base physical address of the root second-stage PT
+ *
+ * @returns true on success, false if the device_id is out of range, already assigned or the DDT
+ * could not be allocated
  */
-void rv_iommu_write_ddt(deviceid_t dev_id, struct vm* vm, paddr_t root_pt)
+bool rv_iommu_write_ddt(deviceid_t dev_id, struct vm* vm, paddr_t root_pt)
 {
+    bool res = true;
+
     spin_lock(&rv_iommu.ddt_lock);
-    if (!bitmap_get(rv_iommu.ddt_bitmap, dev_id)) {
-        ERROR("IOMMU DC %d is not allocated", dev_id);
+    volatile struct ddt_entry* dc = rv_iommu_ddt_get_dc(dev_id);
+    if (dc == NULL) {
+        INFO("RV IOMMU: Cannot allocate DC for device ID %d", dev_id);
+        res = false;
+    } else if (dc->tc & RV_IOMMU_DC_VALID_BIT) {
+        INFO("RV IOMMU: Cannot add one device ID (%d) twice", dev_id);
+        res = false;
     } else {
-        // Configure DC
-        uint64_t tc = 0;
-        tc |= RV_IOMMU_DC_VALID_BIT;
-        rv_iommu.hw.ddt[dev_id].tc = tc;
-
+        // Configure DC. The DC is only marked valid once the rest of it is written
         uint64_t iohgatp = 0;
         iohgatp |= ((root_pt >> 12) & RV_IOMMU_DC_IOHGATP_PPN_MASK);
         iohgatp |= ((vm->id << RV_IOMMU_DC_IOHGATP_GSCID_OFF) & RV_IOMMU_DC_IOHGATP_GSCID_MASK);
         iohgatp |= RV_IOMMU_IOHGATP_SV39X4;
-        rv_iommu.hw.ddt[dev_id].iohgatp = iohgatp;
+        dc->iohgatp = iohgatp;
 
         // TODO: Configure first-stage translation. Second-stage only by now Configure MSI
         // translation
+
+        fence_sync_write();
+
+        uint64_t tc = 0;
+        tc |= RV_IOMMU_DC_VALID_BIT;
+        dc->tc = tc;
     }
     spin_unlock(&rv_iommu.ddt_lock);
+
+    if (!res) {
+        return false;
+    }
+
+    // Make sure the IOMMU drops any cached copy of the DC and of the VM's translations
+    struct rv_iommu_cmd_batch batch = { .num = 0 };
+    rv_iommu_batch_add(&batch, rv_iommu_cmd_iodir_inval_ddt(dev_id));
+    rv_iommu_batch_add(&batch, rv_iommu_cmd_iotinval_gvma(vm->id, false, 0));
+    rv_iommu_batch_submit(&batch);
+
+    return true;
 }
 
 /**************** IOMMU IF functions ****************/
@@ -442,15 +781,12 @@ bool iommu_arch_init()
 static bool iommu_vm_arch_add(struct vm* vm, deviceid_t dev_id)
 {
     if (dev_id > 0) {
-        // Check if device was already added to a VM
-        if (rv_iommu_alloc_did(dev_id)) {
-            paddr_t rootpt;
-            // Translate root PT base address
-            mem_translate(&cpu()->as, (vaddr_t)vm->as.pt.root, &rootpt);
-            // Set DDT entry with root PT base address, VMID and configuration
-            rv_iommu_write_ddt(dev_id, vm, rootpt);
-        } else {
-            INFO("RV IOMMU: Cannot add one device ID (%d) twice", dev_id);
+        paddr_t rootpt;
+        // Translate root PT base address
+        mem_translate(&cpu()->as, (vaddr_t)vm->as.pt.root, &rootpt);
+        // Set DDT entry with root PT base address, VMID and configuration. Fails if the device was
+        // already added to a VM
+        if (!rv_iommu_write_ddt(dev_id, vm, rootpt)) {
             return false;
         }
     } else {
@@ -474,6 +810,32 @@ inline bool iommu_arch_vm_add_device(struct vm* vm, deviceid_t dev_id)
     return iommu_vm_arch_add(vm, dev_id);
 }
 
+/**
+ * Invalidate the IOTLB entries for a range of a VM's address space.
+ *
+ * @vm_id:  VM whose translations changed.
+ * @va:     Base guest physical address of the range.
+ * @size:   Size of the range.
+ */
+void iommu_arch_vm_inv_range(asid_t vm_id, vaddr_t va, size_t size)
+{
+    if (rv_iommu.hw.cq != NULL) {
+        rv_iommu_inv_gvma(vm_id, va, size);
+    }
+}
+
+/**
+ * Invalidate all the IOTLB entries of a VM.
+ *
+ * @vm_id:  VM whose translations changed.
+ */
+void iommu_arch_vm_inv_all(asid_t vm_id)
+{
+    if (rv_iommu.hw.cq != NULL) {
+        rv_iommu_inv_gvma(vm_id, 0, 0);
+    }
+}
+
 /**
  * Initialize VM-specific, arch-specific IOMMU data.
  *
@@ -34,14 +34,17 @@ void aplic_init(void)
     aplic_control = (void*)mem_alloc_map_dev(&cpu()->as, SEC_HYP_GLOBAL, INVALID_VA,
         platform.arch.irqc.aia.aplic.base, NUM_PAGES(sizeof(struct aplic_control_hw)));
 
-    aplic_idc = (void*)mem_alloc_map_dev(&cpu()->as, SEC_HYP_GLOBAL, INVALID_VA,
-        platform.arch.irqc.aia.aplic.base + HART_REG_OFF,
-        NUM_PAGES(sizeof(struct aplic_idc_hw) * IRQC_HART_INST));
+    /** There are no IDCs in MSI delivery mode */
+    if (!APLIC_MSI_MODE) {
+        aplic_idc = (void*)mem_alloc_map_dev(&cpu()->as, SEC_HYP_GLOBAL, INVALID_VA,
+            platform.arch.irqc.aia.aplic.base + HART_REG_OFF,
+            NUM_PAGES(sizeof(struct aplic_idc_hw) * IRQC_HART_INST));
+    }
 
     /** Ensure that instructions after fence have the APLIC fully mapped */
     fence_sync();
 
-    aplic_control->domaincfg = 0;
+    aplic_control->domaincfg = APLIC_MSI_MODE ? APLIC_DOMAINCFG_DM : 0;
 
     /** Clear all pending and enabled bits*/
     for (size_t i = 0; i < APLIC_NUM_CLRIx_REGS; i++) {
@@ -52,9 +55,14 @@ void aplic_init(void)
     /** Sets the default value of target and sourcecfg */
     for (size_t i = 0; i < APLIC_NUM_TARGET_REGS; i++) {
         aplic_control->sourcecfg[i] = APLIC_SOURCECFG_SM_INACTIVE;
-        aplic_control->target[i] = APLIC_TARGET_MIN_PRIO;
+        aplic_control->target[i] = APLIC_MSI_MODE ? 0 : APLIC_TARGET_MIN_PRIO;
+    }
+    if (APLIC_MSI_MODE) {
+        /** Priorities are a property of the IMSIC interrupt identities in MSI delivery mode */
+        APLIC_IPRIO_MASK = APLIC_TARGET_IPRIO_MASK;
+    } else {
+        APLIC_IPRIO_MASK = aplic_control->target[0] & APLIC_TARGET_IPRIO_MASK;
     }
-    APLIC_IPRIO_MASK = aplic_control->target[0] & APLIC_TARGET_IPRIO_MASK;
     aplic_control->domaincfg |= APLIC_DOMAINCFG_IE;
 }
 
@@ -155,6 +163,13 @@ void aplic_set_target_hart(irqid_t intp_id, cpuid_t hart)
     aplic_control->target[intp_id - 1] |= hart << APLIC_TARGET_HART_IDX_SHIFT;
 }
 
+void aplic_set_target_msi(irqid_t intp_id, cpuid_t hart, size_t guest, irqid_t eiid)
+{
+    aplic_control->target[intp_id - 1] = (hart << APLIC_TARGET_HART_IDX_SHIFT) |
+        ((guest & APLIC_TARGET_GUEST_INDEX_MASK) << APLIC_TARGET_GUEST_IDX_SHIFT) |
+        (eiid & APLIC_TARGET_EEID_MASK);
+}
+
 uint8_t aplic_get_target_prio(irqid_t intp_id)
 {
     return aplic_control->target[intp_id - 1] & APLIC_TARGET_IPRIO_MASK;
@@ -0,0 +1,113 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <imsic.h>
+#include <cpu.h>
+#include <mem.h>
+#include <interrupts.h>
+#include <fences.h>
+#include <arch/csrs.h>
+
+/** IMSIC indirectly accessed register numbers (through siselect/sireg) */
+#define IMSIC_EIDELIVERY          (0x70)
+#define IMSIC_EITHRESHOLD         (0x72)
+#define IMSIC_EIP                 (0x80)
+#define IMSIC_EIE                 (0xC0)
+
+#define IMSIC_EIDELIVERY_ENABLE   (1)
+#define IMSIC_EITHRESHOLD_EN_ALL  (0)
+
+/** On RV64 only the even numbered eip/eie registers exist, each holding 64 bits */
+#define IMSIC_REG_BITS            (sizeof(unsigned long) * 8)
+#define IMSIC_REG(base, intp_id)  ((base) + (((intp_id) / IMSIC_REG_BITS) * (IMSIC_REG_BITS / 32)))
+#define IMSIC_REG_MASK(intp_id)   (1UL << ((intp_id) % IMSIC_REG_BITS))
+
+#define IMSIC_TOPEI_INTP_ID_SHIFT (16)
+
+/** IMSIC private data */
+static volatile struct imsic_file_hw* imsic_files;
+static size_t imsic_files_per_hart;
+
+void imsic_init(void)
+{
+    size_t hart_stride = platform.arch.irqc.aia.imsic.hart_stride;
+
+    if (hart_stride < ((IMSIC_VGEIN + 1) * IMSIC_FILE_SIZE)) {
+        ERROR("IMSIC does not provide guest interrupt files");
+    }
+
+    if ((platform.arch.irqc.aia.imsic.num_ids == 0) ||
+        (platform.arch.irqc.aia.imsic.num_ids >= IMSIC_MAX_INTERRUPTS)) {
+        ERROR("invalid number of IMSIC interrupt identities");
+    }
+
+    /** Maps the interrupt files of all harts */
+    imsic_files = (void*)mem_alloc_map_dev(&cpu()->as, SEC_HYP_GLOBAL, INVALID_VA,
+        platform.arch.irqc.aia.imsic.base, NUM_PAGES(hart_stride * platform.cpu_num));
+    imsic_files_per_hart = hart_stride / IMSIC_FILE_SIZE;
+
+    /** Ensure that instructions after fence have the IMSIC fully mapped */
+    fence_sync();
+}
+
+void imsic_cpu_init(void)
+{
+    /** Probe GEILEN: only the implemented guest interrupt file bits in hgeie are writable */
+    CSRW(CSR_HGEIE, ~0UL);
+    unsigned long geie = CSRR(CSR_HGEIE);
+    CSRW(CSR_HGEIE, 0);
+    if (!(geie & (1UL << IMSIC_VGEIN))) {
+        ERROR("IMSIC does not provide guest interrupt files");
+    }
+
+    CSRW(CSR_SISELECT, IMSIC_EITHRESHOLD);
+    CSRW(CSR_SIREG, IMSIC_EITHRESHOLD_EN_ALL);
+    CSRW(CSR_SISELECT, IMSIC_EIDELIVERY);
+    CSRW(CSR_SIREG, IMSIC_EIDELIVERY_ENABLE);
+}
+
+void imsic_set_enbl(irqid_t intp_id, bool en)
+{
+    CSRW(CSR_SISELECT, IMSIC_REG(IMSIC_EIE, intp_id));
+    if (en) {
+        CSRS(CSR_SIREG, IMSIC_REG_MASK(intp_id));
+    } else {
+        CSRC(CSR_SIREG, IMSIC_REG_MASK(intp_id));
+    }
+}
+
+bool imsic_get_pend(irqid_t intp_id)
+{
+    CSRW(CSR_SISELECT, IMSIC_REG(IMSIC_EIP, intp_id));
+    return (CSRR(CSR_SIREG) & IMSIC_REG_MASK(intp_id)) != 0;
+}
+
+void imsic_clr_pend(irqid_t intp_id)
+{
+    CSRW(CSR_SISELECT, IMSIC_REG(IMSIC_EIP, intp_id));
+    CSRC(CSR_SIREG, IMSIC_REG_MASK(intp_id));
+}
+
+paddr_t imsic_guest_file_addr(cpuid_t hart)
+{
+    return platform.arch.irqc.aia.imsic.base +
+        (hart * platform.arch.irqc.aia.imsic.hart_stride) + (IMSIC_VGEIN * IMSIC_FILE_SIZE);
+}
+
+void imsic_send_guest_msi(cpuid_t hart, irqid_t eiid)
+{
+    imsic_files[(hart * imsic_files_per_hart) + IMSIC_VGEIN].seteipnum_le = eiid & IMSIC_EIID_MASK;
+}
+
+void imsic_handle(void)
+{
+    /** Writing stopei claims the interrupt it reported, so it must be an atomic swap */
+    unsigned long topei = CSRRW(CSR_STOPEI, 0);
+    irqid_t intp_id = (topei >> IMSIC_TOPEI_INTP_ID_SHIFT) & IMSIC_EIID_MASK;
+
+    if (intp_id != 0) {
+        interrupts_handle(intp_id);
+    }
+}
@@ -10,6 +10,11 @@
 #include <platform.h>
 
 #define APLIC_DOMAIN_NUM_HARTS   (PLAT_CPU_NUM)
+/**
+ * With IRQC=AIA the domain is configured in MSI delivery mode, forwarding interrupts to the harts'
+ * IMSIC interrupt files, instead of delivering them directly through the IDCs.
+ */
+#define APLIC_MSI_MODE           (IRQC == AIA)
 #define APLIC_MAX_NUM_HARTS_MAKS (0x3FFF)
 /** APLIC Specific types */
 typedef cpuid_t idcid_t;
@@ -239,6 +244,16 @@ void aplic_set_target_prio(irqid_t intp_id, uint8_t prio);
  */
 void aplic_set_target_hart(irqid_t intp_id, cpuid_t hart);
 
+/**
+ * @brief Write the MSI target of a given interrupt. Only valid in MSI delivery mode.
+ *
+ * @param intp_id interrupt ID
+ * @param hart hart index
+ * @param guest guest interrupt file index (0 for the supervisor-level file)
+ * @param eiid external interrupt identity to signal in the target interrupt file
+ */
+void aplic_set_target_msi(irqid_t intp_id, cpuid_t hart, size_t guest, irqid_t eiid);
+
 /**
  * @brief Return the priority of a given interrupt
  *
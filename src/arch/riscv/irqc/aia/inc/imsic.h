@@ -0,0 +1,104 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef IMSIC_H
+#define IMSIC_H
+
+#include <bao.h>
+#include <platform.h>
+
+#define IMSIC_MAX_INTERRUPTS (2048)
+#define IMSIC_EIID_MASK      (0x7FF)
+#define IMSIC_FILE_SIZE      (0x1000)
+
+/**
+ * Guest interrupt file used by the vcpu running on each hart. As there is at most a single vcpu
+ * per hart, only the first guest interrupt file is ever used.
+ */
+#define IMSIC_VGEIN          (1)
+
+/** Data structures for IMSIC devices */
+struct imsic_file_hw {
+    uint32_t seteipnum_le;
+    uint32_t seteipnum_be;
+    uint8_t reserved[IMSIC_FILE_SIZE - 0x8];
+} __attribute__((__packed__, aligned(IMSIC_FILE_SIZE)));
+
+/**
+ * @brief Check if a given interrupt identity is implemented by the IMSIC interrupt files.
+ *
+ * @param intp_id interrupt identity
+ * @return true if the identity is implemented
+ * @return false if the identity is 0 or above the highest implemented identity
+ */
+static inline bool imsic_id_valid(irqid_t intp_id)
+{
+    return (intp_id > 0) && (intp_id <= platform.arch.irqc.aia.imsic.num_ids);
+}
+
+/**
+ * @brief Map the IMSIC interrupt files of all harts.
+ *
+ */
+void imsic_init(void);
+
+/**
+ * @brief Initialize the calling hart's supervisor-level interrupt file.
+ *
+ */
+void imsic_cpu_init(void);
+
+/**
+ * @brief Enable or disable a given interrupt identity in the calling hart's supervisor-level
+ *        interrupt file.
+ *
+ * @param intp_id interrupt identity
+ * @param en true to enable, false to disable
+ */
+void imsic_set_enbl(irqid_t intp_id, bool en);
+
+/**
+ * @brief Read the pending bit of a given interrupt identity in the calling hart's
+ *        supervisor-level interrupt file.
+ *
+ * @param intp_id interrupt identity
+ * @return true if the interrupt is pending
+ * @return false if the interrupt is NOT pending
+ */
+bool imsic_get_pend(irqid_t intp_id);
+
+/**
+ * @brief Clear the pending bit of a given interrupt identity in the calling hart's
+ *        supervisor-level interrupt file.
+ *
+ * @param intp_id interrupt identity
+ */
+void imsic_clr_pend(irqid_t intp_id);
+
+/**
+ * @brief Return the physical address of the guest interrupt file of a given hart.
+ *
+ * @param hart physical hart id
+ * @return paddr_t physical address of the hart's IMSIC_VGEIN guest interrupt file
+ */
+paddr_t imsic_guest_file_addr(cpuid_t hart);
+
+/**
+ * @brief Send an MSI to the guest interrupt file of a given hart, i.e., set the interrupt
+ *        identity pending in the interrupt file of the vcpu running on that hart.
+ *
+ * @param hart physical hart id
+ * @param eiid external interrupt identity
+ */
+void imsic_send_guest_msi(cpuid_t hart, irqid_t eiid);
+
+/**
+ * @brief Claims and handles the highest priority interrupt pending in the calling hart's
+ *        supervisor-level interrupt file.
+ *
+ */
+void imsic_handle(void);
+
+#endif // IMSIC_H
@@ -1,4 +1,3 @@
-
 /**
  * SPDX-License-Identifier: Apache-2.0
  * Copyright (c) Bao Project and Contributors. All rights reserved.
@@ -7,7 +6,9 @@
 #ifndef IRQC_H
 #define IRQC_H
 
+#include <arch/interrupts.h>
 #include <aplic.h>
+#include <imsic.h>
 #include <cpu.h>
 #include <vaplic.h>
 
@@ -22,38 +23,70 @@
 static inline void irqc_init()
 {
     aplic_init();
+    if (APLIC_MSI_MODE) {
+        imsic_init();
+    }
 }
 
 static inline void irqc_cpu_init()
 {
-    aplic_idc_init();
+    if (APLIC_MSI_MODE) {
+        imsic_cpu_init();
+    } else {
+        aplic_idc_init();
+    }
 }
 
 static inline void irqc_config_irq(irqid_t int_id, bool en)
 {
     if (en) {
         aplic_set_sourcecfg(int_id, HYP_IRQ_SM_EDGE_RISE);
-        aplic_set_enbl(int_id);
-        aplic_set_target_hart(int_id, cpu()->id);
-        aplic_set_target_prio(int_id, HYP_IRQ_PRIO);
+        if (APLIC_MSI_MODE) {
+            /** Hypervisor interrupts are signaled in the supervisor-level file with their own id */
+            if (!imsic_id_valid(int_id)) {
+                ERROR("interrupt %u has no identity in the IMSIC", int_id);
+            }
+            imsic_set_enbl(int_id, true);
+            aplic_set_target_msi(int_id, cpu()->id, 0, int_id);
+            aplic_set_enbl(int_id);
+        } else {
+            aplic_set_enbl(int_id);
+            aplic_set_target_hart(int_id, cpu()->id);
+            aplic_set_target_prio(int_id, HYP_IRQ_PRIO);
+        }
     } else {
         aplic_clr_enbl(int_id);
+        if (APLIC_MSI_MODE) {
+            imsic_set_enbl(int_id, false);
+        }
     }
 }
 
 static inline void irqc_handle()
 {
-    aplic_handle();
+    if (APLIC_MSI_MODE) {
+        imsic_handle();
+    } else {
+        aplic_handle();
+    }
 }
 
 static inline bool irqc_get_pend(irqid_t int_id)
 {
-    return aplic_get_pend(int_id);
+    if (APLIC_MSI_MODE) {
+        return imsic_get_pend(int_id);
+    } else {
+        return aplic_get_pend(int_id);
+    }
 }
 
 static inline void irqc_clr_pend(irqid_t int_id)
 {
-    aplic_clr_pend(int_id);
+    if (APLIC_MSI_MODE) {
+        imsic_clr_pend(int_id);
+    } else {
+        aplic_clr_pend(int_id);
+    }
 }
 
 static inline void virqc_set_hw(struct vm* vm, irqid_t id)
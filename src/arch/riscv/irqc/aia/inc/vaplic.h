@@ -22,6 +22,7 @@ struct vaplic {
     uint32_t ip[APLIC_MAX_INTERRUPTS / 32];
     uint32_t ie[APLIC_MAX_INTERRUPTS / 32];
     uint32_t target[APLIC_MAX_INTERRUPTS];
+    BITMAP_ALLOC_ARRAY(pend_enbl, APLIC_MAX_INTERRUPTS, APLIC_DOMAIN_NUM_HARTS);
     BITMAP_ALLOC(idelivery, APLIC_DOMAIN_NUM_HARTS);
     BITMAP_ALLOC(iforce, APLIC_DOMAIN_NUM_HARTS);
     uint32_t ithreshold[APLIC_DOMAIN_NUM_HARTS];
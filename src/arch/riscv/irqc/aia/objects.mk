@@ -2,4 +2,5 @@
 ## Copyright (c) Bao Project and Contributors. All rights reserved.
 
 cpu-objs-y+=irqc/$(IRQC_DIR)/aplic.o
-cpu-objs-y+=irqc/$(IRQC_DIR)/vaplic.o
\ No newline at end of file
+cpu-objs-y+=irqc/$(IRQC_DIR)/vaplic.o
+cpu-objs-y+=irqc/$(IRQC_DIR)/imsic.o
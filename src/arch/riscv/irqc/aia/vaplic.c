@@ -10,6 +10,7 @@
 #include <mem.h>
 #include <interrupts.h>
 #include <arch/csrs.h>
+#include <imsic.h>
 
 #define APLIC_MIN_PRIO             (0xFF)
 #define UPDATE_ALL_HARTS           (-1)
@@ -141,6 +142,68 @@ static bool vaplic_get_active(struct vcpu* vcpu, irqid_t intp_id)
     return ret;
 }
 
+/**
+ * @brief Updates the pending & enabled bitmap of the hart targeted by a given interrupt. The
+ *        bitmaps must be kept in sync with any change to the ip, ie or target registers, as they
+ *        are what vaplic_update_topi looks at.
+ *
+ * @pre This function should only be called by a function that has taken the lock.
+ *
+ * @param vcpu virtual cpu
+ * @param intp_id interrupt id
+ */
+static void vaplic_update_pend_enbl(struct vcpu* vcpu, irqid_t intp_id)
+{
+    struct vaplic* vaplic = &vcpu->vm->arch.vaplic;
+    vcpuid_t hart_index = vaplic_get_hart_index(vcpu, intp_id);
+
+    if (vaplic_intp_valid(intp_id) && hart_index < APLIC_DOMAIN_NUM_HARTS) {
+        if (vaplic_get_pend(vcpu, intp_id) && vaplic_get_enbl(vcpu, intp_id)) {
+            bitmap_set(vaplic->pend_enbl[hart_index], intp_id);
+        } else {
+            bitmap_clear(vaplic->pend_enbl[hart_index], intp_id);
+        }
+    }
+}
+
+/**
+ * @brief Removes a given interrupt from the pending & enabled bitmap of its current target hart.
+ *        Must be called before the interrupt target is changed.
+ *
+ * @pre This function should only be called by a function that has taken the lock.
+ *
+ * @param vcpu virtual cpu
+ * @param intp_id interrupt id
+ */
+static void vaplic_clear_pend_enbl(struct vcpu* vcpu, irqid_t intp_id)
+{
+    struct vaplic* vaplic = &vcpu->vm->arch.vaplic;
+    vcpuid_t hart_index = vaplic_get_hart_index(vcpu, intp_id);
+
+    if (vaplic_intp_valid(intp_id) && hart_index < APLIC_DOMAIN_NUM_HARTS) {
+        bitmap_clear(vaplic->pend_enbl[hart_index], intp_id);
+    }
+}
+
+/**
+ * @brief Updates the pending & enabled bitmaps for interrupts [32*reg:(32*reg)+31]
+ *
+ * @pre This function should only be called by a function that has taken the lock.
+ *
+ * @param vcpu virtual cpu
+ * @param reg register index
+ * @param intps interrupts to update bit-mapped
+ */
+static void vaplic_update_pend_enbl_reg(struct vcpu* vcpu, size_t reg, uint32_t intps)
+{
+    ssize_t bit = bit32_ffs(intps);
+    while (bit >= 0) {
+        vaplic_update_pend_enbl(vcpu, (irqid_t)((reg * APLIC_NUM_INTP_PER_REG) + (size_t)bit));
+        intps = bit32_clear(intps, (size_t)bit);
+        bit = bit32_ffs(intps);
+    }
+}
+
 /**
  * @brief Set a given interrupt as pending
  *
@@ -159,6 +222,7 @@ static bool vaplic_set_pend(struct vcpu* vcpu, irqid_t intp_id)
     if (vaplic_intp_valid(intp_id) && !vaplic_get_pend(vcpu, intp_id) &&
         vaplic_get_active(vcpu, intp_id)) {
         SET_INTP_REG(vaplic->ip, intp_id);
+        vaplic_update_pend_enbl(vcpu, intp_id);
         ret = true;
     }
     return ret;
@@ -184,16 +248,12 @@ static bool vaplic_update_topi(struct vcpu* vcpu)
     bool idc_force = false;
     uint32_t update_topi = 0;
 
-    /** Find highest pending and enabled interrupt */
-    for (size_t i = 1; i < APLIC_MAX_INTERRUPTS; i++) {
-        if (vaplic_get_hart_index(vcpu, i) == vcpu->id) {
-            if (vaplic_get_pend(vcpu, i) && vaplic_get_enbl(vcpu, i)) {
-                prio = vaplic_get_target(vcpu, i) & APLIC_TARGET_IPRIO_MASK;
-                if (prio < intp_prio) {
-                    intp_prio = prio;
-                    intp_id = i;
-                }
-            }
+    /** Find highest pending and enabled interrupt targeting this hart */
+    bitmap_foreach_set(vaplic->pend_enbl[vcpu->id], APLIC_MAX_INTERRUPTS, i) {
+        prio = vaplic_get_target(vcpu, (irqid_t)i) & APLIC_TARGET_IPRIO_MASK;
+        if (prio < intp_prio) {
+            intp_prio = prio;
+            intp_id = (irqid_t)i;
         }
     }
 
@@ -214,6 +274,33 @@ static bool vaplic_update_topi(struct vcpu* vcpu)
     return ret;
 }
 
+/**
+ * @brief Forwards the pending and enabled interrupts targeting a given hart as MSIs to the guest
+ *        interrupt file of its vcpu. As in an APLIC in MSI delivery mode, the pending bit is
+ *        cleared once the interrupt is forwarded.
+ *
+ * @pre This function should only be called by a function that has taken the lock.
+ *
+ * @param vcpu virtual cpu
+ * @param vhart_index hart id to forward interrupts to
+ */
+static void vaplic_forward_msis(struct vcpu* vcpu, vcpuid_t vhart_index)
+{
+    struct vaplic* vaplic = &vcpu->vm->arch.vaplic;
+    cpuid_t pcpu_id = vaplic_vcpuid_to_pcpuid(vcpu, vhart_index);
+
+    if (!(vaplic_get_domaincfg(vcpu) & APLIC_DOMAINCFG_IE) || pcpu_id == INVALID_CPUID) {
+        return;
+    }
+
+    bitmap_foreach_set(vaplic->pend_enbl[vhart_index], APLIC_MAX_INTERRUPTS, i) {
+        irqid_t eiid = vaplic_get_target(vcpu, (irqid_t)i) & APLIC_TARGET_EEID_MASK;
+        CLR_INTP_REG(vaplic->ip, i);
+        bitmap_clear(vaplic->pend_enbl[vhart_index], (size_t)i);
+        imsic_send_guest_msi(pcpu_id, eiid);
+    }
+}
+
 enum { UPDATE_HART_LINE };
 static void vaplic_ipi_handler(uint32_t event, uint64_t data);
 CPU_MSG_HANDLER(vaplic_ipi_handler, VPLIC_IPI_ID);
@@ -229,10 +316,13 @@ static void vaplic_update_hart_line(struct vcpu* vcpu, vcpuid_t vhart_index)
     cpuid_t pcpu_id = vaplic_vcpuid_to_pcpuid(vcpu, vhart_index);
 
     /**
-     *  If the current cpu is the targeting cpu, signal the intp to the hart. Else, send a mensage
-     *  to the targeting cpu
+     * In MSI delivery mode interrupts are written directly to the target's guest interrupt file.
+     * Otherwise, if the current cpu is the targeting cpu, signal the intp to the hart. Else, send
+     * a mensage to the targeting cpu
      */
-    if (pcpu_id == cpu()->id) {
+    if (APLIC_MSI_MODE) {
+        vaplic_forward_msis(vcpu, vhart_index);
+    } else if (pcpu_id == cpu()->id) {
         if (vaplic_update_topi(vcpu)) {
             CSRS(CSR_HVIP, HIP_VSEIP);
         } else {
@@ -293,7 +383,7 @@ static void vaplic_set_domaincfg(struct vcpu* vcpu, uint32_t new_val)
     /** Update only the virtual domaincfg */
     /** Only Interrupt Enable is configurable */
     new_val &= APLIC_DOMAINCFG_IE;
-    new_val &= ~APLIC_DOMAINCFG_DM;
+    new_val |= APLIC_MSI_MODE ? APLIC_DOMAINCFG_DM : 0;
     vaplic->domaincfg = new_val | APLIC_DOMAINCFG_RO80;
     vaplic_update_hart(vcpu, UPDATE_ALL_HARTS);
     spin_unlock(&vaplic->lock);
@@ -367,6 +457,7 @@ static void vaplic_set_sourcecfg(struct vcpu* vcpu, irqid_t intp_id, uint32_t ne
 
         if (new_val == APLIC_SOURCECFG_SM_INACTIVE) {
             CLR_INTP_REG(vaplic->active, intp_id);
+            vaplic_clear_pend_enbl(vcpu, intp_id);
             /** Zero pend, en and target registers if intp is now inactive */
             CLR_INTP_REG(vaplic->ip, intp_id);
             CLR_INTP_REG(vaplic->ie, intp_id);
@@ -415,6 +506,7 @@ static void vaplic_set_setip(struct vcpu* vcpu, size_t reg, uint32_t new_val)
         new_val &= vaplic->active[reg];
         update_intps = (~vaplic->ip[reg]) & new_val;
         vaplic->ip[reg] |= new_val;
+        vaplic_update_pend_enbl_reg(vcpu, reg, update_intps);
         for (size_t i = (reg * APLIC_NUM_INTP_PER_REG);
              i < (reg * APLIC_NUM_INTP_PER_REG) + APLIC_NUM_INTP_PER_REG; i++) {
             if (!!bit32_get(update_intps, i % 32)) {
@@ -462,6 +554,7 @@ static void vaplic_set_in_clrip(struct vcpu* vcpu, size_t reg, uint32_t new_val)
         new_val &= vaplic->hw[reg];
         aplic_clr_pend_reg(reg, new_val);
         vaplic->ip[reg] |= aplic_get_pend_reg(reg);
+        vaplic_update_pend_enbl_reg(vcpu, reg, update_intps ^ vaplic->ip[reg]);
         update_intps &= ~(vaplic->ip[reg]);
         for (size_t i = (reg * APLIC_NUM_INTP_PER_REG);
              i < (reg * APLIC_NUM_INTP_PER_REG) + APLIC_NUM_INTP_PER_REG; i++) {
@@ -509,6 +602,7 @@ static void vaplic_set_clripnum(struct vcpu* vcpu, uint32_t new_val)
         } else {
             CLR_INTP_REG(vaplic->ip, new_val);
         }
+        vaplic_update_pend_enbl(vcpu, new_val);
         vaplic_update_hart(vcpu, vaplic_get_hart_index(vcpu, new_val));
     }
     spin_unlock(&vaplic->lock);
@@ -549,6 +643,7 @@ static void vaplic_set_setie(struct vcpu* vcpu, size_t reg, uint32_t new_val)
         new_val &= vaplic->active[reg];
         update_intps = ~(vaplic->ie[reg]) & new_val;
         vaplic->ie[reg] |= new_val;
+        vaplic_update_pend_enbl_reg(vcpu, reg, update_intps);
         new_val &= vaplic->hw[reg];
         aplic_set_enbl_reg(reg, new_val);
         for (size_t i = (reg * APLIC_NUM_INTP_PER_REG);
@@ -577,6 +672,7 @@ static void vaplic_set_setienum(struct vcpu* vcpu, uint32_t new_val)
             aplic_set_enbl(new_val);
         }
         SET_INTP_REG(vaplic->ie, new_val);
+        vaplic_update_pend_enbl(vcpu, new_val);
         vaplic_update_hart(vcpu, vaplic_get_hart_index(vcpu, new_val));
     }
     spin_unlock(&vaplic->lock);
@@ -599,6 +695,7 @@ static void vaplic_set_clrie(struct vcpu* vcpu, size_t reg, uint32_t new_val)
         new_val &= vaplic->active[reg];
         update_intps = vaplic->ip[reg] & ~new_val;
         vaplic->ie[reg] &= ~(new_val);
+        vaplic_update_pend_enbl_reg(vcpu, reg, new_val);
         new_val &= vaplic->hw[reg];
         aplic_clr_enbl_reg(reg, new_val);
         for (size_t i = (reg * APLIC_NUM_INTP_PER_REG);
@@ -627,6 +724,7 @@ static void vaplic_set_clrienum(struct vcpu* vcpu, uint32_t new_val)
             aplic_clr_enbl(new_val);
         }
         CLR_INTP_REG(vaplic->ie, new_val);
+        vaplic_update_pend_enbl(vcpu, new_val);
         vaplic_update_hart(vcpu, vaplic_get_hart_index(vcpu, new_val));
     }
     spin_unlock(&vaplic->lock);
@@ -644,6 +742,7 @@ static void vaplic_set_target(struct vcpu* vcpu, irqid_t intp_id, uint32_t new_v
     struct vaplic* vaplic = &vcpu->vm->arch.vaplic;
     vcpuid_t hart_index = (new_val >> APLIC_TARGET_HART_IDX_SHIFT) & APLIC_TARGET_HART_IDX_MASK;
     uint8_t priority = new_val & APLIC_IPRIO_MASK;
+    irqid_t eiid = new_val & APLIC_TARGET_EEID_MASK;
     cpuid_t pcpu_id = vm_translate_to_pcpuid(vcpu->vm, hart_index);
     vcpuid_t prev_hart_index = 0;
 
@@ -655,19 +754,35 @@ static void vaplic_set_target(struct vcpu* vcpu, irqid_t intp_id, uint32_t new_v
         pcpu_id = vm_translate_to_pcpuid(vcpu->vm, hart_index);
     }
 
-    new_val &= APLIC_TARGET_DIRECT_MASK;
-    if (priority == 0) {
-        new_val |= APLIC_TARGET_MAX_PRIO;
-        priority = APLIC_TARGET_MAX_PRIO;
+    if (APLIC_MSI_MODE) {
+        /** The guest index is always 0, as the guest has a single interrupt file per hart */
+        new_val = (hart_index << APLIC_TARGET_HART_IDX_SHIFT) | eiid;
+    } else {
+        new_val &= APLIC_TARGET_DIRECT_MASK;
+        if (priority == 0) {
+            new_val |= APLIC_TARGET_MAX_PRIO;
+            priority = APLIC_TARGET_MAX_PRIO;
+        }
     }
     if (vaplic_get_active(vcpu, intp_id) && vaplic_get_target(vcpu, intp_id) != new_val) {
         prev_hart_index = vaplic_get_hart_index(vcpu, intp_id);
         if (vaplic_get_hw(vcpu, intp_id)) {
-            aplic_set_target_hart(intp_id, pcpu_id);
-            aplic_set_target_prio(intp_id, priority);
-            priority = aplic_get_target_prio(intp_id);
+            if (APLIC_MSI_MODE) {
+                /** Deliver the interrupt directly to the guest interrupt file of the target */
+                aplic_set_target_msi(intp_id, pcpu_id, IMSIC_VGEIN, eiid);
+            } else {
+                aplic_set_target_hart(intp_id, pcpu_id);
+                aplic_set_target_prio(intp_id, priority);
+                priority = aplic_get_target_prio(intp_id);
+            }
+        }
+        vaplic_clear_pend_enbl(vcpu, intp_id);
+        if (APLIC_MSI_MODE) {
+            vaplic->target[intp_id] = new_val;
+        } else {
+            vaplic->target[intp_id] = (hart_index << APLIC_TARGET_HART_IDX_SHIFT) | priority;
         }
-        vaplic->target[intp_id] = (hart_index << APLIC_TARGET_HART_IDX_SHIFT) | priority;
+        vaplic_update_pend_enbl(vcpu, intp_id);
         if (prev_hart_index != hart_index) {
             vaplic_update_hart(vcpu, prev_hart_index);
         }
@@ -842,6 +957,7 @@ static uint32_t vaplic_get_claimi(struct vcpu* vcpu, idcid_t idc_id)
     if (idc_id < vaplic->idc_num) {
         ret = vaplic->topi_claimi[idc_id];
         CLR_INTP_REG(vaplic->ip, (ret >> IDC_CLAIMI_INTP_ID_SHIFT));
+        vaplic_update_pend_enbl(vcpu, (ret >> IDC_CLAIMI_INTP_ID_SHIFT));
         /** Spurious intp*/
         if (ret == 0) {
             bitmap_clear(vaplic->iforce, idc_id);
@@ -1283,6 +1399,8 @@ void vaplic_init(struct vm* vm, const union vm_irqc_dscrp* vm_irqc_dscrp)
     if (cpu()->id == vm->master) {
         /* 1 IDC per hart */
         vm->arch.vaplic.idc_num = vm->cpu_num;
+        vm->arch.vaplic.domaincfg =
+            APLIC_DOMAINCFG_RO80 | (APLIC_MSI_MODE ? APLIC_DOMAINCFG_DM : 0);
 
         vm->arch.vaplic.aplic_domain_emul =
             (struct emul_mem){ .va_base = vm_irqc_dscrp->aia.aplic.base,
@@ -1291,11 +1409,25 @@ void vaplic_init(struct vm* vm, const union vm_irqc_dscrp* vm_irqc_dscrp)
 
         vm_emul_add_mem(vm, &vm->arch.vaplic.aplic_domain_emul);
 
-        vm->arch.vaplic.aplic_idc_emul =
-            (struct emul_mem){ .va_base = vm_irqc_dscrp->aia.aplic.base + APLIC_IDC_OFF,
-                .size = sizeof(struct aplic_idc_hw) * vm->arch.vaplic.idc_num,
-                .handler = vaplic_idc_emul_handler };
+        /** There are no IDCs in MSI delivery mode */
+        if (!APLIC_MSI_MODE) {
+            vm->arch.vaplic.aplic_idc_emul =
+                (struct emul_mem){ .va_base = vm_irqc_dscrp->aia.aplic.base + APLIC_IDC_OFF,
+                    .size = sizeof(struct aplic_idc_hw) * vm->arch.vaplic.idc_num,
+                    .handler = vaplic_idc_emul_handler };
+
+            vm_emul_add_mem(vm, &vm->arch.vaplic.aplic_idc_emul);
+        }
+    }
 
-        vm_emul_add_mem(vm, &vm->arch.vaplic.aplic_idc_emul);
+    if (APLIC_MSI_MODE) {
+        /**
+         * Each vcpu gets direct access to the guest interrupt file of the hart it runs on, so
+         * MSIs, including those sent by the physical APLIC, reach it with no hypervisor
+         * intervention.
+         */
+        vaddr_t va = vm_irqc_dscrp->aia.imsic.base + (cpu()->vcpu->id * IMSIC_FILE_SIZE);
+        mem_alloc_map_dev(&vm->as, SEC_VM_ANY, va, imsic_guest_file_addr(cpu()->id),
+            NUM_PAGES(IMSIC_FILE_SIZE));
     }
 }
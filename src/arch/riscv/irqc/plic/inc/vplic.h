@@ -21,6 +21,8 @@ struct vplic {
     uint32_t prio[PLIC_MAX_INTERRUPTS];
     BITMAP_ALLOC_ARRAY(enbl, PLIC_MAX_INTERRUPTS, PLIC_PLAT_CNTXT_NUM);
     uint32_t threshold[PLIC_PLAT_CNTXT_NUM];
+    irqid_t next_pend[PLIC_PLAT_CNTXT_NUM];
+    BITMAP_ALLOC(next_pend_valid, PLIC_PLAT_CNTXT_NUM);
     struct emul_mem plic_global_emul;
     struct emul_mem plic_threshold_emul;
 };
@@ -11,6 +11,8 @@
 #include <interrupts.h>
 #include <arch/csrs.h>
 
+#define VPLIC_ALL_CNTXTS (-1)
+
 static int vplic_vcntxt_to_pcntxt(struct vcpu* vcpu, int vcntxt_id)
 {
     struct plic_cntxt vcntxt = plic_plat_id_to_cntxt(vcntxt_id);
@@ -42,16 +44,6 @@ static bool vplic_get_pend(struct vcpu* vcpu, irqid_t id)
     return ret;
 }
 
-static bool vplic_get_act(struct vcpu* vcpu, irqid_t id)
-{
-    bool ret = false;
-    struct vplic* vplic = &vcpu->vm->arch.vplic;
-    if (id < PLIC_MAX_INTERRUPTS) {
-        ret = bitmap_get(vplic->act, id);
-    }
-    return ret;
-}
-
 static bool vplic_get_enbl(struct vcpu* vcpu, int vcntxt, irqid_t id)
 {
     bool ret = false;
@@ -95,45 +87,107 @@ static uint32_t vplic_get_threshold(struct vcpu* vcpu, int vcntxt)
     return vplic->threshold[vcntxt];
 }
 
-static irqid_t vplic_next_pending(struct vcpu* vcpu, int vcntxt)
+/**
+ * The next pending interrupt of each context is cached until any of the state it depends on
+ * changes. Changes to the pending, active or priority state affect all contexts, while enable and
+ * threshold changes only affect their own context. Must be called holding the vplic lock.
+ */
+static inline void vplic_invalidate_next_pending(struct vcpu* vcpu, int vcntxt)
 {
+    struct vplic* vplic = &vcpu->vm->arch.vplic;
+    if (vcntxt < 0) {
+        bitmap_clear_consecutive(vplic->next_pend_valid, 0, PLIC_PLAT_CNTXT_NUM);
+    } else {
+        bitmap_clear(vplic->next_pend_valid, (size_t)vcntxt);
+    }
+}
+
+/**
+ * Returns the highest priority interrupt pending and enabled in a context above its threshold, or 0
+ * if there is none. The cache is not touched, so it might be called without the vplic lock.
+ */
+static irqid_t vplic_scan_pending(struct vcpu* vcpu, int vcntxt)
+{
+    struct vplic* vplic = &vcpu->vm->arch.vplic;
     uint32_t max_prio = 0;
     irqid_t int_id = 0;
 
-    for (size_t i = 0; i < PLIC_MAX_INTERRUPTS; i++) {
-        if (vplic_get_pend(vcpu, i) && !vplic_get_act(vcpu, i) && vplic_get_enbl(vcpu, vcntxt, i)) {
-            uint32_t prio = vplic_get_prio(vcpu, i);
+    for (size_t i = 0; i < BITMAP_SIZE(PLIC_MAX_INTERRUPTS); i++) {
+        bitmap_granule_t candidates = vplic->pend[i] & ~vplic->act[i] & vplic->enbl[vcntxt][i];
+        ssize_t bit = bitmap_granule_ffs(candidates);
+        while (bit >= 0) {
+            irqid_t id = (irqid_t)((i * BITMAP_GRANULE_LEN) + (size_t)bit);
+            uint32_t prio = vplic->prio[id];
             if (prio > max_prio) {
                 max_prio = prio;
-                int_id = i;
+                int_id = id;
             }
+            candidates = bit32_clear(candidates, (size_t)bit);
+            bit = bitmap_granule_ffs(candidates);
         }
     }
 
-    if (max_prio > vplic_get_threshold(vcpu, vcntxt)) {
-        return int_id;
-    } else {
-        return 0;
+    if (max_prio <= vplic_get_threshold(vcpu, vcntxt)) {
+        int_id = 0;
     }
+
+    return int_id;
+}
+
+/**
+ * Must be called holding the vplic lock.
+ */
+static irqid_t vplic_next_pending(struct vcpu* vcpu, int vcntxt)
+{
+    struct vplic* vplic = &vcpu->vm->arch.vplic;
+
+    if (bitmap_get(vplic->next_pend_valid, vcntxt)) {
+        return vplic->next_pend[vcntxt];
+    }
+
+    irqid_t int_id = vplic_scan_pending(vcpu, vcntxt);
+    vplic->next_pend[vcntxt] = int_id;
+    bitmap_set(vplic->next_pend_valid, vcntxt);
+
+    return int_id;
 }
 
 enum { UPDATE_HART_LINE };
 static void vplic_ipi_handler(uint32_t event, uint64_t data);
 CPU_MSG_HANDLER(vplic_ipi_handler, VPLIC_IPI_ID);
 
-void vplic_update_hart_line(struct vcpu* vcpu, int vcntxt)
+static inline void vplic_set_hart_line(bool pending)
+{
+    if (pending) {
+        CSRS(CSR_HVIP, HIP_VSEIP);
+    } else {
+        CSRC(CSR_HVIP, HIP_VSEIP);
+    }
+}
+
+/**
+ * Must be called holding the vplic lock. Contexts of other harts are only marked in remote, and
+ * their lines updated by vplic_update_remote_hart_lines once the lock is released.
+ */
+static void vplic_update_hart_line(struct vcpu* vcpu, int vcntxt, bitmap_t* remote)
 {
     int pcntxt_id = vplic_vcntxt_to_pcntxt(vcpu, vcntxt);
     struct plic_cntxt pcntxt = plic_plat_id_to_cntxt(pcntxt_id);
     if (pcntxt.hart_id == cpu()->id) {
-        int id = vplic_next_pending(vcpu, vcntxt);
-        if (id != 0) {
-            CSRS(CSR_HVIP, HIP_VSEIP);
-        } else {
-            CSRC(CSR_HVIP, HIP_VSEIP);
-        }
+        vplic_set_hart_line(vplic_next_pending(vcpu, vcntxt) != 0);
     } else {
-        struct cpu_msg msg = { VPLIC_IPI_ID, UPDATE_HART_LINE, vcntxt };
+        bitmap_set(remote, (size_t)vcntxt);
+    }
+}
+
+/**
+ * Must be called without the vplic lock, so a sender never waits on a target while holding it.
+ */
+static void vplic_update_remote_hart_lines(struct vcpu* vcpu, bitmap_t* remote)
+{
+    bitmap_foreach_set(remote, PLIC_PLAT_CNTXT_NUM, vcntxt) {
+        struct plic_cntxt pcntxt = plic_plat_id_to_cntxt(vplic_vcntxt_to_pcntxt(vcpu, (int)vcntxt));
+        struct cpu_msg msg = { VPLIC_IPI_ID, UPDATE_HART_LINE, (uint64_t)vcntxt };
         cpu_send_msg(pcntxt.hart_id, &msg);
     }
 }
@@ -142,7 +196,11 @@ static void vplic_ipi_handler(uint32_t event, uint64_t data)
 {
     switch (event) {
         case UPDATE_HART_LINE:
-            vplic_update_hart_line(cpu()->vcpu, data);
+            /**
+             * The state is scanned without the vplic lock. Any update racing with the scan sends
+             * another message once it releases the lock, so the line is eventually up to date.
+             */
+            vplic_set_hart_line(vplic_scan_pending(cpu()->vcpu, (int)data) != 0);
             break;
     }
 }
@@ -150,18 +208,21 @@ static void vplic_ipi_handler(uint32_t event, uint64_t data)
 static void vplic_set_threshold(struct vcpu* vcpu, int vcntxt, uint32_t threshold)
 {
     struct vplic* vplic = &vcpu->vm->arch.vplic;
+    BITMAP_ALLOC(remote, PLIC_PLAT_CNTXT_NUM) = { 0 };
     spin_lock(&vplic->lock);
     vplic->threshold[vcntxt] = threshold;
+    vplic_invalidate_next_pending(vcpu, vcntxt);
     int pcntxt = vplic_vcntxt_to_pcntxt(vcpu, vcntxt);
     plic_set_threshold(pcntxt, threshold);
+    vplic_update_hart_line(vcpu, vcntxt, remote);
     spin_unlock(&vplic->lock);
-
-    vplic_update_hart_line(vcpu, vcntxt);
+    vplic_update_remote_hart_lines(vcpu, remote);
 }
 
 static void vplic_set_enbl(struct vcpu* vcpu, int vcntxt, irqid_t id, bool set)
 {
     struct vplic* vplic = &vcpu->vm->arch.vplic;
+    BITMAP_ALLOC(remote, PLIC_PLAT_CNTXT_NUM) = { 0 };
     spin_lock(&vplic->lock);
     if (id < PLIC_MAX_INTERRUPTS && vplic_get_enbl(vcpu, vcntxt, id) != set) {
         if (set) {
@@ -169,23 +230,27 @@ static void vplic_set_enbl(struct vcpu* vcpu, int vcntxt, irqid_t id, bool set)
         } else {
             bitmap_clear(vplic->enbl[vcntxt], id);
         }
+        vplic_invalidate_next_pending(vcpu, vcntxt);
 
         if (vplic_get_hw(vcpu, id)) {
             int pcntxt_id = vplic_vcntxt_to_pcntxt(vcpu, vcntxt);
             plic_set_enbl(pcntxt_id, id, set);
         } else {
-            vplic_update_hart_line(vcpu, vcntxt);
+            vplic_update_hart_line(vcpu, vcntxt, remote);
         }
     }
     spin_unlock(&vplic->lock);
+    vplic_update_remote_hart_lines(vcpu, remote);
 }
 
 static void vplic_set_prio(struct vcpu* vcpu, irqid_t id, uint32_t prio)
 {
     struct vplic* vplic = &vcpu->vm->arch.vplic;
+    BITMAP_ALLOC(remote, PLIC_PLAT_CNTXT_NUM) = { 0 };
     spin_lock(&vplic->lock);
     if (id < PLIC_MAX_INTERRUPTS && vplic_get_prio(vcpu, id) != prio) {
         vplic->prio[id] = prio;
+        vplic_invalidate_next_pending(vcpu, VPLIC_ALL_CNTXTS);
         if (vplic_get_hw(vcpu, id)) {
             plic_set_prio(id, prio);
         } else {
@@ -194,23 +259,27 @@ static void vplic_set_prio(struct vcpu* vcpu, irqid_t id, uint32_t prio)
                     continue;
                 }
                 if (vplic_get_enbl(vcpu, i, id)) {
-                    vplic_update_hart_line(vcpu, i);
+                    vplic_update_hart_line(vcpu, i, remote);
                 }
             }
         }
     }
     spin_unlock(&vplic->lock);
+    vplic_update_remote_hart_lines(vcpu, remote);
 }
 
 static irqid_t vplic_claim(struct vcpu* vcpu, int vcntxt)
 {
+    BITMAP_ALLOC(remote, PLIC_PLAT_CNTXT_NUM) = { 0 };
     spin_lock(&vcpu->vm->arch.vplic.lock);
     irqid_t int_id = vplic_next_pending(vcpu, vcntxt);
     bitmap_clear(vcpu->vm->arch.vplic.pend, int_id);
     bitmap_set(vcpu->vm->arch.vplic.act, int_id);
+    vplic_invalidate_next_pending(vcpu, VPLIC_ALL_CNTXTS);
+    vplic_update_hart_line(vcpu, vcntxt, remote);
     spin_unlock(&vcpu->vm->arch.vplic.lock);
+    vplic_update_remote_hart_lines(vcpu, remote);
 
-    vplic_update_hart_line(vcpu, vcntxt);
     return int_id;
 }
 
@@ -220,24 +289,28 @@ static void vplic_complete(struct vcpu* vcpu, int vcntxt, irqid_t int_id)
         plic_hart[cpu()->arch.plic_cntxt].complete = int_id;
     }
 
+    BITMAP_ALLOC(remote, PLIC_PLAT_CNTXT_NUM) = { 0 };
     spin_lock(&vcpu->vm->arch.vplic.lock);
     bitmap_clear(vcpu->vm->arch.vplic.act, int_id);
+    vplic_invalidate_next_pending(vcpu, VPLIC_ALL_CNTXTS);
+    vplic_update_hart_line(vcpu, vcntxt, remote);
     spin_unlock(&vcpu->vm->arch.vplic.lock);
-
-    vplic_update_hart_line(vcpu, vcntxt);
+    vplic_update_remote_hart_lines(vcpu, remote);
 }
 
 void vplic_inject(struct vcpu* vcpu, irqid_t id)
 {
     struct vplic* vplic = &vcpu->vm->arch.vplic;
+    BITMAP_ALLOC(remote, PLIC_PLAT_CNTXT_NUM) = { 0 };
     spin_lock(&vplic->lock);
     if (id > 0 && id < PLIC_MAX_INTERRUPTS && !vplic_get_pend(vcpu, id)) {
         bitmap_set(vplic->pend, id);
+        vplic_invalidate_next_pending(vcpu, VPLIC_ALL_CNTXTS);
 
         if (vplic_get_hw(vcpu, id)) {
             struct plic_cntxt vcntxt = { vcpu->id, PRIV_S };
             int vcntxt_id = plic_plat_cntxt_to_id(vcntxt);
-            vplic_update_hart_line(vcpu, vcntxt_id);
+            vplic_update_hart_line(vcpu, vcntxt_id, remote);
         } else {
             for (size_t i = 0; i < vplic->cntxt_num; i++) {
                 if (plic_plat_id_to_cntxt(i).mode != PRIV_S) {
@@ -245,12 +318,13 @@ void vplic_inject(struct vcpu* vcpu, irqid_t id)
                 }
                 if (vplic_get_enbl(vcpu, i, id) &&
                     vplic_get_prio(vcpu, id) > vplic_get_threshold(vcpu, i)) {
-                    vplic_update_hart_line(vcpu, i);
+                    vplic_update_hart_line(vcpu, i, remote);
                 }
             }
         }
     }
     spin_unlock(&vplic->lock);
+    vplic_update_remote_hart_lines(vcpu, remote);
 }
 
 static void vplic_emul_prio_access(struct emul_access* acc)
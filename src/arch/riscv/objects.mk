@@ -15,4 +15,5 @@ cpu-objs-y+=cpu.o
 cpu-objs-y+=cache.o
 cpu-objs-y+=iommu.o
 cpu-objs-y+=relocate.o
-cpu-objs-y+=aclint.o
\ No newline at end of file
+cpu-objs-y+=aclint.o
+cpu-objs-y+=string.o
@@ -234,16 +234,19 @@ struct sbiret sbi_ipi_handler(unsigned long fid)
         .event = SEND_IPI,
     };
 
+    cpumap_t phart_mask = 0;
     for (size_t i = 0; i < sizeof(hart_mask) * 8; i++) {
         if (bit_get(hart_mask, i)) {
             vcpuid_t vhart_id = hart_mask_base + i;
             cpuid_t phart_id = vm_translate_to_pcpuid(cpu()->vcpu->vm, vhart_id);
             if (phart_id != INVALID_CPUID) {
-                cpu_send_msg(phart_id, &msg);
+                phart_mask = bit_set(phart_mask, phart_id);
             }
         }
     }
 
+    cpu_send_msg_mask(phart_mask, &msg);
+
     return (struct sbiret){ SBI_SUCCESS };
 }
 
@@ -6,6 +6,7 @@
 #include <bao.h>
 #include <cpu.h>
 #include <vm.h>
+#include <stats.h>
 #include <arch/encoding.h>
 #include <arch/csrs.h>
 #include <arch/instructions.h>
@@ -136,6 +137,7 @@ static const size_t sync_handler_table_size = sizeof(sync_handler_table) / sizeo
 
 void sync_exception_handler()
 {
+    uint64_t start = stats_start();
     size_t pc_step = 0;
     unsigned long _scause = CSRR(scause);
 
@@ -152,4 +154,6 @@ void sync_exception_handler()
     }
 
     cpu()->vcpu->regs.sepc += pc_step;
+
+    stats_record(cpu()->vcpu, STATS_EXIT(_scause), start);
 }
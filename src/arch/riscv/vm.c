@@ -37,6 +37,10 @@ void vcpu_arch_reset(struct vcpu* vcpu, vaddr_t entry)
     CSRW(sscratch, &vcpu->regs);
 
     vcpu->regs.hstatus = HSTATUS_SPV | HSTATUS_VSXL_64;
+#if (IRQC == AIA)
+    /** Select the guest interrupt file passed through to this vcpu as its external interrupts */
+    vcpu->regs.hstatus |= (IMSIC_VGEIN << HSTATUS_VGEIN_OFF);
+#endif
     vcpu->regs.sstatus = SSTATUS_SPP_BIT | SSTATUS_FS_DIRTY | SSTATUS_XS_DIRTY;
     vcpu->regs.sepc = entry;
     vcpu->regs.a0 = vcpu->arch.hart_id = vcpu->id;
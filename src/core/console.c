@@ -51,6 +51,34 @@ void console_write(const char* buf, size_t n)
     }
 }
 
+/**
+ * Not all uart drivers support input. These defaults make the console output-only for those
+ * which do not provide the non-blocking receive interface.
+ */
+__attribute__((weak)) bool uart_trygetc(volatile bao_uart_t* uart, char* c)
+{
+    (void)uart;
+    (void)c;
+    return false;
+}
+
+__attribute__((weak)) void uart_rxirq_enable(volatile bao_uart_t* uart)
+{
+    (void)uart;
+}
+
+bool console_getc(char* c)
+{
+    return console_ready && uart_trygetc(uart, c);
+}
+
+void console_rx_enable()
+{
+    if (console_ready) {
+        uart_rxirq_enable(uart);
+    }
+}
+
 #define PRINTF_BUFFER_LEN (256)
 static char console_bufffer[PRINTF_BUFFER_LEN];
 
@@ -6,22 +6,14 @@
 #include <cpu.h>
 #include <interrupts.h>
 #include <platform.h>
-#include <objpool.h>
 #include <vm.h>
+#include <stats.h>
 #include <fences.h>
 
-struct cpu_msg_node {
-    node_t node;
-    struct cpu_msg msg;
-};
-
-#define CPU_MSG_POOL_SIZE_DEFAULT (128)
-#ifndef CPU_MSG_POOL_SIZE
-#define CPU_MSG_POOL_SIZE CPU_MSG_POOL_SIZE_DEFAULT
+#if ((CPU_MSG_RING_SIZE) & ((CPU_MSG_RING_SIZE)-1)) != 0
+#error "CPU_MSG_RING_SIZE must be a power of two"
 #endif
 
-OBJPOOL_ALLOC(msg_pool, struct cpu_msg_node, CPU_MSG_POOL_SIZE);
-
 struct cpu_synctoken cpu_glb_sync = { .ready = false };
 
 extern cpu_msg_handler_t ipi_cpumsg_handlers[];
@@ -39,7 +31,11 @@ void cpu_init(cpuid_t cpu_id, paddr_t load_addr)
 
     cpu_arch_init(cpu_id, load_addr);
 
-    list_init(&cpu()->interface->event_list);
+    for (size_t i = 0; i < PLAT_CPU_NUM; i++) {
+        cpu()->interface->msg_rings[i].head = 0;
+        cpu()->interface->msg_rings[i].tail = 0;
+    }
+    cpu()->interface->msg_doorbell = false;
 
     if (cpu_is_master()) {
         cpu_sync_init(&cpu_glb_sync, platform.cpu_num);
@@ -53,38 +49,105 @@ void cpu_init(cpuid_t cpu_id, paddr_t load_addr)
     cpu_sync_barrier(&cpu_glb_sync);
 }
 
+/**
+ * Posts a message in the calling cpu's ring of the target interface. Returns true if the target
+ * doorbell was not yet pending, i.e., if the caller is responsible for raising the IPI_CPU_MSG ipi.
+ */
+static bool cpu_msg_post(cpuid_t trgtcpu, struct cpu_msg* msg)
+{
+    /**
+     * The calling cpu is the only producer of this ring, so there is no need to lock it. The
+     * message must be visible before the tail is advanced, and the tail must be visible before the
+     * doorbell is checked so that it is not missed by a receiver concurrently clearing it.
+     */
+    struct cpuif* trgtif = cpu_if(trgtcpu);
+    struct cpu_msg_ring* ring = &trgtif->msg_rings[cpu()->id];
+    size_t tail = ring->tail;
+
+    if ((tail - ring->head) >= CPU_MSG_RING_SIZE) {
+        ERROR("cpu %lu msg ring full", trgtcpu);
+    }
+
+    ring->buf[tail % CPU_MSG_RING_SIZE] = *msg;
+    fence_ord_write();
+    ring->tail = tail + 1;
+    fence_ord();
+
+    if (trgtif->msg_doorbell) {
+        return false;
+    }
+
+    trgtif->msg_doorbell = true;
+    return true;
+}
+
 void cpu_send_msg(cpuid_t trgtcpu, struct cpu_msg* msg)
 {
-    struct cpu_msg_node* node = objpool_alloc(&msg_pool);
-    if (node == NULL) {
-        ERROR("cant allocate msg node");
+    if (cpu_msg_post(trgtcpu, msg)) {
+        fence_sync_write();
+        interrupts_cpu_sendipi(trgtcpu, IPI_CPU_MSG);
     }
-    node->msg = *msg;
-    list_push(&cpu_if(trgtcpu)->event_list, (node_t*)node);
-    fence_sync_write();
-    interrupts_cpu_sendipi(trgtcpu, IPI_CPU_MSG);
 }
 
-bool cpu_get_msg(struct cpu_msg* msg)
+void cpu_send_msg_mask(cpumap_t trgtcpus, struct cpu_msg* msg)
 {
-    struct cpu_msg_node* node = NULL;
-    if ((node = (struct cpu_msg_node*)list_pop(&cpu()->interface->event_list)) != NULL) {
-        *msg = node->msg;
-        objpool_free(&msg_pool, node);
-        return true;
+    cpumap_t ipi_cpus = 0;
+
+    for (cpuid_t i = 0; i < platform.cpu_num; i++) {
+        if (bit_get(trgtcpus, i) && cpu_msg_post(i, msg)) {
+            ipi_cpus = bit_set(ipi_cpus, i);
+        }
+    }
+
+    if (ipi_cpus != 0) {
+        fence_sync_write();
+        interrupts_cpu_sendipi_mask(ipi_cpus, IPI_CPU_MSG);
     }
-    return false;
+}
+
+static size_t cpu_msg_ring_drain(struct cpu_msg_ring* ring)
+{
+    size_t head = ring->head;
+    size_t tail = ring->tail;
+
+    if (head == tail) {
+        return 0;
+    }
+
+    fence_ord_read();
+
+    for (size_t i = head; i != tail; i++) {
+        struct cpu_msg* msg = &ring->buf[i % CPU_MSG_RING_SIZE];
+        if (msg->handler < ipi_cpumsg_handler_num && ipi_cpumsg_handlers[msg->handler]) {
+            uint64_t start = stats_start();
+            ipi_cpumsg_handlers[msg->handler](msg->event, msg->data);
+            stats_record(cpu()->vcpu, STATS_CPUMSG(msg->handler), start);
+        }
+    }
+
+    /**
+     * Release the whole batch at once. The slots must be fully consumed before the sender is
+     * allowed to reuse them.
+     */
+    fence_ord();
+    ring->head = tail;
+
+    return tail - head;
 }
 
 void cpu_msg_handler()
 {
+    size_t handled;
+
     cpu()->handling_msgs = true;
-    struct cpu_msg msg;
-    while (cpu_get_msg(&msg)) {
-        if (msg.handler < ipi_cpumsg_handler_num && ipi_cpumsg_handlers[msg.handler]) {
-            ipi_cpumsg_handlers[msg.handler](msg.event, msg.data);
+    cpu()->interface->msg_doorbell = false;
+    fence_ord();
+    do {
+        handled = 0;
+        for (size_t i = 0; i < platform.cpu_num; i++) {
+            handled += cpu_msg_ring_drain(&cpu()->interface->msg_rings[i]);
         }
-    }
+    } while (handled > 0);
     cpu()->handling_msgs = false;
 }
 
@@ -7,9 +7,11 @@
 #include <cpu.h>
 #include <vm.h>
 #include <ipc.h>
+#include <stats.h>
 
 long int hypercall(unsigned long id)
 {
+    uint64_t start = stats_start();
     long int ret = -HC_E_INVAL_ID;
 
     unsigned long ipc_id = vcpu_readreg(cpu()->vcpu, HYPCALL_ARG_REG(0));
@@ -20,9 +22,18 @@ long int hypercall(unsigned long id)
         case HC_IPC:
             ret = ipc_hypercall(ipc_id, arg1, arg2);
             break;
+#ifdef STATS
+        case HC_STATS:
+            ret = stats_hypercall(ipc_id, arg1, arg2);
+            break;
+#endif
         default:
             WARNING("Unknown hypercall id %d", id);
     }
 
+    if (id < STATS_HC_NUM) {
+        stats_record(cpu()->vcpu, STATS_HC(id), start);
+    }
+
     return ret;
 }
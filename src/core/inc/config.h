@@ -87,6 +87,12 @@ struct vm_config {
      */
     colormap_t colors;
 
+    /**
+     * Allows the VM to read the exit statistics of its vcpus through the HC_STATS hypercall. Only
+     * available in hypervisors built with STATS=y.
+     */
+    bool hyp_stats;
+
     /**
      * A description of the virtual platform available to the guest, i.e., the virtual machine
      * itself.
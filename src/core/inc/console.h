@@ -10,6 +10,8 @@
 
 void console_init();
 void console_write(const char* buf, size_t n);
+bool console_getc(char* c);
+void console_rx_enable();
 void console_printk(const char* fmt, ...);
 
 #endif /* __CONSOLE_H__ */
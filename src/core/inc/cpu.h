@@ -12,11 +12,46 @@
 #include <spinlock.h>
 #include <mem.h>
 #include <list.h>
+#include <cache.h>
+#include <platform_defs.h>
 
 #ifndef __ASSEMBLER__
 
+/**
+ * Maximum number of messages a cpu may have pending on each target. Senders do not wait for room,
+ * so running out of it is fatal: a sender might hold locks the target needs to drain its rings.
+ */
+#define CPU_MSG_RING_SIZE_DEFAULT (32)
+#ifndef CPU_MSG_RING_SIZE
+#define CPU_MSG_RING_SIZE CPU_MSG_RING_SIZE_DEFAULT
+#endif
+
+struct cpu_msg {
+    uint32_t handler;
+    uint32_t event;
+    uint64_t data;
+};
+
+/**
+ * Single-producer/single-consumer message ring. Each cpu interface holds one ring per possible
+ * sender cpu, so the tail is only ever written by the sender and the head only by the receiver.
+ * Both indexes run freely and are masked on access. They are kept in separate cache lines so that
+ * posting and draining messages do not bounce the same line between cores.
+ */
+struct cpu_msg_ring {
+    volatile size_t tail __attribute__((aligned(CACHE_LINE_SIZE)));
+    volatile size_t head __attribute__((aligned(CACHE_LINE_SIZE)));
+    struct cpu_msg buf[CPU_MSG_RING_SIZE] __attribute__((aligned(CACHE_LINE_SIZE)));
+};
+
 struct cpuif {
-    struct list event_list;
+    struct cpu_msg_ring msg_rings[PLAT_CPU_NUM];
+
+    /**
+     * Set by the first sender of a batch, which is the only one to raise the IPI_CPU_MSG ipi, and
+     * cleared by the receiver right before it drains its rings.
+     */
+    volatile bool msg_doorbell __attribute__((aligned(CACHE_LINE_SIZE)));
 
 } __attribute__((aligned(PAGE_SIZE)));
 
@@ -38,13 +73,6 @@ struct cpu {
     uint8_t stack[STACK_SIZE] __attribute__((aligned(PAGE_SIZE)));
 
 } __attribute__((aligned(PAGE_SIZE)));
-struct cpu_msg {
-    uint32_t handler;
-    uint32_t event;
-    uint64_t data;
-};
-
-void cpu_send_msg(cpuid_t cpu, struct cpu_msg* msg);
 
 typedef void (*cpu_msg_handler_t)(uint32_t event, uint64_t data);
 
@@ -64,7 +92,7 @@ extern struct cpu_synctoken cpu_glb_sync;
 
 void cpu_init(cpuid_t cpu_id, paddr_t load_addr);
 void cpu_send_msg(cpuid_t cpu, struct cpu_msg* msg);
-bool cpu_get_msg(struct cpu_msg* msg);
+void cpu_send_msg_mask(cpumap_t cpus, struct cpu_msg* msg);
 void cpu_msg_handler();
 void cpu_msg_set_handler(cpuid_t id, cpu_msg_handler_t handler);
 void cpu_idle();
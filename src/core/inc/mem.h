@@ -12,25 +12,10 @@
 #include <spinlock.h>
 #include <cache.h>
 #include <bitmap.h>
+#include <page_pool.h>
 
 #ifndef __ASSEMBLER__
 
-struct ppages {
-    paddr_t base;
-    size_t num_pages;
-    colormap_t colors;
-};
-
-struct page_pool {
-    node_t node;
-    paddr_t base;
-    size_t size;
-    size_t free;
-    size_t last;
-    bitmap_t* bitmap;
-    spinlock_t lock;
-};
-
 struct mem_region {
     paddr_t base;
     size_t size;
@@ -73,7 +58,6 @@ bool mem_map_reclr(struct addr_space* as, vaddr_t va, struct ppages* ppages, siz
     mem_flags_t flags);
 vaddr_t mem_map_cpy(struct addr_space* ass, struct addr_space* asd, vaddr_t vas, vaddr_t vad,
     size_t num_pages);
-bool pp_alloc(struct page_pool* pool, size_t num_pages, bool aligned, struct ppages* ppages);
 
 void mem_prot_init();
 size_t mem_cpu_boot_alloc_size();
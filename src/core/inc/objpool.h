@@ -7,27 +7,62 @@
 #define OBJPOOL_H
 
 #include <bao.h>
-#include <bitmap.h>
 #include <arch/spinlock.h>
+#include <cache.h>
+#include <platform_defs.h>
 
+#define OBJPOOL_CACHE_SIZE (8)
+
+/**
+ * Per-cpu magazine of free objects. It is only ever accessed by its owner cpu, and the hypervisor
+ * does not nest interrupts, so it needs no locking.
+ */
+struct objpool_cache {
+    size_t num;
+    void* objs[OBJPOOL_CACHE_SIZE];
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/**
+ * Free objects are kept in an intrusive list linked through their first word. Objects that were
+ * never allocated are not in the list: they are carved from the array in order, count tracking how
+ * many have been, so a zero-initialized pool is ready to use. Pools with per-cpu caches only take
+ * the lock to move half a magazine at a time. As objects freed on one cpu stay in its magazine
+ * until it fills up, where no other cpu can take them, cached pools are backed by
+ * OBJPOOL_CACHE_SIZE extra objects per cpu. This way N objects can always be allocated, no matter
+ * how many are stranded in remote magazines.
+ */
 struct objpool {
     void* pool;
-    bitmap_t* bitmap;
     size_t objsize;
     size_t num;
     size_t count;
+    void* free;
+    struct objpool_cache* caches;
     spinlock_t lock;
 };
 
-#define OBJPOOL_ALLOC(NAME, TYPE, N)         \
-    TYPE _##NAME##_array[N];                 \
-    BITMAP_ALLOC(_##NAME##_array_bitmap, N); \
-    struct objpool NAME = {                  \
-        .pool = _##NAME##_array,             \
-        .bitmap = _##NAME##_array_bitmap,    \
-        .objsize = sizeof(TYPE),             \
-        .num = N,                            \
-        .lock = SPINLOCK_INITVAL,            \
+#define OBJPOOL_ALLOC(NAME, TYPE, N)                                           \
+    _Static_assert(sizeof(TYPE) >= sizeof(void*), "objpool object too small"); \
+    TYPE _##NAME##_array[N];                                                   \
+    struct objpool NAME = {                                                    \
+        .pool = _##NAME##_array,                                               \
+        .objsize = sizeof(TYPE),                                               \
+        .num = N,                                                              \
+        .lock = SPINLOCK_INITVAL,                                              \
+    }
+
+#define OBJPOOL_CACHED_NUM(N) ((N) + (PLAT_CPU_NUM * OBJPOOL_CACHE_SIZE))
+
+#define OBJPOOL_ALLOC_CACHED(NAME, TYPE, N)                                    \
+    _Static_assert(sizeof(TYPE) >= sizeof(void*), "objpool object too small"); \
+    TYPE _##NAME##_array[OBJPOOL_CACHED_NUM(N)];                               \
+    struct objpool_cache _##NAME##_caches[PLAT_CPU_NUM];                       \
+    struct objpool NAME = {                                                    \
+        .pool = _##NAME##_array,                                               \
+        .objsize = sizeof(TYPE),                                               \
+        .num = OBJPOOL_CACHED_NUM(N),                                          \
+        .caches = _##NAME##_caches,                                            \
+        .lock = SPINLOCK_INITVAL,                                              \
     }
 
 void objpool_init(struct objpool* objpool);
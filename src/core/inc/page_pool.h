@@ -0,0 +1,45 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __PAGE_POOL_H__
+#define __PAGE_POOL_H__
+
+#include <bao.h>
+#include <list.h>
+#include <spinlock.h>
+#include <bitmap.h>
+
+struct ppages {
+    paddr_t base;
+    size_t num_pages;
+    colormap_t colors;
+};
+
+/**
+ * The bitmap is the authoritative record of allocated pages. It is summarized by a buddy tree with
+ * one leaf per bitmap granule where each node holds the order plus one of the largest free block
+ * naturally aligned within its span (zero if none). It lives right after the bitmap in the pool's
+ * metadata pages and must be kept in sync through pp_mark_alloc/pp_mark_free.
+ */
+struct page_pool {
+    node_t node;
+    paddr_t base;
+    size_t size;
+    size_t free;
+    size_t last;
+    bitmap_t* bitmap;
+    uint8_t* buddy;
+    size_t buddy_leaves;
+    spinlock_t lock;
+};
+
+bool pp_alloc(struct page_pool* pool, size_t num_pages, bool aligned, struct ppages* ppages);
+size_t pp_meta_num_pages(size_t pool_num_pages);
+void pp_buddy_init(struct page_pool* pool);
+void pp_mark_alloc(struct page_pool* pool, size_t index, size_t num_pages);
+void pp_mark_free(struct page_pool* pool, size_t index, size_t num_pages);
+size_t pp_next_free(struct page_pool* pool, size_t index);
+
+#endif /* __PAGE_POOL_H__ */
@@ -23,6 +23,8 @@ struct platform {
 
     struct {
         paddr_t base;
+        /* Optional receive interrupt, enables the stats hotkey. Zero if not available. */
+        irqid_t irq;
     } console;
 
     struct cache cache;
@@ -0,0 +1,105 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <bao.h>
+
+/**
+ * Per-vcpu exit statistics, built only with STATS=y. Each exit class keeps an event count, the
+ * total time spent handling it and a log2 histogram of the per-event latency, all measured in
+ * timer ticks (CNTPCT on armv8, the time CSR on riscv). Nested events (e.g. a hypercall inside an
+ * HVC exit) are accounted in both classes.
+ */
+
+/**
+ * Cpu message handler ids are only assigned at link time. The linker script checks the image does
+ * not register more handlers than there are cpu message classes.
+ */
+#define STATS_CPUMSG_NUM (8)
+
+#ifndef __ASSEMBLER__
+
+#include <arch/stats.h>
+#include <cache.h>
+
+#define STATS_HIST_BUCKETS (24)
+#define STATS_HC_NUM       (4)
+
+#define STATS_EXIT(code)   ((size_t)(code))
+#define STATS_IRQ_FWD      (STATS_ARCH_EXIT_NUM)
+#define STATS_IRQ_HYP      (STATS_IRQ_FWD + 1)
+#define STATS_CPUMSG(id)   (STATS_IRQ_HYP + 1 + (size_t)(id))
+#define STATS_HC(id)       (STATS_CPUMSG(STATS_CPUMSG_NUM) + (size_t)(id))
+#define STATS_CLASS_NUM    (STATS_HC(STATS_HC_NUM))
+
+/* Fields of a class as addressed by the HC_STATS hypercall */
+#define STATS_FIELD_COUNT  (0)
+#define STATS_FIELD_TICKS  (1)
+#define STATS_FIELD_HIST   (2)
+#define STATS_FIELD_NUM    (STATS_FIELD_HIST + STATS_HIST_BUCKETS)
+
+/* Ctrl-T, as in BSD's status key, dumps the statistics when typed on the hypervisor console */
+#ifndef STATS_HOTKEY
+#define STATS_HOTKEY ('\x14')
+#endif
+
+struct stats_entry {
+    uint64_t count;
+    uint64_t ticks;
+    uint32_t hist[STATS_HIST_BUCKETS];
+};
+
+/**
+ * Only the physical cpu running the vcpu updates its statistics. They live in their own cache
+ * lines so that remote readers (i.e., the HC_STATS hypercall) do not contend with the hot fields
+ * of struct vcpu.
+ */
+struct vcpu_stats {
+    struct stats_entry entries[STATS_CLASS_NUM];
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct vcpu;
+
+#ifdef STATS
+
+static inline uint64_t stats_start(void)
+{
+    return stats_arch_timestamp();
+}
+
+void stats_init();
+void stats_reset(struct vcpu* vcpu);
+void stats_record(struct vcpu* vcpu, size_t class, uint64_t start);
+void stats_dump(struct vcpu* vcpu);
+long int stats_hypercall(unsigned long vcpu_id, unsigned long class, unsigned long field);
+
+#else
+
+static inline uint64_t stats_start(void)
+{
+    return 0;
+}
+
+static inline void stats_init() { }
+
+static inline void stats_reset(struct vcpu* vcpu)
+{
+    (void)vcpu;
+}
+
+static inline void stats_record(struct vcpu* vcpu, size_t class, uint64_t start)
+{
+    (void)vcpu;
+    (void)class;
+    (void)start;
+}
+
+#endif /* STATS */
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* __STATS_H__ */
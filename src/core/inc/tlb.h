@@ -10,6 +10,7 @@
 #include <arch/tlb.h>
 
 #include <mem.h>
+#include <io.h>
 
 static inline void tlb_inv_va(struct addr_space* as, vaddr_t va)
 {
@@ -17,7 +18,7 @@ static inline void tlb_inv_va(struct addr_space* as, vaddr_t va)
         tlb_hyp_inv_va(va);
     } else if (as->type == AS_VM) {
         tlb_vm_inv_va(as->id, va);
-        // TODO: inval iommu tlbs
+        iommu_arch_vm_inv_range(as->id, va, PAGE_SIZE);
     }
 }
 
@@ -27,7 +28,17 @@ static inline void tlb_inv_all(struct addr_space* as)
         tlb_hyp_inv_all();
     } else if (as->type == AS_VM) {
         tlb_vm_inv_all(as->id);
-        // TODO: inval iommu tlbs
+        iommu_arch_vm_inv_all(as->id);
+    }
+}
+
+static inline void tlb_inv_range(struct addr_space* as, vaddr_t va, size_t size)
+{
+    if (as->type == AS_HYP) {
+        tlb_hyp_inv_range(va, size);
+    } else if (as->type == AS_VM) {
+        tlb_vm_inv_range(as->id, va, size);
+        iommu_arch_vm_inv_range(as->id, va, size);
     }
 }
 
@@ -17,6 +17,7 @@
 #include <bitmap.h>
 #include <io.h>
 #include <ipc.h>
+#include <stats.h>
 
 struct vm_mem_region {
     paddr_t base;
@@ -58,6 +59,9 @@ struct vm_platform {
     struct arch_vm_platform arch;
 };
 
+#define VM_EMUL_MEM_NUM_MAX (8)
+#define VM_EMUL_REG_NUM_MAX (8)
+
 struct vm {
     vmid_t id;
 
@@ -75,8 +79,14 @@ struct vm {
 
     struct vm_arch arch;
 
-    struct list emul_mem_list;
-    struct list emul_reg_list;
+    /**
+     * Emulation regions are registered during vm initialization and kept sorted by address so
+     * that trapped accesses are dispatched with a binary search.
+     */
+    size_t emul_mem_num;
+    struct emul_mem* emul_mem[VM_EMUL_MEM_NUM_MAX];
+    size_t emul_reg_num;
+    struct emul_reg* emul_reg[VM_EMUL_REG_NUM_MAX];
 
     struct vm_io io;
 
@@ -97,6 +107,13 @@ struct vcpu {
     bool active;
 
     struct vm* vm;
+
+    /* Last emulation region hit by this vcpu, checked before searching the vm's region index */
+    struct emul_mem* emul_mem_hit;
+
+#ifdef STATS
+    struct vcpu_stats stats;
+#endif
 };
 
 struct vm_allocation {
@@ -7,6 +7,7 @@
 
 #include <cpu.h>
 #include <vm.h>
+#include <stats.h>
 #include <bitmap.h>
 #include <string.h>
 
@@ -21,6 +22,11 @@ inline void interrupts_cpu_sendipi(cpuid_t target_cpu, irqid_t ipi_id)
     interrupts_arch_ipi_send(target_cpu, ipi_id);
 }
 
+inline void interrupts_cpu_sendipi_mask(cpumap_t target_cpus, irqid_t ipi_id)
+{
+    interrupts_arch_ipi_send_mask(target_cpus, ipi_id);
+}
+
 inline void interrupts_cpu_enable(irqid_t int_id, bool en)
 {
     interrupts_arch_enable(int_id, en);
@@ -69,14 +75,18 @@ static inline bool interrupt_assigned(irqid_t int_id)
 
 enum irq_res interrupts_handle(irqid_t int_id)
 {
+    uint64_t start = stats_start();
+
     if (vm_has_interrupt(cpu()->vcpu->vm, int_id)) {
         vcpu_inject_hw_irq(cpu()->vcpu, int_id);
 
+        stats_record(cpu()->vcpu, STATS_IRQ_FWD, start);
         return FORWARD_TO_VM;
 
     } else if (interrupt_assigned_to_hyp(int_id)) {
         interrupt_handlers[int_id](int_id);
 
+        stats_record(cpu()->vcpu, STATS_IRQ_HYP, start);
         return HANDLED_BY_HYP;
 
     } else {
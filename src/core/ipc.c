@@ -86,11 +86,7 @@ unsigned long ipc_hypercall(unsigned long ipc_id, unsigned long ipc_event, unsig
         };
         struct cpu_msg msg = { IPC_CPUMSG_ID, IPC_NOTIFY, data.raw };
 
-        for (size_t i = 0; i < platform.cpu_num; i++) {
-            if (ipc_cpu_masters & (1ULL << i)) {
-                cpu_send_msg(i, &msg);
-            }
-        }
+        cpu_send_msg_mask(ipc_cpu_masters, &msg);
 
     } else {
         ret = -HC_E_INVAL_ARGS;
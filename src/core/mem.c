@@ -18,70 +18,6 @@ extern uint8_t _image_start, _image_load_end, _image_end, _vm_image_start, _vm_i
 
 struct list page_pool_list;
 
-bool pp_alloc(struct page_pool* pool, size_t num_pages, bool aligned, struct ppages* ppages)
-{
-    ppages->colors = 0;
-    ppages->num_pages = 0;
-
-    bool ok = false;
-
-    if (num_pages == 0) {
-        return true;
-    }
-
-    spin_lock(&pool->lock);
-
-    /**
-     * If we need a contigous segment aligned to its size, lets start at an already aligned index.
-     */
-    size_t start = aligned ? pool->base / PAGE_SIZE % num_pages : 0;
-    size_t curr = pool->last + ((pool->last + start) % num_pages);
-
-    /**
-     * Lets make two searches:
-     *  - one starting from the last known free index.
-     *  - in case this does not work, start from index 0.
-     */
-    for (size_t i = 0; i < 2 && !ok; i++) {
-        while (pool->free != 0) {
-            ssize_t bit = bitmap_find_consec(pool->bitmap, pool->size, curr, num_pages, false);
-
-            if (bit < 0) {
-                /**
-                 * No num_page page sement was found. If this is the first iteration set position
-                 * to 0 to start next search from index
-                 * 0.
-                 */
-                size_t next_aligned =
-                    (num_pages - ((pool->base / PAGE_SIZE) % num_pages)) % num_pages;
-                curr = aligned ? next_aligned : 0;
-                break;
-            } else if (aligned && (((bit + start) % num_pages) != 0)) {
-                /**
-                 * If we're looking for an aligned segment and the found contigous segment is not
-                 * aligned, start the search again from the last aligned index
-                 */
-                curr = bit + ((bit + start) % num_pages);
-            } else {
-                /**
-                 * We've found our pages. Fill output argument info, mark them as allocated, and
-                 * update page pool bookkeeping.
-                 */
-                ppages->base = pool->base + (bit * PAGE_SIZE);
-                ppages->num_pages = num_pages;
-                bitmap_set_consecutive(pool->bitmap, bit, num_pages);
-                pool->free -= num_pages;
-                pool->last = bit + num_pages;
-                ok = true;
-                break;
-            }
-        }
-    }
-    spin_unlock(&pool->lock);
-
-    return ok;
-}
-
 bool mem_are_ppages_reserved_in_pool(struct page_pool* ppool, struct ppages* ppages)
 {
     bool reserved = false;
@@ -134,7 +70,7 @@ bool mem_reserve_ppool_ppages(struct page_pool* pool, struct ppages* ppages)
         was_free = false;
     }
 
-    bitmap_set_consecutive(pool->bitmap, pageoff, ppages->num_pages);
+    pp_mark_alloc(pool, pageoff, ppages->num_pages);
     pool->free -= ppages->num_pages;
 
     return is_in_rgn && was_free;
@@ -158,8 +94,7 @@ bool root_pool_set_up_bitmap(paddr_t load_addr, struct page_pool* root_pool)
     size_t vm_image_size = (size_t)(&_vm_image_end - &_vm_image_start);
     size_t cpu_size = platform.cpu_num * mem_cpu_boot_alloc_size();
 
-    size_t bitmap_num_pages =
-        root_pool->size / (8 * PAGE_SIZE) + ((root_pool->size % (8 * PAGE_SIZE) != 0) ? 1 : 0);
+    size_t bitmap_num_pages = pp_meta_num_pages(root_pool->size);
     if (root_pool->size <= bitmap_num_pages) {
         return false;
     }
@@ -170,6 +105,7 @@ bool root_pool_set_up_bitmap(paddr_t load_addr, struct page_pool* root_pool)
         INVALID_VA, bitmap_num_pages, PTE_HYP_FLAGS);
     root_pool->bitmap = root_bitmap;
     memset((void*)root_pool->bitmap, 0, bitmap_num_pages * PAGE_SIZE);
+    pp_buddy_init(root_pool);
 
     return mem_reserve_ppool_ppages(root_pool, &bitmap_pp);
 }
@@ -225,7 +161,7 @@ static void pp_init(struct page_pool* pool, paddr_t base, size_t size)
     memset((void*)pool, 0, sizeof(struct page_pool));
     pool->base = ALIGN(base, PAGE_SIZE);
     pool->size = NUM_PAGES(size);
-    size_t bitmap_size = pool->size / (8 * PAGE_SIZE) + !!(pool->size % (8 * PAGE_SIZE) != 0);
+    size_t bitmap_size = pp_meta_num_pages(pool->size);
 
     if (size <= bitmap_size) {
         return;
@@ -242,6 +178,7 @@ static void pp_init(struct page_pool* pool, paddr_t base, size_t size)
     }
 
     memset((void*)pool->bitmap, 0, bitmap_size * PAGE_SIZE);
+    pp_buddy_init(pool);
 
     pool->last = 0;
     pool->free = pool->size;
@@ -20,5 +20,7 @@ struct io_prot {
 bool iommu_arch_init();
 bool iommu_arch_vm_init(struct vm* vm, const struct vm_config* config);
 bool iommu_arch_vm_add_device(struct vm* vm, deviceid_t id);
+void iommu_arch_vm_inv_range(asid_t vm_id, vaddr_t va, size_t size);
+void iommu_arch_vm_inv_all(asid_t vm_id);
 
 #endif /* MEM_PROT_IO_H */
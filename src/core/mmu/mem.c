@@ -74,20 +74,29 @@ static inline size_t pp_next_clr(paddr_t base, size_t from, colormap_t colors)
     return index;
 }
 
+/**
+ * Uncolored ppages may be gathered from several mappings (see mem_unmap), so they are allowed to
+ * span adjacent pools and each pool frees the part it holds.
+ */
 static void mem_free_ppages(struct ppages* ppages)
 {
+    paddr_t top = ppages->base + (ppages->num_pages * PAGE_SIZE);
+
     list_foreach (page_pool_list, struct page_pool, pool) {
+        paddr_t pool_top = pool->base + (pool->size * PAGE_SIZE);
         spin_lock(&pool->lock);
-        if (in_range(ppages->base, pool->base, pool->size * PAGE_SIZE)) {
-            size_t index = (ppages->base - pool->base) / PAGE_SIZE;
-            if (!all_clrs(ppages->colors)) {
+        if (!all_clrs(ppages->colors)) {
+            if (in_range(ppages->base, pool->base, pool->size * PAGE_SIZE)) {
+                size_t index = (ppages->base - pool->base) / PAGE_SIZE;
                 for (size_t i = 0; i < ppages->num_pages; i++) {
                     index = pp_next_clr(pool->base, index, ppages->colors);
-                    bitmap_clear(pool->bitmap, index++);
+                    pp_mark_free(pool, index++, 1);
                 }
-            } else {
-                bitmap_clear_consecutive(pool->bitmap, index, ppages->num_pages);
             }
+        } else if ((ppages->base < pool_top) && (top > pool->base)) {
+            paddr_t base = max(ppages->base, pool->base);
+            size_t index = (base - pool->base) / PAGE_SIZE;
+            pp_mark_free(pool, index, (min(top, pool_top) - base) / PAGE_SIZE);
         }
         spin_unlock(&pool->lock);
     }
@@ -120,9 +129,12 @@ bool pp_alloc_clr(struct page_pool* pool, size_t n, colormap_t colors, struct pp
         while ((allocated < n) && (index < top)) {
             allocated = 0;
 
-            /* Find first free page on the target colors */
+            /**
+             * Find first free page on the target colors. Allocated spans are skipped at once
+             * through the pool's buddy tree.
+             */
             while ((index < top) && bitmap_get(pool->bitmap, index)) {
-                index = pp_next_clr(pool->base, ++index, colors);
+                index = pp_next_clr(pool->base, pp_next_free(pool, index + 1), colors);
             }
             first_index = index;
 
@@ -147,7 +159,7 @@ bool pp_alloc_clr(struct page_pool* pool, size_t n, colormap_t colors, struct pp
             ppages->base = pool->base + (first_index * PAGE_SIZE);
             for (size_t i = 0; i < n; i++) {
                 first_index = pp_next_clr(pool->base, first_index, colors);
-                bitmap_set(pool->bitmap, first_index++);
+                pp_mark_alloc(pool, first_index++, 1);
             }
             pool->free -= n;
             pool->last = first_index;
@@ -250,7 +262,7 @@ static void mem_expand_pte(struct addr_space* as, vaddr_t va, size_t lvl)
              * Therefore this function cannot be call on the entry mapping hypervisor code or data
              * used in it (including stack).
              */
-            tlb_inv_va(&cpu()->as, va);
+            tlb_inv_va(as, va);
 
             /**
              *  Now traverse the new next level page table to replicate the original mapping.
@@ -262,7 +274,7 @@ static void mem_expand_pte(struct addr_space* as, vaddr_t va, size_t lvl)
             size_t nentries = pt_nentries(&as->pt, lvl);
             size_t lvlsz = pt_lvlsize(&as->pt, lvl);
             pte_type_t type = pt_page_type(&as->pt, lvl);
-            pte_flags_t flags = (as->type == AS_HYP ? PTE_HYP_FLAGS : PTE_VM_FLAGS);
+            pte_flags_t flags = pte_flags(&pte_val);
 
             while (entry < nentries) {
                 if (vld) {
@@ -298,6 +310,180 @@ static void mem_inflate_pt(struct addr_space* as, vaddr_t va, size_t length)
     }
 }
 
+static struct ppages mem_alloc_ppages_blk(struct addr_space* as, vaddr_t va, size_t num_pages)
+{
+    struct ppages ppages = { .num_pages = 0 };
+    size_t blk_size = PAGE_SIZE;
+
+    for (size_t lvl = 0; lvl < as->pt.dscr->lvls; lvl++) {
+        size_t lvlsz = pt_lvlsize(&as->pt, lvl);
+        if (pt_lvl_terminal(&as->pt, lvl) && (lvlsz <= (num_pages * PAGE_SIZE))) {
+            blk_size = lvlsz;
+            break;
+        }
+    }
+
+    if (blk_size == PAGE_SIZE) {
+        return ppages;
+    }
+
+    /**
+     * Plan the whole region as a single contiguous chunk whose physical address has the same
+     * offset as va inside the largest block fitting the region, so every block-aligned part of
+     * the region can be mapped by a block entry. Over-allocate by up to one block to find such an
+     * address and give the slack on both ends back to the pool.
+     */
+    size_t blk_pages = blk_size / PAGE_SIZE;
+    struct ppages chunk = mem_alloc_ppages(as->colors, num_pages + blk_pages - 1, false);
+    if (chunk.num_pages == 0) {
+        return ppages;
+    }
+
+    size_t skew = ((va % blk_size) + blk_size - (chunk.base % blk_size)) % blk_size;
+    ppages = mem_ppages_get(chunk.base + skew, num_pages);
+
+    struct ppages head = mem_ppages_get(chunk.base, skew / PAGE_SIZE);
+    struct ppages tail = mem_ppages_get(ppages.base + (num_pages * PAGE_SIZE),
+        chunk.num_pages - head.num_pages - num_pages);
+    if (head.num_pages > 0) {
+        mem_free_ppages(&head);
+    }
+    if (tail.num_pages > 0) {
+        mem_free_ppages(&tail);
+    }
+
+    return ppages;
+}
+
+static bool mem_coalesce_pte(struct addr_space* as, vaddr_t va, size_t lvl)
+{
+    /* Must have lock on as and va section to call */
+
+    pte_t* pte = NULL;
+    for (size_t i = 0; i <= lvl; i++) {
+        pte = pt_get_pte(&as->pt, i, va);
+        if ((pte == NULL) || !pte_valid(pte) || !pte_table(&as->pt, pte, i)) {
+            return false;
+        }
+    }
+
+    if (!pt_lvl_terminal(&as->pt, lvl)) {
+        return false;
+    }
+
+    /**
+     * The next level table can only be folded into a block if all its entries are leaves with the
+     * same attributes mapping a physically contiguous range aligned to the block size.
+     */
+    size_t lvlsz = pt_lvlsize(&as->pt, lvl);
+    size_t sublvlsz = pt_lvlsize(&as->pt, lvl + 1);
+    size_t nentries = pt_nentries(&as->pt, lvl + 1);
+    pte_t* pt = pt_get(&as->pt, lvl + 1, va);
+    paddr_t paddr = pte_addr(&pt[0]);
+
+    if ((paddr % lvlsz) != 0) {
+        return false;
+    }
+
+    for (size_t i = 0; i < nentries; i++) {
+        if (!pte_valid(&pt[i]) || pte_table(&as->pt, &pt[i], lvl + 1) ||
+            (pte_addr(&pt[i]) != (paddr + (i * sublvlsz))) ||
+            ((pt[i] & PTE_FLAGS_MSK) != (pt[0] & PTE_FLAGS_MSK))) {
+            return false;
+        }
+    }
+
+    pte_flags_t flags = pte_flags(&pt[0]);
+    struct ppages pt_ppages =
+        mem_ppages_get(pte_addr(pte), NUM_PAGES(pt_size(&as->pt, lvl + 1)));
+
+    /**
+     * Break-before-make: the table entry is invalidated and all translations cached from the old
+     * table, including the hypervisor's own view of the table itself, are flushed before the block
+     * entry is written.
+     */
+    *pte = PTE_INVALID;
+    fence_sync_write();
+    tlb_inv_all(as);
+    tlb_inv_va(&cpu()->as, (vaddr_t)pt);
+
+    pte_set(pte, paddr, pt_page_type(&as->pt, lvl), flags);
+    fence_sync_write();
+
+    mem_free_ppages(&pt_ppages);
+
+    return true;
+}
+
+static void mem_coalesce(struct addr_space* as, vaddr_t va, size_t num_pages)
+{
+    /* Must have lock on as and va section to call */
+
+    /**
+     * Go bottom-up so that runs folded into blocks at one level may in turn complete a block of
+     * the level above.
+     */
+    vaddr_t top = va + (num_pages * PAGE_SIZE);
+    for (size_t lvl = as->pt.dscr->lvls - 1; lvl-- > 0;) {
+        size_t lvlsz = pt_lvlsize(&as->pt, lvl);
+        for (vaddr_t vaddr = va & ~(lvlsz - 1); vaddr < top; vaddr += lvlsz) {
+            mem_coalesce_pte(as, vaddr, lvl);
+        }
+    }
+}
+
+static bool mem_pt_empty(struct addr_space* as, pte_t* pt, size_t lvl)
+{
+    for (size_t i = 0; i < pt_nentries(&as->pt, lvl); i++) {
+        if (pte_valid(&pt[i]) || pte_check_rsw(&pt[i], PTE_RSW_RSRV)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool mem_reclaim_pt(struct addr_space* as, struct section* sec, vaddr_t va, size_t lvl)
+{
+    /* Must have lock on as and va section to call */
+
+    /**
+     * The tables pointed to by the root entries of shared sections are referenced by every cpu's
+     * root table, so these are never freed.
+     */
+    size_t min_lvl = sec->shared ? (PT_SHARED_LVL + 1) : 0;
+    bool reclaimed = false;
+
+    while (lvl > min_lvl) {
+        pte_t* pt = pt_get(&as->pt, lvl, va);
+        if (!mem_pt_empty(as, pt, lvl)) {
+            break;
+        }
+
+        pte_t* pte = pt_get_pte(&as->pt, lvl - 1, va);
+        struct ppages pt_ppages = mem_ppages_get(pte_addr(pte), NUM_PAGES(pt_size(&as->pt, lvl)));
+
+        /**
+         * Drop the table entry and flush any walk cached through it before the table is returned
+         * to the pool. The hypervisor view of the table itself is flushed as well.
+         */
+        *pte = PTE_INVALID;
+        fence_sync_write();
+        if (as->type == AS_VM) {
+            tlb_inv_all(as);
+        } else {
+            tlb_inv_va(as, va);
+        }
+        tlb_inv_va(&cpu()->as, (vaddr_t)pt);
+
+        mem_free_ppages(&pt_ppages);
+
+        reclaimed = true;
+        lvl--;
+    }
+
+    return reclaimed;
+}
+
 vaddr_t mem_alloc_vpage(struct addr_space* as, enum AS_SEC section, vaddr_t at, size_t n)
 {
     size_t lvl = 0;
@@ -411,11 +597,26 @@ vaddr_t mem_alloc_vpage(struct addr_space* as, enum AS_SEC section, vaddr_t at,
     return vpage;
 }
 
+/**
+ * Unmapped pages may still be reachable through stale TLB entries, so they can only go back to the
+ * pool once the range they were mapped at is invalidated.
+ */
+static void mem_unmap_inv_free(struct addr_space* as, vaddr_t at, vaddr_t top,
+    struct ppages* ppages)
+{
+    tlb_inv_range(as, at, top - at);
+    if (ppages->num_pages > 0) {
+        mem_free_ppages(ppages);
+        ppages->num_pages = 0;
+    }
+}
+
 void mem_unmap(struct addr_space* as, vaddr_t at, size_t num_pages, bool free_ppages)
 {
     vaddr_t vaddr = at;
     vaddr_t top = at + (num_pages * PAGE_SIZE);
     size_t lvl = 0;
+    struct ppages unmapped = mem_ppages_get(0, 0);
 
     spin_lock(&as->lock);
 
@@ -431,12 +632,18 @@ void mem_unmap(struct addr_space* as, vaddr_t at, size_t num_pages, bool free_pp
         } else if (!pte_valid(pte)) {
             size_t lvlsz = pt_lvlsize(&as->pt, lvl);
             vaddr += lvlsz;
+            if ((lvl > 0) && ((vaddr % pt_lvlsize(&as->pt, lvl - 1)) == 0)) {
+                /* left the current table, the next one at this level might not exist */
+                lvl = 0;
+            }
         } else if (pte_table(&as->pt, pte, lvl)) {
             lvl++;
         } else {
             size_t entry = pt_getpteindex(&as->pt, pte, lvl);
             size_t nentries = pt_nentries(&as->pt, lvl);
             size_t lvlsz = pt_lvlsize(&as->pt, lvl);
+            size_t first_entry = entry;
+            bool expanded = false;
 
             while ((entry < nentries) && (vaddr < top)) {
                 if (!pte_table(&as->pt, pte, lvl)) {
@@ -444,18 +651,28 @@ void mem_unmap(struct addr_space* as, vaddr_t at, size_t num_pages, bool free_pp
 
                     if (vaddr > vpage_base || top < (vpage_base + lvlsz)) {
                         mem_expand_pte(as, vaddr, lvl);
+                        expanded = true;
                         lvl++;
                         break;
                     }
 
+                    /**
+                     * Physically contiguous pages are gathered to be freed after the batched
+                     * invalidation. A discontiguity invalidates what was unmapped so far early.
+                     */
                     if (free_ppages) {
                         paddr_t paddr = pte_addr(pte);
-                        struct ppages ppages = mem_ppages_get(paddr, lvlsz / PAGE_SIZE);
-                        mem_free_ppages(&ppages);
+                        if ((unmapped.num_pages > 0) &&
+                            (paddr != unmapped.base + (unmapped.num_pages * PAGE_SIZE))) {
+                            mem_unmap_inv_free(as, at, vaddr, &unmapped);
+                        }
+                        if (unmapped.num_pages == 0) {
+                            unmapped.base = paddr;
+                        }
+                        unmapped.num_pages += lvlsz / PAGE_SIZE;
                     }
 
                     *pte = 0;
-                    tlb_inv_va(&cpu()->as, vaddr);
 
                 } else {
                     break;
@@ -465,16 +682,26 @@ void mem_unmap(struct addr_space* as, vaddr_t at, size_t num_pages, bool free_pp
                 vaddr += lvlsz;
             }
 
-            if (entry == nentries) {
-                lvl--;
-            }
-
             /**
-             * TODO: check if the current pt is now empty and if so, free it too up to the root.
+             * If the current table is now empty, free it and go up towards the root freeing any
+             * parent table left empty. The walk must then restart from the root as the tables it
+             * was going through might be gone.
              */
+            if (!expanded && (entry > first_entry) &&
+                mem_reclaim_pt(as, sec, vaddr - lvlsz, lvl)) {
+                lvl = 0;
+            } else if (entry == nentries) {
+                lvl--;
+            }
         }
     }
 
+    /**
+     * Invalidate the whole range at once instead of issuing a maintenance operation and barriers
+     * for each entry.
+     */
+    mem_unmap_inv_free(as, at, top, &unmapped);
+
     if (sec->shared) {
         spin_unlock(&sec->lock);
     }
@@ -511,6 +738,11 @@ bool mem_map(struct addr_space* as, vaddr_t va, struct ppages* ppages, size_t nu
             ERROR("failed to alloc colored physical pages");
         }
         ppages = &temp_ppages;
+    } else if (ppages == NULL && as->type == AS_VM) {
+        temp_ppages = mem_alloc_ppages_blk(as, vaddr, num_pages);
+        if (temp_ppages.num_pages == num_pages) {
+            ppages = &temp_ppages;
+        }
     }
 
     if (ppages && !all_clrs(ppages->colors)) {
@@ -574,6 +806,10 @@ bool mem_map(struct addr_space* as, vaddr_t va, struct ppages* ppages, size_t nu
         }
     }
 
+    if (as->type == AS_VM && (ppages == NULL || all_clrs(ppages->colors))) {
+        mem_coalesce(as, va & ~(PAGE_SIZE - 1), num_pages);
+    }
+
     fence_sync();
 
     if (sec->shared) {
@@ -695,12 +931,13 @@ vaddr_t mem_map_cpy(struct addr_space* ass, struct addr_space* asd, vaddr_t vas,
             pte = pt_get_pte(&ass->pt, lvl, vas);
         }
         size_t lvl_size = pt_lvlsize(&ass->pt, lvl);
-        size_t size = lvl_size;
-        if (to_map < lvl_size) {
+        size_t lvl_offset = vas - ALIGN_FLOOR(vas, lvl_size);
+        size_t size = lvl_size - lvl_offset;
+        if (to_map < size) {
             size = to_map;
         }
         size_t npages = NUM_PAGES(size);
-        paddr_t pa = pte_addr(pte) + (vas - ALIGN_FLOOR(vas, lvl_size));
+        paddr_t pa = pte_addr(pte) + lvl_offset;
         struct ppages pages = mem_ppages_get(pa, npages);
         mem_map(asd, _vad, &pages, npages, PTE_HYP_FLAGS);
         _vad += size;
@@ -749,9 +986,7 @@ void mem_color_hypervisor(const paddr_t load_addr, struct mem_region* root_regio
     size_t vm_image_size = (size_t)(&_vm_image_end - &_vm_image_start);
     size_t cpu_boot_size = mem_cpu_boot_alloc_size();
     struct page_pool* root_pool = &root_region->page_pool;
-    size_t bitmap_size =
-        (root_pool->size / (8 * PAGE_SIZE) + !!(root_pool->size % (8 * PAGE_SIZE) != 0)) *
-        PAGE_SIZE;
+    size_t bitmap_size = pp_meta_num_pages(root_pool->size) * PAGE_SIZE;
     colormap_t colors = config.hyp.colors;
 
     /* Set hypervisor colors in current address space */
@@ -791,7 +1026,8 @@ void mem_color_hypervisor(const paddr_t load_addr, struct mem_region* root_regio
     mem_map(&cpu_new->as, v_root_pt_addr, &p_root_pt_pages, root_pt_num_pages, PTE_HYP_FLAGS);
 
     /*
-     * Copy the Hypervisor image and root page pool bitmap into a colored region.
+     * Copy the Hypervisor image and root page pool bitmap (and its buddy tree, which directly
+     * follows it) into a colored region.
      *
      * CPU_MASTER allocates, copies and maps the image and the root page pool bitmap on a shared
      * space, whilst other CPUs only have to copy the image from the CPU_MASTER in order to be able
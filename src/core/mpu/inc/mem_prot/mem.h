@@ -29,6 +29,18 @@ struct addr_space {
         enum { MPE_S_FREE, MPE_S_INVALID, MPE_S_VALID } state;
         struct mp_region region;
     } vmpu[VMPU_NUM_ENTRIES];
+    /**
+     * The valid vmpu entries sorted by base address. Their bounds are mirrored here so address and
+     * overlap lookups are binary searches over a compact array.
+     */
+    struct {
+        size_t num;
+        struct vmpu_order_entry {
+            vaddr_t base;
+            vaddr_t limit;
+            mpid_t mpid;
+        } entries[VMPU_NUM_ENTRIES];
+    } vmpu_order;
     spinlock_t lock;
 };
 
@@ -36,7 +48,7 @@ void as_init(struct addr_space* as, enum AS_TYPE type, asid_t id, colormap_t col
 
 static inline bool mem_regions_overlap(struct mp_region* reg1, struct mp_region* reg2)
 {
-    return range_in_range(reg1->base, reg1->size, reg2->base, reg2->size);
+    return range_overlap_range(reg1->base, reg1->size, reg2->base, reg2->size);
 }
 
 /**
@@ -44,10 +56,15 @@ static inline bool mem_regions_overlap(struct mp_region* reg1, struct mp_region*
  * MPU layer is minimal. Besides initialization:
  * i) It must provide the view of a separate physical MPU for each privilege;
  * ii) It must allow the mapping and unmapping of regions on these MPUs,returning a binary return
- * success value.
+ * success value;
+ * iii) It may evict guest regions when it runs out of entries, as long as mpu_refill maps them
+ * back, i.e., it maps the part of the region around the faulting addr that is missing.
  */
 void mpu_init();
 bool mpu_map(priv_t priv, struct mp_region* mem);
 bool mpu_unmap(priv_t priv, struct mp_region* mem);
+bool mpu_refill(priv_t priv, struct mp_region* mem, vaddr_t addr);
+
+bool mem_vmpu_refill(struct addr_space* as, vaddr_t addr);
 
 #endif /* __MEM_PROT_H__ */
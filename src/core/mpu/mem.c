@@ -29,7 +29,7 @@ enum { MEM_INSERT_REGION, MEM_REMOVE_REGION };
 #ifndef SHARED_REGION_POOL_SIZE
 #define SHARED_REGION_POOL_SIZE SHARED_REGION_POOL_SIZE_DEFAULT
 #endif
-OBJPOOL_ALLOC(shared_region_pool, struct shared_region, SHARED_REGION_POOL_SIZE);
+OBJPOOL_ALLOC_CACHED(shared_region_pool, struct shared_region, SHARED_REGION_POOL_SIZE);
 
 static inline struct mpe* mem_vmpu_get_entry(struct addr_space* as, mpid_t mpid)
 {
@@ -39,10 +39,72 @@ static inline struct mpe* mem_vmpu_get_entry(struct addr_space* as, mpid_t mpid)
     return NULL;
 }
 
+/**
+ * Find the first valid vmpu entry whose limit is above addr, i.e., the first entry that either
+ * contains addr or lies after it. Valid entries do not overlap, so their limits are sorted just like
+ * their bases.
+ */
+static size_t mem_vmpu_order_search(struct addr_space* as, vaddr_t addr)
+{
+    struct vmpu_order_entry* entries = as->vmpu_order.entries;
+    size_t low = 0;
+    size_t high = as->vmpu_order.num;
+
+    while (low < high) {
+        size_t mid = low + ((high - low) / 2);
+        if (entries[mid].limit <= addr) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+static void mem_vmpu_order_insert(struct addr_space* as, mpid_t mpid, struct mp_region* mpr)
+{
+    struct vmpu_order_entry* entries = as->vmpu_order.entries;
+    size_t num = as->vmpu_order.num;
+    size_t i = mem_vmpu_order_search(as, mpr->base);
+
+    for (size_t j = num; j > i; j--) {
+        entries[j] = entries[j - 1];
+    }
+    entries[i] = (struct vmpu_order_entry){
+        .base = mpr->base,
+        .limit = mpr->base + mpr->size,
+        .mpid = mpid,
+    };
+    as->vmpu_order.num = num + 1;
+}
+
+static void mem_vmpu_order_remove(struct addr_space* as, mpid_t mpid)
+{
+    struct vmpu_order_entry* entries = as->vmpu_order.entries;
+    size_t num = as->vmpu_order.num;
+
+    // Removing an entry shifts the rest of the array anyway, so we simply look it up by mpid
+    for (size_t i = 0; i < num; i++) {
+        if (entries[i].mpid == mpid) {
+            for (size_t j = i; j < (num - 1); j++) {
+                entries[j] = entries[j + 1];
+            }
+            as->vmpu_order.num = num - 1;
+            break;
+        }
+    }
+}
+
 void mem_vmpu_set_entry(struct addr_space* as, mpid_t mpid, struct mp_region* mpr)
 {
     struct mpe* mpe = mem_vmpu_get_entry(as, mpid);
 
+    if (mpe->state == MPE_S_VALID) {
+        mem_vmpu_order_remove(as, mpid);
+    }
+    mem_vmpu_order_insert(as, mpid, mpr);
+
     mpe->region.base = mpr->base;
     mpe->region.size = mpr->size;
     mpe->region.mem_flags = mpr->mem_flags;
@@ -54,6 +116,10 @@ void mem_vmpu_clear_entry(struct addr_space* as, mpid_t mpid)
 {
     struct mpe* mpe = mem_vmpu_get_entry(as, mpid);
 
+    if (mpe->state == MPE_S_VALID) {
+        mem_vmpu_order_remove(as, mpid);
+    }
+
     mpe->region.base = 0;
     mpe->region.size = 0;
     mpe->region.mem_flags = PTE_INVALID;
@@ -87,19 +153,10 @@ mpid_t mem_vmpu_allocate_entry(struct addr_space* as)
 mpid_t mem_vmpu_get_entry_by_addr(struct addr_space* as, vaddr_t addr)
 {
     mpid_t mpid = INVALID_MPID;
+    size_t i = mem_vmpu_order_search(as, addr);
 
-    for (mpid_t i = 0; i < VMPU_NUM_ENTRIES; i++) {
-        struct mpe* mpe = mem_vmpu_get_entry(as, i);
-
-        if (mpe->state != MPE_S_VALID) {
-            continue;
-        }
-
-        vaddr_t limit_addr = mpe->region.base + mpe->region.size;
-        if ((addr >= mpe->region.base) && (addr < limit_addr)) {
-            mpid = i;
-            break;
-        }
+    if ((i < as->vmpu_order.num) && (as->vmpu_order.entries[i].base <= addr)) {
+        mpid = as->vmpu_order.entries[i].mpid;
     }
 
     return mpid;
@@ -193,6 +250,7 @@ void as_init(struct addr_space* as, enum AS_TYPE type, asid_t id, colormap_t col
     as->type = type;
     as->colors = 0;
     as->id = id;
+    as->vmpu_order.num = 0;
     as_arch_init(as);
 
     for (size_t i = 0; i < VMPU_NUM_ENTRIES; i++) {
@@ -206,7 +264,7 @@ static void mem_free_ppages(struct ppages* ppages)
         spin_lock(&pool->lock);
         if (in_range(ppages->base, pool->base, pool->size * PAGE_SIZE)) {
             size_t index = (ppages->base - pool->base) / PAGE_SIZE;
-            bitmap_clear_consecutive(pool->bitmap, index, ppages->num_pages);
+            pp_mark_free(pool, index, ppages->num_pages);
         }
         spin_unlock(&pool->lock);
     }
@@ -353,21 +411,34 @@ void mem_handle_broadcast_region(uint32_t event, uint64_t data)
     }
 }
 
-mpid_t mem_vmpu_find_overlapping_region(struct addr_space* as, struct mp_region* region)
+/**
+ * Map back into the physical mpu the vmpu region containing addr, which was evicted to make room
+ * for others. Called on guest faults.
+ *
+ * @returns true if the region was mapped back, i.e., the faulting access can be retried.
+ */
+bool mem_vmpu_refill(struct addr_space* as, vaddr_t addr)
 {
-    mpid_t mpid = INVALID_MPID;
+    bool refilled = false;
 
-    for (mpid_t i = 0; i < VMPU_NUM_ENTRIES; i++) {
-        struct mpe* mpe = mem_vmpu_get_entry(as, i);
+    spin_lock(&as->lock);
+    mpid_t mpid = mem_vmpu_get_entry_by_addr(as, addr);
+    if (mpid != INVALID_MPID) {
+        refilled = mpu_refill(as_priv(as), &mem_vmpu_get_entry(as, mpid)->region, addr);
+    }
+    spin_unlock(&as->lock);
 
-        if (mpe->state != MPE_S_VALID) {
-            continue;
-        }
+    return refilled;
+}
 
-        if (mem_regions_overlap(region, &mpe->region)) {
-            mpid = i;
-            break;
-        }
+mpid_t mem_vmpu_find_overlapping_region(struct addr_space* as, struct mp_region* region)
+{
+    mpid_t mpid = INVALID_MPID;
+    size_t i = mem_vmpu_order_search(as, region->base);
+
+    if ((i < as->vmpu_order.num) &&
+        (as->vmpu_order.entries[i].base < (region->base + region->size))) {
+        mpid = as->vmpu_order.entries[i].mpid;
     }
 
     return mpid;
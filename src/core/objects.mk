@@ -3,6 +3,7 @@
 
 core-objs-y+=init.o
 core-objs-y+=mem.o
+core-objs-y+=page_pool.o
 core-objs-y+=cache.o
 core-objs-y+=interrupts.o
 core-objs-y+=cpu.o
@@ -13,3 +14,4 @@ core-objs-y+=console.o
 core-objs-y+=ipc.o
 core-objs-y+=objpool.o
 core-objs-y+=hypercall.o
+core-objs-$(STATS)+=stats.o
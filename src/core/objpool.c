@@ -4,24 +4,65 @@
  */
 
 #include <objpool.h>
+#include <cpu.h>
 #include <string.h>
 
 void objpool_init(struct objpool* objpool)
 {
     memset(objpool->pool, 0, objpool->objsize * objpool->num);
-    memset(objpool->bitmap, 0, BITMAP_SIZE(objpool->num));
+    objpool->count = 0;
+    objpool->free = NULL;
+    if (objpool->caches != NULL) {
+        memset(objpool->caches, 0, sizeof(struct objpool_cache) * PLAT_CPU_NUM);
+    }
+}
+
+/* Must be called with the pool lock held */
+static void* objpool_pop(struct objpool* objpool)
+{
+    void* obj = objpool->free;
+    if (obj != NULL) {
+        objpool->free = *(void**)obj;
+    } else if (objpool->count < objpool->num) {
+        obj = objpool->pool + (objpool->objsize * objpool->count);
+        objpool->count++;
+    }
+    return obj;
+}
+
+/* Must be called with the pool lock held */
+static void objpool_push(struct objpool* objpool, void* obj)
+{
+    *(void**)obj = objpool->free;
+    objpool->free = obj;
 }
 
 void* objpool_alloc(struct objpool* objpool)
 {
     void* obj = NULL;
-    spin_lock(&objpool->lock);
-    ssize_t n = bitmap_find_nth(objpool->bitmap, objpool->num, 1, 0, false);
-    if (n >= 0) {
-        bitmap_set(objpool->bitmap, n);
-        obj = objpool->pool + (objpool->objsize * n);
+
+    if (objpool->caches != NULL) {
+        struct objpool_cache* cache = &objpool->caches[cpu()->id];
+        if (cache->num == 0) {
+            spin_lock(&objpool->lock);
+            while (cache->num < (OBJPOOL_CACHE_SIZE / 2)) {
+                void* refill = objpool_pop(objpool);
+                if (refill == NULL) {
+                    break;
+                }
+                cache->objs[cache->num++] = refill;
+            }
+            spin_unlock(&objpool->lock);
+        }
+        if (cache->num > 0) {
+            obj = cache->objs[--cache->num];
+        }
+    } else {
+        spin_lock(&objpool->lock);
+        obj = objpool_pop(objpool);
+        spin_unlock(&objpool->lock);
     }
-    spin_unlock(&objpool->lock);
+
     return obj;
 }
 
@@ -31,12 +72,24 @@ void objpool_free(struct objpool* objpool, void* obj)
     vaddr_t pool_addr = (vaddr_t)objpool->pool;
     bool in_pool = in_range(obj_addr, pool_addr, objpool->objsize * objpool->num);
     bool aligned = IS_ALIGNED(obj_addr - pool_addr, objpool->objsize);
-    if (in_pool && aligned) {
-        size_t n = (obj_addr - pool_addr) / objpool->objsize;
+    if (!in_pool || !aligned) {
+        WARNING("leaked while trying to free stray object");
+        return;
+    }
+
+    if (objpool->caches != NULL) {
+        struct objpool_cache* cache = &objpool->caches[cpu()->id];
+        if (cache->num == OBJPOOL_CACHE_SIZE) {
+            spin_lock(&objpool->lock);
+            while (cache->num > (OBJPOOL_CACHE_SIZE / 2)) {
+                objpool_push(objpool, cache->objs[--cache->num]);
+            }
+            spin_unlock(&objpool->lock);
+        }
+        cache->objs[cache->num++] = obj;
+    } else {
         spin_lock(&objpool->lock);
-        bitmap_clear(objpool->bitmap, n);
+        objpool_push(objpool, obj);
         spin_unlock(&objpool->lock);
-    } else {
-        WARNING("leaked while trying to free stray object");
     }
 }
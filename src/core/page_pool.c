@@ -0,0 +1,283 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <page_pool.h>
+#include <string.h>
+
+static size_t pp_log2(size_t n)
+{
+    size_t order = 0;
+    while ((1UL << order) < n) {
+        order++;
+    }
+    return order;
+}
+
+#define PP_BUDDY_LEAF_ORDER (pp_log2(BITMAP_GRANULE_LEN))
+
+static size_t pp_buddy_num_leaves(size_t pool_num_pages)
+{
+    return 1UL << pp_log2(BITMAP_SIZE(pool_num_pages));
+}
+
+size_t pp_meta_num_pages(size_t pool_num_pages)
+{
+    size_t bitmap_size = BITMAP_SIZE(pool_num_pages) * sizeof(bitmap_granule_t);
+    size_t buddy_size = 2 * pp_buddy_num_leaves(pool_num_pages) * sizeof(uint8_t);
+    return NUM_PAGES(bitmap_size + buddy_size);
+}
+
+/* Bitmap granule with the bits past the end of the pool marked as allocated */
+static inline bitmap_granule_t pp_granule(struct page_pool* pool, size_t granule)
+{
+    bitmap_granule_t word = pool->bitmap[granule];
+    size_t valid = pool->size - (granule * BITMAP_GRANULE_LEN);
+    if (valid < BITMAP_GRANULE_LEN) {
+        word |= ((bitmap_granule_t)~0) << valid;
+    }
+    return word;
+}
+
+/* Mask of the bits of a granule which are aligned to a block of 2^order pages */
+static inline bitmap_granule_t pp_buddy_align_mask(size_t order)
+{
+    size_t width = 1UL << order;
+    if (width >= BITMAP_GRANULE_LEN) {
+        return 1;
+    }
+    return ((bitmap_granule_t)~0) / ((((bitmap_granule_t)1) << width) - 1);
+}
+
+/**
+ * Returns the bits of a granule which start a free block of 2^order pages aligned to its size.
+ * Every round folds the free bits so that bit i is set only if pages [i, i + 2^round) are free.
+ */
+static bitmap_granule_t pp_buddy_granule_blocks(bitmap_granule_t word, size_t order)
+{
+    bitmap_granule_t free = ~word;
+    for (size_t i = 0; i < order; i++) {
+        free &= free >> (1UL << i);
+    }
+    return free & pp_buddy_align_mask(order);
+}
+
+static uint8_t pp_buddy_leaf(struct page_pool* pool, size_t granule)
+{
+    bitmap_granule_t word = pp_granule(pool, granule);
+    uint8_t value = 0;
+
+    for (size_t order = 0; order <= PP_BUDDY_LEAF_ORDER; order++) {
+        if (pp_buddy_granule_blocks(word, order) == 0) {
+            break;
+        }
+        value = (uint8_t)(order + 1);
+    }
+
+    return value;
+}
+
+/**
+ * Recomputes the leaves covering pages [index, index + num_pages) from the bitmap and propagates
+ * them up to the root, one tree level at a time.
+ */
+static void pp_buddy_update(struct page_pool* pool, size_t index, size_t num_pages)
+{
+    if (pool->buddy == NULL || num_pages == 0) {
+        return;
+    }
+
+    size_t lo = pool->buddy_leaves + (index / BITMAP_GRANULE_LEN);
+    size_t hi = pool->buddy_leaves + ((index + num_pages - 1) / BITMAP_GRANULE_LEN);
+    for (size_t node = lo; node <= hi; node++) {
+        pool->buddy[node] = pp_buddy_leaf(pool, node - pool->buddy_leaves);
+    }
+
+    uint8_t full = (uint8_t)(PP_BUDDY_LEAF_ORDER + 1);
+    while (lo > 1) {
+        lo /= 2;
+        hi /= 2;
+        for (size_t node = lo; node <= hi; node++) {
+            uint8_t left = pool->buddy[2 * node];
+            uint8_t right = pool->buddy[(2 * node) + 1];
+            pool->buddy[node] = (left == full && right == full) ? (full + 1) : max(left, right);
+        }
+        full++;
+    }
+}
+
+void pp_buddy_init(struct page_pool* pool)
+{
+    pool->buddy_leaves = pp_buddy_num_leaves(pool->size);
+    pool->buddy = (uint8_t*)&pool->bitmap[BITMAP_SIZE(pool->size)];
+    memset(pool->buddy, 0, 2 * pool->buddy_leaves * sizeof(uint8_t));
+    pp_buddy_update(pool, 0, pool->size);
+}
+
+/**
+ * Finds the lowest free block of 2^order pages naturally aligned relative to the pool base in
+ * O(log n). Returns its page index in the pool or -1 if there is none.
+ */
+static ssize_t pp_buddy_find(struct page_pool* pool, size_t order)
+{
+    if (pool->buddy == NULL || pool->buddy[1] <= order) {
+        return -1;
+    }
+
+    size_t node = 1;
+    size_t node_order = PP_BUDDY_LEAF_ORDER + pp_log2(pool->buddy_leaves);
+    while (node < pool->buddy_leaves && node_order > order) {
+        node = (pool->buddy[2 * node] > order) ? (2 * node) : ((2 * node) + 1);
+        node_order--;
+    }
+
+    if (node_order > order) {
+        size_t granule = node - pool->buddy_leaves;
+        bitmap_granule_t blocks = pp_buddy_granule_blocks(pp_granule(pool, granule), order);
+        return (ssize_t)((granule * BITMAP_GRANULE_LEN) + (size_t)bit32_ffs(blocks));
+    } else {
+        size_t level_first = pool->buddy_leaves >> (node_order - PP_BUDDY_LEAF_ORDER);
+        return (ssize_t)((node - level_first) << node_order);
+    }
+}
+
+void pp_mark_alloc(struct page_pool* pool, size_t index, size_t num_pages)
+{
+    bitmap_set_consecutive(pool->bitmap, index, num_pages);
+    pp_buddy_update(pool, index, num_pages);
+}
+
+void pp_mark_free(struct page_pool* pool, size_t index, size_t num_pages)
+{
+    bitmap_clear_consecutive(pool->bitmap, index, num_pages);
+    pp_buddy_update(pool, index, num_pages);
+}
+
+/**
+ * Returns the first free page at or after index, or the pool size if there is none. Fully
+ * allocated spans are skipped through the buddy tree instead of being walked page by page.
+ */
+size_t pp_next_free(struct page_pool* pool, size_t index)
+{
+    if (index >= pool->size) {
+        return pool->size;
+    }
+
+    size_t granule = index / BITMAP_GRANULE_LEN;
+    bitmap_granule_t free =
+        ~pp_granule(pool, granule) & (((bitmap_granule_t)~0) << (index % BITMAP_GRANULE_LEN));
+    if (free != 0) {
+        return (granule * BITMAP_GRANULE_LEN) + (size_t)bit32_ffs(free);
+    }
+
+    if (pool->buddy == NULL) {
+        for (index = (granule + 1) * BITMAP_GRANULE_LEN; index < pool->size; index++) {
+            if (!bitmap_get(pool->bitmap, index)) {
+                break;
+            }
+        }
+        return min(index, pool->size);
+    }
+
+    /* Climb until there is a right sibling with free pages, then take its leftmost free leaf */
+    size_t node = pool->buddy_leaves + granule;
+    while (node > 1 && ((node % 2) != 0 || pool->buddy[node + 1] == 0)) {
+        node /= 2;
+    }
+    if (node <= 1) {
+        return pool->size;
+    }
+
+    node++;
+    while (node < pool->buddy_leaves) {
+        node = (pool->buddy[2 * node] != 0) ? (2 * node) : ((2 * node) + 1);
+    }
+
+    granule = node - pool->buddy_leaves;
+    return (granule * BITMAP_GRANULE_LEN) + (size_t)bit32_ffs(~pp_granule(pool, granule));
+}
+
+bool pp_alloc(struct page_pool* pool, size_t num_pages, bool aligned, struct ppages* ppages)
+{
+    ppages->colors = 0;
+    ppages->num_pages = 0;
+
+    bool ok = false;
+
+    if (num_pages == 0) {
+        return true;
+    }
+
+    spin_lock(&pool->lock);
+
+    /**
+     * Serve the request from the smallest buddy block that fits it. The buddy tree tracks
+     * alignment relative to the pool base, so for aligned requests this only holds for power of
+     * two sizes when the base itself is aligned to the request. Everything else, or a failed
+     * lookup due to fragmentation, falls back to the linear bitmap search below.
+     */
+    size_t order = pp_log2(num_pages);
+    bool pow2 = (1UL << order) == num_pages;
+    if (!aligned || (pow2 && ((pool->base / PAGE_SIZE) % num_pages) == 0)) {
+        ssize_t bit = pp_buddy_find(pool, order);
+        if (bit >= 0) {
+            ppages->base = pool->base + ((size_t)bit * PAGE_SIZE);
+            ppages->num_pages = num_pages;
+            pp_mark_alloc(pool, (size_t)bit, num_pages);
+            pool->free -= num_pages;
+            pool->last = (size_t)bit + num_pages;
+            ok = true;
+        }
+    }
+
+    /**
+     * If we need a contigous segment aligned to its size, lets start at an already aligned index.
+     */
+    size_t start = aligned ? pool->base / PAGE_SIZE % num_pages : 0;
+    size_t curr = pool->last + ((pool->last + start) % num_pages);
+
+    /**
+     * Lets make two searches:
+     *  - one starting from the last known free index.
+     *  - in case this does not work, start from index 0.
+     */
+    for (size_t i = 0; i < 2 && !ok; i++) {
+        while (pool->free != 0) {
+            ssize_t bit = bitmap_find_consec(pool->bitmap, pool->size, curr, num_pages, false);
+
+            if (bit < 0) {
+                /**
+                 * No num_page page sement was found. If this is the first iteration set position
+                 * to 0 to start next search from index
+                 * 0.
+                 */
+                size_t next_aligned =
+                    (num_pages - ((pool->base / PAGE_SIZE) % num_pages)) % num_pages;
+                curr = aligned ? next_aligned : 0;
+                break;
+            } else if (aligned && (((bit + start) % num_pages) != 0)) {
+                /**
+                 * If we're looking for an aligned segment and the found contigous segment is not
+                 * aligned, start the search again from the last aligned index
+                 */
+                curr = bit + ((bit + start) % num_pages);
+            } else {
+                /**
+                 * We've found our pages. Fill output argument info, mark them as allocated, and
+                 * update page pool bookkeeping.
+                 */
+                ppages->base = pool->base + (bit * PAGE_SIZE);
+                ppages->num_pages = num_pages;
+                pp_mark_alloc(pool, bit, num_pages);
+                pool->free -= num_pages;
+                pool->last = bit + num_pages;
+                ok = true;
+                break;
+            }
+        }
+    }
+    spin_unlock(&pool->lock);
+
+    return ok;
+}
@@ -0,0 +1,192 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <stats.h>
+
+#include <cpu.h>
+#include <vm.h>
+#include <config.h>
+#include <console.h>
+#include <interrupts.h>
+#include <platform.h>
+#include <hypercall.h>
+#include <spinlock.h>
+#include <string.h>
+
+enum { STATS_DUMP };
+
+static spinlock_t stats_dump_lock = SPINLOCK_INITVAL;
+
+static void stats_msg_handler(uint32_t event, uint64_t data);
+CPU_MSG_HANDLER(stats_msg_handler, STATS_CPUMSG_ID);
+
+/**
+ * Bucket n counts events which took [2^n, 2^(n+1)) ticks. The first bucket also takes events
+ * which took no ticks at all and the last one everything above its lower bound.
+ */
+static size_t stats_hist_bucket(uint64_t ticks)
+{
+    size_t bucket = 0;
+
+    while ((ticks >>= 1) != 0 && bucket < (STATS_HIST_BUCKETS - 1)) {
+        bucket++;
+    }
+
+    return bucket;
+}
+
+void stats_reset(struct vcpu* vcpu)
+{
+    memset(&vcpu->stats, 0, sizeof(vcpu->stats));
+}
+
+void stats_record(struct vcpu* vcpu, size_t class, uint64_t start)
+{
+    uint64_t ticks = stats_arch_timestamp() - start;
+
+    if (vcpu == NULL || class >= STATS_CLASS_NUM) {
+        return;
+    }
+
+    struct stats_entry* entry = &vcpu->stats.entries[class];
+    entry->count++;
+    entry->ticks += ticks;
+    entry->hist[stats_hist_bucket(ticks)]++;
+}
+
+static void stats_dump_class_name(size_t class)
+{
+    if (class < STATS_IRQ_FWD) {
+        console_printk("    exit 0x%lx:", (unsigned long)class);
+    } else if (class == STATS_IRQ_FWD) {
+        console_printk("    irq forward:");
+    } else if (class == STATS_IRQ_HYP) {
+        console_printk("    irq hyp:");
+    } else if (class < STATS_HC(0)) {
+        console_printk("    cpu msg %lu:", (unsigned long)(class - STATS_CPUMSG(0)));
+    } else {
+        console_printk("    hypercall %lu:", (unsigned long)(class - STATS_HC(0)));
+    }
+}
+
+void stats_dump(struct vcpu* vcpu)
+{
+    if (vcpu == NULL) {
+        return;
+    }
+
+    spin_lock(&stats_dump_lock);
+    console_printk("[stats] cpu %lu vm %lu vcpu %lu\n", (unsigned long)cpu()->id,
+        (unsigned long)vcpu->vm->id, (unsigned long)vcpu->id);
+    for (size_t class = 0; class < STATS_CLASS_NUM; class++) {
+        struct stats_entry* entry = &vcpu->stats.entries[class];
+        if (entry->count == 0) {
+            continue;
+        }
+        stats_dump_class_name(class);
+        console_printk(" %lu events, %lu ticks |", (unsigned long)entry->count,
+            (unsigned long)entry->ticks);
+        for (size_t bucket = 0; bucket < STATS_HIST_BUCKETS; bucket++) {
+            if (entry->hist[bucket] != 0) {
+                console_printk(" 2^%lu:%u", (unsigned long)bucket, entry->hist[bucket]);
+            }
+        }
+        console_printk("\n");
+    }
+    spin_unlock(&stats_dump_lock);
+}
+
+static void stats_msg_handler(uint32_t event, uint64_t data)
+{
+    switch (event) {
+        case STATS_DUMP:
+            stats_dump(cpu()->vcpu);
+            break;
+    }
+}
+
+static void stats_console_handler(irqid_t int_id)
+{
+    bool dump = false;
+    char c;
+
+    while (console_getc(&c)) {
+        if (c == STATS_HOTKEY) {
+            dump = true;
+        }
+    }
+
+    if (dump) {
+        cpumap_t cpus = ((1UL << platform.cpu_num) - 1) & ~(1UL << cpu()->id);
+        struct cpu_msg msg = { STATS_CPUMSG_ID, STATS_DUMP, 0 };
+        cpu_send_msg_mask(cpus, &msg);
+        stats_dump(cpu()->vcpu);
+    }
+}
+
+static bool stats_irq_assigned(irqid_t int_id)
+{
+    for (size_t i = 0; i < config.vmlist_size; i++) {
+        const struct vm_platform* vm_platform = &config.vmlist[i].platform;
+        for (size_t j = 0; j < vm_platform->dev_num; j++) {
+            for (size_t k = 0; k < vm_platform->devs[j].interrupt_num; k++) {
+                if (vm_platform->devs[j].interrupts[k] == int_id) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+void stats_init()
+{
+    if (cpu_is_master() && platform.console.irq != 0) {
+        /**
+         * The console uart might also be passed through to a vm (e.g., for debugging), in which
+         * case its interrupt belongs to the guest.
+         */
+        if (stats_irq_assigned(platform.console.irq)) {
+            WARNING("Console interrupt assigned to a vm, stats hotkey disabled");
+            return;
+        }
+        if (!interrupts_reserve(platform.console.irq, stats_console_handler)) {
+            WARNING("Failed to reserve console interrupt, stats hotkey disabled");
+            return;
+        }
+        console_rx_enable();
+        interrupts_cpu_enable(platform.console.irq, true);
+    }
+}
+
+long int stats_hypercall(unsigned long vcpu_id, unsigned long class, unsigned long field)
+{
+    struct vm* vm = cpu()->vcpu->vm;
+
+    if (!vm->config->hyp_stats) {
+        return -HC_E_FAILURE;
+    }
+
+    if (vcpu_id >= vm->cpu_num || class >= STATS_CLASS_NUM || field >= STATS_FIELD_NUM) {
+        return -HC_E_INVAL_ARGS;
+    }
+
+    /**
+     * Fields of remote vcpus are read without synchronization with their owners. A value might be
+     * one event behind, which is of no consequence for statistics.
+     */
+    struct stats_entry* entry = &vm_get_vcpu(vm, vcpu_id)->stats.entries[class];
+    unsigned long value;
+    if (field == STATS_FIELD_COUNT) {
+        value = (unsigned long)entry->count;
+    } else if (field == STATS_FIELD_TICKS) {
+        value = (unsigned long)entry->ticks;
+    } else {
+        value = entry->hist[field - STATS_FIELD_HIST];
+    }
+
+    return (long int)value;
+}
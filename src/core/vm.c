@@ -15,6 +15,8 @@ static void vm_master_init(struct vm* vm, const struct vm_config* config, vmid_t
     vm->config = config;
     vm->cpu_num = config->platform.cpu_num;
     vm->id = vm_id;
+    vm->emul_mem_num = 0;
+    vm->emul_reg_num = 0;
 
     cpu_sync_init(&vm->sync, vm->cpu_num);
 
@@ -47,6 +49,8 @@ void vm_vcpu_init(struct vm* vm, const struct vm_config* config)
     vcpu->id = vcpu_id;
     vcpu->phys_id = cpu()->id;
     vcpu->vm = vm;
+    vcpu->emul_mem_hit = NULL;
+    stats_reset(vcpu);
     cpu()->vcpu = vcpu;
 
     vcpu_arch_init(vcpu, vm);
@@ -123,16 +127,39 @@ static void vm_install_image(struct vm* vm, struct vm_mem_region* reg)
         }
     }
 
+    /**
+     * With an mmu, the copy is split in page aligned chunks, one per VM cpu, each copied and
+     * flushed through its own temporary mappings. Mpu-based memory management can only copy
+     * mappings of whole regions and broadcasts hypervisor mappings to all cpus, so there the
+     * master installs the full image alone.
+     */
     size_t img_num_pages = NUM_PAGES(vm->config->image.size);
-    struct ppages img_ppages = mem_ppages_get(vm->config->image.load_addr, img_num_pages);
-    vaddr_t src_va = mem_alloc_map(&cpu()->as, SEC_HYP_GLOBAL, &img_ppages, INVALID_VA,
-        img_num_pages, PTE_HYP_FLAGS);
-    vaddr_t dst_va =
-        mem_map_cpy(&vm->as, &cpu()->as, vm->config->image.base_addr, INVALID_VA, img_num_pages);
-    memcpy((void*)dst_va, (void*)src_va, vm->config->image.size);
-    cache_flush_range((vaddr_t)dst_va, vm->config->image.size);
-    mem_unmap(&cpu()->as, src_va, img_num_pages, false);
-    mem_unmap(&cpu()->as, dst_va, img_num_pages, false);
+    size_t chunk_num = DEFINED(MEM_PROT_MMU) ? vm->cpu_num : 1;
+    size_t chunk_idx = DEFINED(MEM_PROT_MMU) ? cpu()->vcpu->id : 0;
+    size_t chunk_pages = (img_num_pages + chunk_num - 1) / chunk_num;
+    size_t offset = chunk_idx * chunk_pages * PAGE_SIZE;
+
+    if ((!DEFINED(MEM_PROT_MMU) && (cpu()->id != vm->master)) ||
+        (offset >= vm->config->image.size)) {
+        return;
+    }
+
+    size_t num_pages = min(chunk_pages, img_num_pages - (chunk_idx * chunk_pages));
+    size_t size = min(num_pages * PAGE_SIZE, vm->config->image.size - offset);
+    struct ppages img_ppages = mem_ppages_get(vm->config->image.load_addr + offset, num_pages);
+    vaddr_t src_va = mem_alloc_map(&cpu()->as, SEC_HYP_GLOBAL, &img_ppages, INVALID_VA, num_pages,
+        PTE_HYP_FLAGS);
+    vaddr_t dst_va = mem_map_cpy(&vm->as, &cpu()->as, vm->config->image.base_addr + offset,
+        INVALID_VA, num_pages);
+    memcpy((void*)dst_va, (void*)src_va, size);
+    cache_flush_range((vaddr_t)dst_va, size);
+    mem_unmap(&cpu()->as, src_va, num_pages, false);
+    mem_unmap(&cpu()->as, dst_va, num_pages, false);
+}
+
+static inline bool vm_img_in_rgn(const struct vm_config* config, struct vm_mem_region* reg)
+{
+    return range_in_range(config->image.base_addr, config->image.size, reg->base, reg->size);
 }
 
 static void vm_map_img_rgn(struct vm* vm, const struct vm_config* config, struct vm_mem_region* reg)
@@ -141,7 +168,6 @@ static void vm_map_img_rgn(struct vm* vm, const struct vm_config* config, struct
         vm_map_img_rgn_inplace(vm, config, reg);
     } else {
         vm_map_mem_region(vm, reg);
-        vm_install_image(vm, reg);
     }
 }
 
@@ -149,9 +175,7 @@ static void vm_init_mem_regions(struct vm* vm, const struct vm_config* config)
 {
     for (size_t i = 0; i < config->platform.region_num; i++) {
         struct vm_mem_region* reg = &config->platform.regions[i];
-        bool img_is_in_rgn =
-            range_in_range(config->image.base_addr, config->image.size, reg->base, reg->size);
-        if (img_is_in_rgn) {
+        if (vm_img_in_rgn(config, reg)) {
             vm_map_img_rgn(vm, config, reg);
         } else {
             vm_map_mem_region(vm, reg);
@@ -159,6 +183,19 @@ static void vm_init_mem_regions(struct vm* vm, const struct vm_config* config)
     }
 }
 
+static void vm_init_img(struct vm* vm, const struct vm_config* config)
+{
+    for (size_t i = 0; i < config->platform.region_num; i++) {
+        struct vm_mem_region* reg = &config->platform.regions[i];
+        if (vm_img_in_rgn(config, reg)) {
+            if (reg->place_phys || !config->image.inplace) {
+                vm_install_image(vm, reg);
+            }
+            break;
+        }
+    }
+}
+
 static void vm_init_ipc(struct vm* vm, const struct vm_config* config)
 {
     vm->ipc_num = config->platform.ipc_num;
@@ -272,53 +309,105 @@ struct vm* vm_init(struct vm_allocation* vm_alloc, const struct vm_config* confi
 
     cpu_sync_and_clear_msgs(&vm->sync);
 
+    /**
+     * Once the address space is built, all the VM's cpus install its image in parallel.
+     */
+    vm_init_img(vm, config);
+
+    cpu_sync_and_clear_msgs(&vm->sync);
+
     return vm;
 }
 
 void vm_emul_add_mem(struct vm* vm, struct emul_mem* emu)
 {
-    list_push(&vm->emul_mem_list, &emu->node);
+    if (vm->emul_mem_num >= VM_EMUL_MEM_NUM_MAX) {
+        ERROR("too many emulated memory regions for vm %lu", vm->id);
+    }
+
+    size_t i = vm->emul_mem_num;
+    while ((i > 0) && (vm->emul_mem[i - 1]->va_base > emu->va_base)) {
+        vm->emul_mem[i] = vm->emul_mem[i - 1];
+        i--;
+    }
+    vm->emul_mem[i] = emu;
+    vm->emul_mem_num++;
 }
 
 void vm_emul_add_reg(struct vm* vm, struct emul_reg* emu)
 {
-    list_push(&vm->emul_reg_list, &emu->node);
+    if (vm->emul_reg_num >= VM_EMUL_REG_NUM_MAX) {
+        ERROR("too many emulated registers for vm %lu", vm->id);
+    }
+
+    size_t i = vm->emul_reg_num;
+    while ((i > 0) && (vm->emul_reg[i - 1]->addr > emu->addr)) {
+        vm->emul_reg[i] = vm->emul_reg[i - 1];
+        i--;
+    }
+    vm->emul_reg[i] = emu;
+    vm->emul_reg_num++;
+}
+
+static inline bool vm_emul_mem_hit(struct emul_mem* emu, vaddr_t addr)
+{
+    return (emu != NULL) && (addr >= emu->va_base) && (addr < (emu->va_base + emu->size));
 }
 
 emul_handler_t vm_emul_get_mem(struct vm* vm, vaddr_t addr)
 {
-    emul_handler_t handler = NULL;
-    list_foreach (vm->emul_mem_list, struct emul_mem, emu) {
-        if (addr >= emu->va_base && (addr < (emu->va_base + emu->size))) {
-            handler = emu->handler;
-            break;
+    struct vcpu* vcpu = cpu()->vcpu;
+    bool cache = (vcpu != NULL) && (vcpu->vm == vm);
+
+    if (cache && vm_emul_mem_hit(vcpu->emul_mem_hit, addr)) {
+        return vcpu->emul_mem_hit->handler;
+    }
+
+    /* Find the last region starting at or below addr. Regions are assumed not to overlap. */
+    size_t lo = 0;
+    size_t hi = vm->emul_mem_num;
+    while (lo < hi) {
+        size_t mid = lo + ((hi - lo) / 2);
+        if (vm->emul_mem[mid]->va_base <= addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
     }
 
-    return handler;
+    struct emul_mem* emu = (lo > 0) ? vm->emul_mem[lo - 1] : NULL;
+    if (!vm_emul_mem_hit(emu, addr)) {
+        return NULL;
+    }
+
+    if (cache) {
+        vcpu->emul_mem_hit = emu;
+    }
+
+    return emu->handler;
 }
 
 emul_handler_t vm_emul_get_reg(struct vm* vm, vaddr_t addr)
 {
-    emul_handler_t handler = NULL;
-    list_foreach (vm->emul_reg_list, struct emul_reg, emu) {
-        if (emu->addr == addr) {
-            handler = emu->handler;
-            break;
+    size_t lo = 0;
+    size_t hi = vm->emul_reg_num;
+    while (lo < hi) {
+        size_t mid = lo + ((hi - lo) / 2);
+        if (vm->emul_reg[mid]->addr == addr) {
+            return vm->emul_reg[mid]->handler;
+        } else if (vm->emul_reg[mid]->addr < addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
     }
 
-    return handler;
+    return NULL;
 }
 
 void vm_msg_broadcast(struct vm* vm, struct cpu_msg* msg)
 {
-    for (size_t i = 0, n = 0; n < vm->cpu_num - 1; i++) {
-        if (((1U << i) & vm->cpus) && (i != cpu()->id)) {
-            n++;
-            cpu_send_msg(i, msg);
-        }
-    }
+    cpu_send_msg_mask(vm->cpus & ~(1UL << cpu()->id), msg);
 }
 
 __attribute__((weak)) cpumap_t vm_translate_to_pcpu_mask(struct vm* vm, cpumap_t mask, size_t len)
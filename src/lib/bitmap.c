@@ -5,58 +5,128 @@
 
 #include <bitmap.h>
 
+/**
+ * All searches work a granule at a time: a granule is first inverted if we are looking for clear
+ * bits, so that the bits of interest are always the set ones, and then scanned with find first set.
+ */
+static inline bitmap_granule_t bitmap_granule_match(bitmap_t* map, size_t granule, bool set)
+{
+    return set ? map[granule] : ~map[granule];
+}
+
+/* Clears the bits of a granule starting at pos which lie past the end of the map */
+static inline bitmap_granule_t bitmap_granule_trim(bitmap_granule_t granule, size_t pos,
+    size_t size)
+{
+    if ((size - pos) < BITMAP_GRANULE_LEN) {
+        granule &= BITMAP_GRANULE_MASK(0, size - pos);
+    }
+    return granule;
+}
+
+ssize_t bitmap_find_next(bitmap_t* map, size_t size, size_t start, bool set)
+{
+    if (start >= size) {
+        return -1;
+    }
+
+    size_t pos = start - (start % BITMAP_GRANULE_LEN);
+    bitmap_granule_t granule = bitmap_granule_match(map, pos / BITMAP_GRANULE_LEN, set) &
+        (((bitmap_granule_t)~0) << (start % BITMAP_GRANULE_LEN));
+
+    while (true) {
+        granule = bitmap_granule_trim(granule, pos, size);
+        if (granule != 0) {
+            return (ssize_t)pos + bitmap_granule_ffs(granule);
+        }
+
+        pos += BITMAP_GRANULE_LEN;
+        if (pos >= size) {
+            return -1;
+        }
+        granule = bitmap_granule_match(map, pos / BITMAP_GRANULE_LEN, set);
+    }
+}
+
 ssize_t bitmap_find_nth(bitmap_t* map, size_t size, size_t nth, size_t start, bool set)
 {
-    if (size <= 0 || nth <= 0 || start < 0) {
+    if (size == 0 || nth == 0 || start >= size) {
         return -1;
     }
 
-    size_t count = 0;
-    unsigned bit = set ? 1 : 0;
+    if (nth == 1) {
+        return bitmap_find_next(map, size, start, set);
+    }
 
-    for (ssize_t i = start; i < size; i++) {
-        if (bitmap_get(map, i) == bit) {
-            if (++count == nth) {
-                return i;
+    size_t pos = start - (start % BITMAP_GRANULE_LEN);
+    bitmap_granule_t granule = bitmap_granule_match(map, pos / BITMAP_GRANULE_LEN, set) &
+        (((bitmap_granule_t)~0) << (start % BITMAP_GRANULE_LEN));
+
+    while (true) {
+        granule = bitmap_granule_trim(granule, pos, size);
+        size_t count = bitmap_granule_count(granule);
+        if (count >= nth) {
+            /* Drop the nth - 1 lowest matches, the nth is now the first one */
+            while (--nth > 0) {
+                granule &= granule - 1;
             }
+            return (ssize_t)pos + bitmap_granule_ffs(granule);
         }
-    }
 
-    return -1;
+        nth -= count;
+        pos += BITMAP_GRANULE_LEN;
+        if (pos >= size) {
+            return -1;
+        }
+        granule = bitmap_granule_match(map, pos / BITMAP_GRANULE_LEN, set);
+    }
 }
 
-size_t bitmap_count_consecutive(bitmap_t* map, size_t size, size_t start, size_t n)
+size_t bitmap_count(bitmap_t* map, size_t start, size_t n, bool set)
 {
-    size_t pos = start;
     size_t count = 0;
-    size_t start_offset = start % BITMAP_GRANULE_LEN;
-    size_t first_word_bits = min(BITMAP_GRANULE_LEN - start_offset, n);
-    bool set = !!bitmap_get(map, start);
-    bitmap_granule_t init_mask = BITMAP_GRANULE_MASK(start_offset, first_word_bits);
-    bitmap_granule_t mask;
+    size_t pos = start;
+
+    while (pos < n) {
+        size_t offset = pos % BITMAP_GRANULE_LEN;
+        size_t len = min(BITMAP_GRANULE_LEN - offset, n - pos);
+        bitmap_granule_t granule = bitmap_granule_match(map, pos / BITMAP_GRANULE_LEN, set);
+        count += bitmap_granule_count(granule & BITMAP_GRANULE_MASK(offset, len));
+        pos += len;
+    }
 
+    return count;
+}
+
+size_t bitmap_count_consecutive(bitmap_t* map, size_t size, size_t start, size_t n)
+{
     if (n <= 1) {
         return n;
     }
 
-    mask = set ? init_mask : ~init_mask;
-    if (!((map[pos / BITMAP_GRANULE_LEN] ^ mask) & init_mask)) {
-        count += first_word_bits;
-        pos += first_word_bits;
+    if (start >= size) {
+        return 0;
     }
 
-    mask = set ? ~0 : 0;
-    while ((pos < size) && !(map[pos / BITMAP_GRANULE_LEN] ^ mask) && (count < n)) {
-        count += BITMAP_GRANULE_LEN;
-        pos += BITMAP_GRANULE_LEN;
-    }
+    /* The run ends at the first bit which differs from the one at start */
+    bool set = !!bitmap_get(map, start);
+    size_t limit = min(n, size - start);
+    size_t pos = start;
+    size_t count = 0;
 
-    while ((pos < size) && (!!bitmap_get(map, pos) == set) && (count < n)) {
-        count++;
-        pos += 1;
+    while (count < limit) {
+        size_t offset = pos % BITMAP_GRANULE_LEN;
+        bitmap_granule_t breaks = bitmap_granule_match(map, pos / BITMAP_GRANULE_LEN, !set) >>
+            offset;
+        if (breaks != 0) {
+            count += (size_t)bitmap_granule_ffs(breaks);
+            break;
+        }
+        count += BITMAP_GRANULE_LEN - offset;
+        pos += BITMAP_GRANULE_LEN - offset;
     }
 
-    return count;
+    return min(count, limit);
 }
 
 ssize_t bitmap_find_consec(bitmap_t* map, size_t size, size_t start, size_t n, bool set)
@@ -65,7 +135,7 @@ ssize_t bitmap_find_consec(bitmap_t* map, size_t size, size_t start, size_t n, b
     ssize_t i = 0;
 
     // find first set
-    if ((i = bitmap_find_nth(map, size, 1, start, set)) < 0) {
+    if ((i = bitmap_find_next(map, size, start, set)) < 0) {
         return -1;
     }
 
@@ -90,6 +160,10 @@ ssize_t bitmap_find_consec(bitmap_t* map, size_t size, size_t start, size_t n, b
 
 void bitmap_set_consecutive(bitmap_t* map, size_t start, size_t n)
 {
+    if (n == 0) {
+        return;
+    }
+
     size_t pos = start;
     size_t count = n;
     size_t start_offset = start % BITMAP_GRANULE_LEN;
@@ -109,3 +183,29 @@ void bitmap_set_consecutive(bitmap_t* map, size_t start, size_t n)
         map[pos / BITMAP_GRANULE_LEN] |= BITMAP_GRANULE_MASK(0, count);
     }
 }
+
+void bitmap_clear_consecutive(bitmap_t* map, size_t start, size_t n)
+{
+    if (n == 0) {
+        return;
+    }
+
+    size_t pos = start;
+    size_t count = n;
+    size_t start_offset = start % BITMAP_GRANULE_LEN;
+    size_t first_word_bits = min(BITMAP_GRANULE_LEN - start_offset, count);
+
+    map[pos / BITMAP_GRANULE_LEN] &= ~BITMAP_GRANULE_MASK(start_offset, first_word_bits);
+    pos += first_word_bits;
+    count -= first_word_bits;
+
+    while (count >= BITMAP_GRANULE_LEN) {
+        map[pos / BITMAP_GRANULE_LEN] = 0;
+        pos += BITMAP_GRANULE_LEN;
+        count -= BITMAP_GRANULE_LEN;
+    }
+
+    if (count > 0) {
+        map[pos / BITMAP_GRANULE_LEN] &= ~BITMAP_GRANULE_MASK(0, count);
+    }
+}
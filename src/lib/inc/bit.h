@@ -20,6 +20,93 @@
 
 #ifndef __ASSEMBLER__
 
+/**
+ * Trailing/leading zero counts of non-zero words. The compiler builtins map to single instructions
+ * on armv8 and on riscv with Zbb. On base riscv gcc lowers them to libgcc calls, which we do not
+ * link, so there we isolate the relevant bit and look it up with a de Bruijn multiplication.
+ */
+#if defined(__riscv) && !defined(__riscv_zbb)
+
+static inline size_t __bit64_debruijn(uint64_t single_bit)
+{
+    static const uint8_t index[64] = { 0, 1, 48, 2, 57, 49, 28, 3, 61, 58, 50, 42, 38, 29, 17, 4,
+        62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5, 63, 47, 56, 27, 60, 41, 37,
+        16, 54, 35, 52, 21, 44, 32, 23, 11, 46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9, 13, 8, 7,
+        6 };
+    return index[(single_bit * UINT64_C(0x03f79d71b4cb0a89)) >> 58];
+}
+
+static inline size_t __bit64_ctz(uint64_t word)
+{
+    return __bit64_debruijn(word & -word);
+}
+
+static inline size_t __bit64_clz(uint64_t word)
+{
+    word |= word >> 1;
+    word |= word >> 2;
+    word |= word >> 4;
+    word |= word >> 8;
+    word |= word >> 16;
+    word |= word >> 32;
+    return 63 - __bit64_debruijn(word ^ (word >> 1));
+}
+
+static inline size_t __bit32_ctz(uint32_t word)
+{
+    return __bit64_ctz(word);
+}
+
+static inline size_t __bit32_clz(uint32_t word)
+{
+    return __bit64_clz(word) - 32;
+}
+
+#else
+
+static inline size_t __bit32_ctz(uint32_t word)
+{
+    return (size_t)__builtin_ctz(word);
+}
+
+static inline size_t __bit32_clz(uint32_t word)
+{
+    return (size_t)__builtin_clz(word);
+}
+
+/* Split in 32-bit halves where a 64-bit count is not a single instruction (i.e., aarch32) */
+static inline size_t __bit64_ctz(uint64_t word)
+{
+    if (sizeof(unsigned long) == sizeof(uint64_t)) {
+        return (size_t)__builtin_ctzl((unsigned long)word);
+    }
+    return ((uint32_t)word != 0) ? __bit32_ctz((uint32_t)word) :
+                                   (32 + __bit32_ctz((uint32_t)(word >> 32)));
+}
+
+static inline size_t __bit64_clz(uint64_t word)
+{
+    if (sizeof(unsigned long) == sizeof(uint64_t)) {
+        return (size_t)__builtin_clzl((unsigned long)word);
+    }
+    return ((word >> 32) != 0) ? __bit32_clz((uint32_t)(word >> 32)) :
+                                 (32 + __bit32_clz((uint32_t)word));
+}
+
+#endif
+
+static inline size_t __bit_ctz(unsigned long word)
+{
+    return (sizeof(unsigned long) == sizeof(uint64_t)) ? __bit64_ctz(word) :
+                                                         __bit32_ctz((uint32_t)word);
+}
+
+static inline size_t __bit_clz(unsigned long word)
+{
+    return (sizeof(unsigned long) == sizeof(uint64_t)) ? __bit64_clz(word) :
+                                                         __bit32_clz((uint32_t)word);
+}
+
 #define BIT_OPS_GEN(PRE, TYPE, LIT, MASK)                                        \
     static inline TYPE PRE##_get(TYPE word, size_t off)                          \
     {                                                                            \
@@ -43,26 +130,20 @@
     }                                                                            \
     static inline ssize_t PRE##_ffs(TYPE word)                                   \
     {                                                                            \
-        ssize_t pos = (ssize_t)0;                                                \
-        TYPE mask = (LIT);                                                       \
-        while (mask != 0U) {                                                     \
-            if ((mask & word) != 0U) {                                           \
-                break;                                                           \
-            }                                                                    \
-            mask <<= 1U;                                                         \
-            pos++;                                                               \
-        }                                                                        \
-        return (mask != 0U) ? pos : (ssize_t)-1;                                 \
+        return (word != 0U) ? (ssize_t)__##PRE##_ctz(word) : (ssize_t)-1;        \
+    }                                                                            \
+    static inline ssize_t PRE##_fls(TYPE word)                                   \
+    {                                                                            \
+        return (word != 0U) ?                                                    \
+            (ssize_t)((sizeof(TYPE) * 8) - 1 - __##PRE##_clz(word)) :            \
+            (ssize_t)-1;                                                         \
     }                                                                            \
     static inline ssize_t PRE##_count(TYPE word)                                 \
     {                                                                            \
         size_t count = 0;                                                        \
-        TYPE mask = (LIT);                                                       \
-        while (mask != 0U) {                                                     \
-            if ((mask & word) != 0U) {                                           \
-                count += 1;                                                      \
-            }                                                                    \
-            mask <<= 1U;                                                         \
+        while (word != 0U) {                                                     \
+            word &= word - 1;                                                    \
+            count += 1;                                                          \
         }                                                                        \
         return count;                                                            \
     }
@@ -9,8 +9,6 @@
 #include <bao.h>
 #include <bit.h>
 
-/* TODO: needs optimizations */
-
 typedef uint32_t bitmap_granule_t;
 typedef bitmap_granule_t bitmap_t;
 
@@ -25,6 +23,11 @@ static const bitmap_granule_t ONE = 1;
 
 #define BITMAP_ALLOC_ARRAY(NAME, SIZE, NUM) bitmap_granule_t NAME[NUM][BITMAP_SIZE(SIZE)]
 
+/* Iterates over the indexes of the set bits of the map, in ascending order */
+#define bitmap_foreach_set(map, size, bit)                                  \
+    for (ssize_t bit = bitmap_find_next((map), (size), 0, true); bit >= 0; \
+         bit = bitmap_find_next((map), (size), (size_t)bit + 1, true))
+
 static inline void bitmap_set(bitmap_t* map, size_t bit)
 {
     map[bit / BITMAP_GRANULE_LEN] |= ONE << (bit % BITMAP_GRANULE_LEN);
@@ -40,27 +43,23 @@ static inline unsigned bitmap_get(bitmap_t* map, size_t bit)
     return (map[bit / BITMAP_GRANULE_LEN] & (ONE << (bit % BITMAP_GRANULE_LEN))) ? 1U : 0U;
 }
 
-void bitmap_set_consecutive(bitmap_t* map, size_t start, size_t n);
-
-static inline void bitmap_clear_consecutive(bitmap_t* map, size_t start, size_t n)
+static inline ssize_t bitmap_granule_ffs(bitmap_granule_t granule)
 {
-    for (size_t i = 0; i < n; i++) {
-        bitmap_clear(map, start + i);
-    }
+    return bit32_ffs(granule);
 }
 
-static inline size_t bitmap_count(bitmap_t* map, size_t start, size_t n, bool set)
+static inline size_t bitmap_granule_count(bitmap_granule_t granule)
 {
-    size_t count = 0;
-    for (size_t i = start; i < n; i++) {
-        if (bitmap_get(map, i) == set) {
-            count++;
-        }
-    }
-
-    return count;
+    return (size_t)bit32_count(granule);
 }
 
+void bitmap_set_consecutive(bitmap_t* map, size_t start, size_t n);
+void bitmap_clear_consecutive(bitmap_t* map, size_t start, size_t n);
+
+size_t bitmap_count(bitmap_t* map, size_t start, size_t n, bool set);
+
+ssize_t bitmap_find_next(bitmap_t* map, size_t size, size_t start, bool set);
+
 ssize_t bitmap_find_nth(bitmap_t* map, size_t size, size_t nth, size_t start, bool set);
 
 size_t bitmap_count_consecutive(bitmap_t* map, size_t size, size_t start, size_t n);
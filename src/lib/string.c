@@ -5,7 +5,7 @@
 
 #include <string.h>
 
-void* memcpy(void* dst, const void* src, size_t count)
+__attribute__((weak)) void* memcpy(void* dst, const void* src, size_t count)
 {
     size_t i;
     uint8_t* dst_tmp = dst;
@@ -36,7 +36,7 @@ void* memcpy(void* dst, const void* src, size_t count)
     return dst;
 }
 
-void* memset(void* dest, int c, size_t count)
+__attribute__((weak)) void* memset(void* dest, int c, size_t count)
 {
     uint8_t* d;
     d = (uint8_t*)dest;
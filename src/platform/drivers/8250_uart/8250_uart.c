@@ -40,3 +40,18 @@ void uart_putc(volatile struct uart8250_hw* uart, int8_t c)
     while (!(uart->lsr & UART8250_LSR_THRE)) { }
     uart->thr = c;
 }
+
+bool uart_trygetc(volatile struct uart8250_hw* uart, char* c)
+{
+    if (!(uart->lsr & UART8250_LSR_DR)) {
+        return false;
+    }
+
+    *c = (char)uart->rbr;
+    return true;
+}
+
+void uart_rxirq_enable(volatile struct uart8250_hw* uart)
+{
+    uart->ier |= UART8250_IER_ERBFI;
+}
@@ -9,6 +9,7 @@
 #include <bao.h>
 #include <plat/platform.h>
 
+#define UART8250_LSR_DR   (1U << 0)
 #define UART8250_LSR_THRE (1U << 5)
 
 #ifndef UART8250_REG_WIDTH
@@ -60,10 +61,14 @@ struct uart8250_hw {
 #define UART8250_FCR_RX_CLR (0x1 << 1)
 #define UART8250_FCR_EN     (0x1 << 0)
 
+#define UART8250_IER_ERBFI  (0x1 << 0)
+
 typedef struct uart8250_hw bao_uart_t;
 
 void uart_enable(volatile struct uart8250_hw* uart);
 void uart_init(volatile struct uart8250_hw* uart);
 void uart_putc(volatile struct uart8250_hw* uart, int8_t c);
+bool uart_trygetc(volatile struct uart8250_hw* uart, char* c);
+void uart_rxirq_enable(volatile struct uart8250_hw* uart);
 
 #endif /* UART8250_H */
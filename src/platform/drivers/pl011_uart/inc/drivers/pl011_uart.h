@@ -7,6 +7,7 @@
 #define __PL011_UART_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
 /* UART Base Address (PL011) */
 
@@ -208,5 +209,7 @@ void uart_set_baud_rate(volatile struct Pl011_Uart_hw* ptr_uart, uint32_t baud_r
 void uart_init(volatile struct Pl011_Uart_hw* ptr_uart);
 uint32_t uart_getc(volatile struct Pl011_Uart_hw* ptr_uart);
 void uart_putc(volatile struct Pl011_Uart_hw* ptr_uart, int8_t c);
+bool uart_trygetc(volatile struct Pl011_Uart_hw* ptr_uart, char* c);
+void uart_rxirq_enable(volatile struct Pl011_Uart_hw* ptr_uart);
 
 #endif /* __PL011_UART_H_ */
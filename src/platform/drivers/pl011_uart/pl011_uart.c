@@ -98,3 +98,18 @@ void uart_putc(volatile struct Pl011_Uart_hw* ptr_uart, int8_t c)
 
     ptr_uart->data = c;
 }
+
+bool uart_trygetc(volatile struct Pl011_Uart_hw* ptr_uart, char* c)
+{
+    if (ptr_uart->flag & UART_FR_RXFE) {
+        return false;
+    }
+
+    *c = (char)ptr_uart->data;
+    return true;
+}
+
+void uart_rxirq_enable(volatile struct Pl011_Uart_hw* ptr_uart)
+{
+    ptr_uart->isr_mask |= (UART_IMSC_RXIM | UART_IMSC_RTIM);
+}
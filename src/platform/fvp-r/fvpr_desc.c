@@ -22,6 +22,7 @@ struct platform platform = {
 
     .console = {
         .base = 0x9C090000,  // UART0 (PL011)
+        .irq = 37,
     },
 
     .arch = {
@@ -7,6 +7,8 @@ ARCH:=armv8
 CPU:=cortex-a53
 
 GIC_VERSION:=GICV3
+# Build with SMMU_VERSION=SMMUV3 to use the smmu of -machine virt,iommu=smmuv3
+SMMU_VERSION?=SMMUV2
 
 drivers = pl011_uart
 
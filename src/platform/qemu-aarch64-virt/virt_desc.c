@@ -17,7 +17,8 @@ struct platform platform = {
     },
 
     .console = {
-        .base = 0x9000000
+        .base = 0x9000000,
+        .irq = 33,
     },
 
     .arch = {
@@ -27,8 +28,16 @@ struct platform platform = {
             .gich_addr = 0x08030000,
             .gicv_addr = 0x08040000,
             .gicr_addr = 0x080A0000,
+            .gits_addr = 0x08080000,
             .maintenance_id = 25,
         },
+#if (SMMU_VERSION == SMMUV3)
+        /* Only present when qemu is run with -machine virt,iommu=smmuv3 */
+        .smmu = {
+            .base = 0x09050000,
+            .interrupt_id = 106,
+        },
+#endif
     },
 
 };
@@ -23,6 +23,12 @@ struct platform platform = {
         .irqc.plic.base = 0xc000000,
 #elif (IRQC == APLIC)
         .irqc.aia.aplic.base = 0xd000000,
+#elif (IRQC == AIA)
+        /* Requires QEMU to be run with -machine virt,aia=aplic-imsic,aia-guests=1 */
+        .irqc.aia.aplic.base = 0xd000000,
+        .irqc.aia.imsic.base = 0x28000000,
+        .irqc.aia.imsic.hart_stride = 0x2000,
+        .irqc.aia.imsic.num_ids = 255,
 #else
 #error "unknown IRQC type " IRQC
 #endif
@@ -26,6 +26,7 @@ struct platform platform = {
 
     .console = {
         .base = 0xfe215000,
+        .irq = 125, /* Shared by the aux peripherals */
     },
 
     .arch = {
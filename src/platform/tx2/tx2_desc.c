@@ -17,6 +17,7 @@ struct platform platform = {
 
     .console = {
         .base = 0x03100000,
+        .irq = 144,
     },
 
     .arch = {
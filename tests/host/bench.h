@@ -0,0 +1,85 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <bao.h>
+#include <time.h>
+
+/**
+ * Minimal host test harness. Inputs come from a seeded xorshift generator so every run of a test
+ * sees the same maps and request sequences, which keeps benchmark reports comparable across
+ * changes. The seed can be overridden through the BENCH_SEED environment variable.
+ */
+
+#define BENCH_DEFAULT_SEED (0x5eedb0a0ULL)
+
+struct bench_rng {
+    uint64_t state;
+};
+
+static size_t bench_failures;
+
+static inline uint64_t bench_seed()
+{
+    const char* seed = getenv("BENCH_SEED");
+    return (seed != NULL) ? strtoull(seed, NULL, 0) : BENCH_DEFAULT_SEED;
+}
+
+static inline void bench_rng_init(struct bench_rng* rng, uint64_t seed)
+{
+    rng->state = (seed != 0) ? seed : BENCH_DEFAULT_SEED;
+}
+
+static inline uint64_t bench_rand(struct bench_rng* rng)
+{
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return rng->state * UINT64_C(0x2545f4914f6cdd1d);
+}
+
+/* Uniformly distributed in [0, n) */
+static inline size_t bench_rand_below(struct bench_rng* rng, size_t n)
+{
+    return (size_t)(bench_rand(rng) % n);
+}
+
+static inline uint64_t bench_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * UINT64_C(1000000000)) + (uint64_t)ts.tv_nsec;
+}
+
+/* Keeps the compiler from dropping computations whose results are otherwise unused */
+static inline void bench_consume(uint64_t val)
+{
+    __asm__ volatile("" : : "r"(val) : "memory");
+}
+
+static inline void bench_report(const char* name, size_t ops, uint64_t ns)
+{
+    printf("  %-48s %10zu ops %10.1f ns/op\n", name, ops, (ops > 0) ? (double)ns / ops : 0.0);
+}
+
+#define TEST_CHECK(cond, fmt, ...)                               \
+    do {                                                         \
+        if (!(cond)) {                                           \
+            fprintf(stderr, "  FAIL %s:%d: " fmt "\n", __FILE__, \
+                __LINE__ __VA_OPT__(, ) __VA_ARGS__);            \
+            bench_failures++;                                    \
+        }                                                        \
+    } while (0)
+
+static inline int bench_result(const char* name)
+{
+    printf("%s: %s (seed 0x%llx)\n", name, bench_failures == 0 ? "passed" : "FAILED",
+        (unsigned long long)bench_seed());
+    return bench_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif /* __BENCH_H__ */
@@ -0,0 +1,256 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <bitmap.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define MAP_SIZE     (0x10000UL + 13)
+#define TEST_QUERIES (4000UL)
+#define BENCH_OPS    (2000UL)
+
+/**
+ * Reference implementations, testing one bit per iteration as the bitmap library did before it
+ * scanned a granule at a time. They define the expected results and the benchmark baseline.
+ */
+
+static ssize_t ref_find_nth(bitmap_t* map, size_t size, size_t nth, size_t start, bool set)
+{
+    if (size == 0 || nth == 0) {
+        return -1;
+    }
+
+    size_t count = 0;
+    for (size_t i = start; i < size; i++) {
+        if (bitmap_get(map, i) == set && ++count == nth) {
+            return (ssize_t)i;
+        }
+    }
+
+    return -1;
+}
+
+static size_t ref_count(bitmap_t* map, size_t start, size_t n, bool set)
+{
+    size_t count = 0;
+    for (size_t i = start; i < n; i++) {
+        count += (bitmap_get(map, i) == set) ? 1 : 0;
+    }
+    return count;
+}
+
+static size_t ref_count_consecutive(bitmap_t* map, size_t size, size_t start, size_t n)
+{
+    if (n <= 1) {
+        return n;
+    }
+
+    size_t count = 0;
+    unsigned bit = (start < size) ? bitmap_get(map, start) : 0;
+    for (size_t i = start; i < size && count < n && bitmap_get(map, i) == bit; i++) {
+        count++;
+    }
+    return count;
+}
+
+static ssize_t ref_find_consec(bitmap_t* map, size_t size, size_t start, size_t n, bool set)
+{
+    ssize_t i = ref_find_nth(map, size, 1, start, set);
+    if (i < 0) {
+        return -1;
+    }
+
+    while ((size_t)i < size) {
+        size_t count = ref_count_consecutive(map, size, (size_t)i, n);
+        if (count >= n) {
+            return i;
+        }
+        i += count;
+        i += ref_count_consecutive(map, size, (size_t)i, (size_t)-1);
+    }
+
+    return -1;
+}
+
+/* Each bit set with the given probability, in percent */
+static void map_random(struct bench_rng* rng, bitmap_t* map, size_t size, size_t density)
+{
+    memset(map, 0, BITMAP_SIZE(size) * sizeof(bitmap_granule_t));
+    for (size_t i = 0; i < size; i++) {
+        if (bench_rand_below(rng, 100) < density) {
+            bitmap_set(map, i);
+        }
+    }
+}
+
+/**
+ * Alternating runs of set and clear bits, as left in a page pool bitmap after a while: mostly
+ * allocated with short free holes.
+ */
+static void map_fragmented(struct bench_rng* rng, bitmap_t* map, size_t size)
+{
+    size_t pos = 0;
+    memset(map, 0, BITMAP_SIZE(size) * sizeof(bitmap_granule_t));
+    while (pos < size) {
+        size_t set_run = 1 + bench_rand_below(rng, 256);
+        set_run = min(set_run, size - pos);
+        bitmap_set_consecutive(map, pos, set_run);
+        pos += set_run + 1 + bench_rand_below(rng, 12);
+    }
+}
+
+static void test_queries(struct bench_rng* rng, bitmap_t* map, size_t size, const char* kind)
+{
+    for (size_t q = 0; q < TEST_QUERIES && bench_failures == 0; q++) {
+        size_t start = bench_rand_below(rng, size + 40);
+        bool set = bench_rand_below(rng, 2) != 0;
+        size_t nth = 1 + bench_rand_below(rng, 40);
+        size_t n = 1 + bench_rand_below(rng, 80);
+
+        TEST_CHECK(bitmap_find_next(map, size, start, set) ==
+                ref_find_nth(map, size, 1, start, set),
+            "%s: find_next(%zu, %d)", kind, start, set);
+        TEST_CHECK(bitmap_find_nth(map, size, nth, start, set) ==
+                ref_find_nth(map, size, nth, start, set),
+            "%s: find_nth(%zu, %zu, %d)", kind, nth, start, set);
+        TEST_CHECK(bitmap_find_consec(map, size, start, n, set) ==
+                ref_find_consec(map, size, start, n, set),
+            "%s: find_consec(%zu, %zu, %d)", kind, start, n, set);
+
+        if (start < size) {
+            size_t end = start + bench_rand_below(rng, size - start + 1);
+            TEST_CHECK(bitmap_count(map, start, end, set) == ref_count(map, start, end, set),
+                "%s: count(%zu, %zu, %d)", kind, start, end, set);
+            TEST_CHECK(bitmap_count_consecutive(map, size, start, n) ==
+                    ref_count_consecutive(map, size, start, n),
+                "%s: count_consecutive(%zu, %zu)", kind, start, n);
+        }
+    }
+
+    size_t visited = 0;
+    ssize_t prev = -1;
+    bitmap_foreach_set(map, size, bit)
+    {
+        TEST_CHECK(bit == ref_find_nth(map, size, 1, (size_t)(prev + 1), true),
+            "%s: foreach at %zd", kind, bit);
+        prev = bit;
+        visited++;
+    }
+    TEST_CHECK(visited == ref_count(map, 0, size, true), "%s: foreach visited %zu bits", kind,
+        visited);
+}
+
+static bool map_equal(bitmap_t* map1, bitmap_t* map2, size_t size)
+{
+    for (size_t i = 0; i < BITMAP_SIZE(size); i++) {
+        if (map1[i] != map2[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_set_clear(struct bench_rng* rng, bitmap_t* map, bitmap_t* ref, size_t size)
+{
+    memset(map, 0, BITMAP_SIZE(size) * sizeof(bitmap_granule_t));
+    memset(ref, 0, BITMAP_SIZE(size) * sizeof(bitmap_granule_t));
+
+    for (size_t q = 0; q < TEST_QUERIES && bench_failures == 0; q++) {
+        size_t start = bench_rand_below(rng, size);
+        size_t n = bench_rand_below(rng, min(size - start, 200UL) + 1);
+        bool set = bench_rand_below(rng, 2) != 0;
+
+        if (set) {
+            bitmap_set_consecutive(map, start, n);
+        } else {
+            bitmap_clear_consecutive(map, start, n);
+        }
+        for (size_t i = start; i < start + n; i++) {
+            if (set) {
+                bitmap_set(ref, i);
+            } else {
+                bitmap_clear(ref, i);
+            }
+        }
+
+        TEST_CHECK(map_equal(map, ref, size), "%s_consecutive(%zu, %zu)", set ? "set" : "clear", start, n);
+    }
+}
+
+/* Times the same sequence of searches with the library and the bit at a time reference */
+static void bench_map(struct bench_rng* rng, bitmap_t* map, size_t size, const char* kind)
+{
+    size_t* starts = calloc(BENCH_OPS, sizeof(size_t));
+    for (size_t i = 0; i < BENCH_OPS; i++) {
+        starts[i] = bench_rand_below(rng, size);
+    }
+
+    struct {
+        const char* name;
+        size_t nth;
+        size_t consec;
+    } queries[] = {
+        { "find first clear", 1, 0 },
+        { "find 16th clear", 16, 0 },
+        { "find 8 consecutive clear", 0, 8 },
+        { "find 64 consecutive clear", 0, 64 },
+    };
+
+    printf("bitmap, %s, %zu bits:\n", kind, size);
+    for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); q++) {
+        for (size_t impl = 0; impl < 2; impl++) {
+            uint64_t start = bench_now_ns();
+            for (size_t i = 0; i < BENCH_OPS; i++) {
+                size_t nth = queries[q].nth;
+                size_t consec = queries[q].consec;
+                ssize_t res;
+                if (consec > 0) {
+                    res = impl ? ref_find_consec(map, size, starts[i], consec, false) :
+                                 bitmap_find_consec(map, size, starts[i], consec, false);
+                } else {
+                    res = impl ? ref_find_nth(map, size, nth, starts[i], false) :
+                                 bitmap_find_nth(map, size, nth, starts[i], false);
+                }
+                bench_consume((uint64_t)res);
+            }
+            uint64_t ns = bench_now_ns() - start;
+
+            char label[64];
+            snprintf(label, sizeof(label), "%s (%s)", queries[q].name,
+                impl ? "bitwise" : "granule");
+            bench_report(label, BENCH_OPS, ns);
+        }
+    }
+
+    free(starts);
+}
+
+int main()
+{
+    struct bench_rng rng;
+    bitmap_t* map = calloc(BITMAP_SIZE(MAP_SIZE), sizeof(bitmap_granule_t));
+    bitmap_t* ref = calloc(BITMAP_SIZE(MAP_SIZE), sizeof(bitmap_granule_t));
+
+    bench_rng_init(&rng, bench_seed());
+
+    test_set_clear(&rng, map, ref, MAP_SIZE);
+    map_random(&rng, map, MAP_SIZE, 50);
+    test_queries(&rng, map, MAP_SIZE, "random");
+    map_random(&rng, map, MAP_SIZE, 97);
+    test_queries(&rng, map, MAP_SIZE, "mostly set");
+    map_fragmented(&rng, map, MAP_SIZE);
+    test_queries(&rng, map, MAP_SIZE, "fragmented");
+
+    map_random(&rng, map, MAP_SIZE, 50);
+    bench_map(&rng, map, MAP_SIZE, "random");
+    map_fragmented(&rng, map, MAP_SIZE);
+    bench_map(&rng, map, MAP_SIZE, "fragmented");
+
+    free(ref);
+    free(map);
+
+    return bench_result("bitmap_test");
+}
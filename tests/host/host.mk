@@ -0,0 +1,49 @@
+## SPDX-License-Identifier: Apache-2.0
+## Copyright (c) Bao Project and Contributors. All rights reserved.
+
+# Host-side unit tests and microbenchmarks of the arch independent libraries. They are built with
+# HOST_CC against the stub headers in tests/host/inc, so neither PLATFORM nor CONFIG is needed.
+
+host_test_dir:=$(cur_dir)/tests/host
+host_build_dir:=$(cur_dir)/build/host
+
+HOST_CFLAGS:=-O2 -Wall -Werror -std=gnu11 \
+	-I$(host_test_dir)/inc -I$(lib_dir)/inc -I$(core_dir)/inc
+
+host-tests+=bitmap_test
+bitmap_test-srcs:=$(host_test_dir)/bitmap_test.c $(lib_dir)/bitmap.c
+
+host-tests+=string_test
+string_test-srcs:=$(host_test_dir)/string_test.c $(lib_dir)/string.c
+# Rename the library's string functions so they do not replace the host C library's
+string_test-cflags:=-fno-builtin -fno-tree-loop-distribute-patterns -Dmemcpy=bao_memcpy \
+	-Dmemset=bao_memset -Dstrcat=bao_strcat -Dstrlen=bao_strlen -Dstrnlen=bao_strnlen \
+	-Dstrcpy=bao_strcpy -Dstrcmp=bao_strcmp
+
+host-tests+=printk_test
+printk_test-srcs:=$(host_test_dir)/printk_test.c $(lib_dir)/printk.c
+
+host-tests+=list_test
+list_test-srcs:=$(host_test_dir)/list_test.c
+
+host-tests+=objpool_test
+objpool_test-srcs:=$(host_test_dir)/objpool_test.c $(core_dir)/objpool.c
+
+host-tests+=page_pool_test
+page_pool_test-srcs:=$(host_test_dir)/page_pool_test.c $(core_dir)/page_pool.c \
+	$(lib_dir)/bitmap.c
+
+host_test_bins:=$(addprefix $(host_build_dir)/, $(host-tests))
+host_test_hdrs:=$(wildcard $(host_test_dir)/*.h $(host_test_dir)/inc/*.h $(host_test_dir)/inc/*/*.h \
+	$(lib_dir)/inc/*.h $(core_dir)/inc/*.h)
+
+.PHONY: host-bench
+host-bench: $(host_test_bins)
+	@for test in $^; do $$test || exit 1; done
+
+.SECONDEXPANSION:
+
+$(host_test_bins): $(host_build_dir)/%: $$($$*-srcs) $(host_test_hdrs)
+	@echo "Compiling host test	$(patsubst $(cur_dir)/%, %, $@)"
+	@mkdir -p $(@D)
+	@$(HOST_CC) $(HOST_CFLAGS) $($*-cflags) $(filter %.c, $^) -o $@
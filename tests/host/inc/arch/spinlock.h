@@ -0,0 +1,36 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __ARCH_SPINLOCK__
+#define __ARCH_SPINLOCK__
+
+#include <bao.h>
+
+/* The host tests are single threaded, so locks only need to type check */
+
+typedef struct {
+    uint32_t ticket;
+    uint32_t next;
+} spinlock_t;
+
+#define SPINLOCK_INITVAL ((spinlock_t){ 0, 0 })
+
+static inline void spinlock_init(spinlock_t* lock)
+{
+    lock->ticket = 0;
+    lock->next = 0;
+}
+
+static inline void spin_lock(spinlock_t* lock)
+{
+    lock->ticket++;
+}
+
+static inline void spin_unlock(spinlock_t* lock)
+{
+    lock->next++;
+}
+
+#endif /* __ARCH_SPINLOCK__ */
@@ -0,0 +1,32 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __BAO_H__
+#define __BAO_H__
+
+/**
+ * Host replacement for the hypervisor's bao.h, so that arch independent library and core sources
+ * build as regular Linux programs. Errors abort the test instead of hanging the cpu.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <types.h>
+#include <util.h>
+
+#define PAGE_SIZE (0x1000)
+
+#define INFO(args, ...)    printf("BAO INFO: " args "\n" __VA_OPT__(, ) __VA_ARGS__);
+
+#define WARNING(args, ...) printf("BAO WARNING: " args "\n" __VA_OPT__(, ) __VA_ARGS__);
+
+#define ERROR(args, ...)                                                     \
+    {                                                                        \
+        fprintf(stderr, "BAO ERROR: " args "\n" __VA_OPT__(, ) __VA_ARGS__); \
+        abort();                                                             \
+    }
+
+#endif /* __BAO_H__ */
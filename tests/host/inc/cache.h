@@ -0,0 +1,13 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <bao.h>
+
+#define CACHE_LINE_SIZE (64)
+
+#endif /* __CACHE_H__ */
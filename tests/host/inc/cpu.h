@@ -0,0 +1,27 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __CPU_H__
+#define __CPU_H__
+
+#include <bao.h>
+
+/**
+ * Host replacement for the hypervisor's cpu.h. There is a single host cpu, but tests may change its
+ * id to act as any of the platform's cpus.
+ */
+
+struct cpu {
+    cpuid_t id;
+};
+
+extern struct cpu host_cpu;
+
+static inline struct cpu* cpu()
+{
+    return &host_cpu;
+}
+
+#endif /* __CPU_H__ */
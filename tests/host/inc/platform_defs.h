@@ -0,0 +1,11 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __PLATFORM_DEFS_H__
+#define __PLATFORM_DEFS_H__
+
+#define PLAT_CPU_NUM (4)
+
+#endif /* __PLATFORM_DEFS_H__ */
@@ -0,0 +1,203 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <list.h>
+
+#include "bench.h"
+
+#define NODE_NUM     (512UL)
+#define TEST_OPS     (100000UL)
+#define BENCH_OPS    (1000000UL)
+#define BENCH_SORTED (64UL)
+
+struct list_node {
+    node_t next;
+    size_t key;
+};
+
+static void expected_remove(struct list_node** expected, size_t num, size_t pos)
+{
+    for (size_t i = pos; i + 1 < num; i++) {
+        expected[i] = expected[i + 1];
+    }
+}
+
+/**
+ * Random pushes, pops and removals checked against an array holding the expected contents of the
+ * list, in order. The list must also stay consistent: a NULL head if and only if the tail is NULL,
+ * and the tail being the last node.
+ */
+static void test_list_fifo(uint64_t seed)
+{
+    struct list list;
+    struct bench_rng rng;
+    struct list_node* nodes = calloc(NODE_NUM, sizeof(struct list_node));
+    struct list_node** expected = calloc(NODE_NUM, sizeof(struct list_node*));
+    bool* in_list = calloc(NODE_NUM, sizeof(bool));
+    size_t num = 0;
+
+    list_init(&list);
+    bench_rng_init(&rng, seed);
+
+    for (size_t op = 0; op < TEST_OPS && bench_failures == 0; op++) {
+        size_t choice = bench_rand_below(&rng, 100);
+        size_t index = bench_rand_below(&rng, NODE_NUM);
+
+        if (choice < 50 && !in_list[index]) {
+            list_push(&list, (node_t*)&nodes[index]);
+            expected[num++] = &nodes[index];
+            in_list[index] = true;
+        } else if (choice < 80) {
+            struct list_node* node = (struct list_node*)list_pop(&list);
+            TEST_CHECK(node == ((num > 0) ? expected[0] : NULL), "pop out of order");
+            if (num > 0) {
+                in_list[expected[0] - nodes] = false;
+                expected_remove(expected, num--, 0);
+            }
+        } else if (in_list[index]) {
+            list_rm(&list, (node_t*)&nodes[index]);
+            in_list[index] = false;
+            size_t pos = 0;
+            while (expected[pos] != &nodes[index]) {
+                pos++;
+            }
+            expected_remove(expected, num--, pos);
+        }
+
+        TEST_CHECK(list_empty(&list) == (num == 0), "list emptiness differs from the reference");
+        TEST_CHECK((list.head == NULL) == (list.tail == NULL), "head and tail disagree");
+        TEST_CHECK(list.tail == NULL || *list.tail == NULL, "tail is not the last node");
+
+        if ((op % 256) == 0) {
+            size_t pos = 0;
+            list_foreach (list, struct list_node, node) {
+                TEST_CHECK(pos < num && node == expected[pos], "list differs at %zu", pos);
+                pos++;
+            }
+            TEST_CHECK(pos == num, "list holds %zu nodes, expected %zu", pos, num);
+        }
+    }
+
+    free(in_list);
+    free(expected);
+    free(nodes);
+}
+
+static int list_node_cmp(node_t* a, node_t* b)
+{
+    size_t key_a = ((struct list_node*)a)->key;
+    size_t key_b = ((struct list_node*)b)->key;
+    return (key_a > key_b) - (key_a < key_b);
+}
+
+/* Ordered inserts must keep the list sorted, with equal keys in insertion order */
+static void test_list_ordered(uint64_t seed)
+{
+    struct list list;
+    struct bench_rng rng;
+    struct list_node* nodes = calloc(NODE_NUM, sizeof(struct list_node));
+
+    list_init(&list);
+    bench_rng_init(&rng, seed);
+
+    for (size_t i = 0; i < NODE_NUM; i++) {
+        nodes[i].key = bench_rand_below(&rng, NODE_NUM / 4);
+        list_insert_ordered(&list, (node_t*)&nodes[i], list_node_cmp);
+    }
+
+    size_t count = 0;
+    list_foreach_tail(list, struct list_node, node, prev)
+    {
+        TEST_CHECK(prev == NULL || prev->key < node->key ||
+                (prev->key == node->key && prev < node),
+            "nodes %zu and %zu out of order", (size_t)(prev - nodes), (size_t)(node - nodes));
+        count++;
+    }
+    TEST_CHECK(count == NODE_NUM, "list holds %zu nodes, expected %lu", count, NODE_NUM);
+    TEST_CHECK(list.tail != NULL && *list.tail == NULL, "tail is not the last node");
+
+    free(nodes);
+}
+
+static void bench_push_pop()
+{
+    struct list list;
+    struct list_node* nodes = calloc(NODE_NUM, sizeof(struct list_node));
+
+    list_init(&list);
+
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < BENCH_OPS; i++) {
+        list_push(&list, (node_t*)&nodes[i % NODE_NUM]);
+        if ((i % NODE_NUM) == NODE_NUM - 1) {
+            while (list_pop(&list) != NULL) { }
+        }
+    }
+    while (list_pop(&list) != NULL) { }
+    bench_report("push, then pop in batches", BENCH_OPS, bench_now_ns() - start);
+
+    free(nodes);
+}
+
+static void bench_rm(uint64_t seed)
+{
+    struct list list;
+    struct bench_rng rng;
+    struct list_node* nodes = calloc(BENCH_SORTED, sizeof(struct list_node));
+    size_t ops = 0;
+
+    bench_rng_init(&rng, seed);
+    list_init(&list);
+    for (size_t i = 0; i < BENCH_SORTED; i++) {
+        list_push(&list, (node_t*)&nodes[i]);
+    }
+
+    uint64_t start = bench_now_ns();
+    for (; ops < BENCH_OPS / 8; ops++) {
+        node_t* node = (node_t*)&nodes[bench_rand_below(&rng, BENCH_SORTED)];
+        list_rm(&list, node);
+        list_push(&list, node);
+    }
+    bench_report("random rm+push, 64 nodes", ops, bench_now_ns() - start);
+
+    free(nodes);
+}
+
+static void bench_ordered(uint64_t seed)
+{
+    struct list list;
+    struct bench_rng rng;
+    struct list_node* nodes = calloc(BENCH_SORTED, sizeof(struct list_node));
+    size_t ops = 0;
+
+    bench_rng_init(&rng, seed);
+
+    uint64_t start = bench_now_ns();
+    while (ops < BENCH_OPS / 8) {
+        list_init(&list);
+        for (size_t i = 0; i < BENCH_SORTED; i++, ops++) {
+            nodes[i].key = bench_rand(&rng);
+            list_insert_ordered(&list, (node_t*)&nodes[i], list_node_cmp);
+        }
+    }
+    bench_report("insert_ordered, random keys, up to 64 nodes", ops, bench_now_ns() - start);
+
+    free(nodes);
+}
+
+int main()
+{
+    uint64_t seed = bench_seed();
+
+    test_list_fifo(seed);
+    test_list_ordered(seed);
+
+    printf("list:\n");
+    bench_push_pop();
+    bench_rm(seed);
+    bench_ordered(seed);
+
+    return bench_result("list_test");
+}
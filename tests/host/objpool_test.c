@@ -0,0 +1,137 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <objpool.h>
+#include <cpu.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define POOL_NUM  (256UL)
+#define TEST_OPS  (200000UL)
+#define BENCH_OPS (1000000UL)
+
+struct pool_obj {
+    uint64_t data[4];
+};
+
+struct cpu host_cpu;
+
+OBJPOOL_ALLOC(plain_pool, struct pool_obj, POOL_NUM);
+OBJPOOL_ALLOC_CACHED(cached_pool, struct pool_obj, POOL_NUM);
+
+static inline size_t pool_index(struct objpool* pool, void* obj)
+{
+    return (size_t)((uint8_t*)obj - (uint8_t*)pool->pool) / pool->objsize;
+}
+
+/**
+ * Random allocations and frees, from random cpus for cached pools, checked against a shadow map of
+ * the objects handed out. Every object must be in the pool, handed out only once, and allocations
+ * may only fail once POOL_NUM objects are in use, no matter how many are stranded in the magazines
+ * of other cpus.
+ */
+static void test_objpool(const char* name, struct objpool* pool, uint64_t seed)
+{
+    struct bench_rng rng;
+    uint8_t* shadow = calloc(pool->num, sizeof(uint8_t));
+    void** objs = calloc(pool->num, sizeof(void*));
+    size_t obj_num = 0;
+
+    objpool_init(pool);
+    bench_rng_init(&rng, seed);
+
+    for (size_t op = 0; op < TEST_OPS && bench_failures == 0; op++) {
+        if (pool->caches != NULL) {
+            cpu()->id = bench_rand_below(&rng, PLAT_CPU_NUM);
+        }
+
+        /* Drift between an empty and an exhausted pool so both ends are exercised */
+        size_t alloc_pct = ((op / (TEST_OPS / 8)) % 2 == 0) ? 70 : 30;
+        if (obj_num > 0 && bench_rand_below(&rng, 100) >= alloc_pct) {
+            size_t i = bench_rand_below(&rng, obj_num);
+            void* obj = objs[i];
+            objs[i] = objs[--obj_num];
+            shadow[pool_index(pool, obj)] = 0;
+            objpool_free(pool, obj);
+            continue;
+        }
+
+        void* obj = objpool_alloc(pool);
+        if (obj == NULL) {
+            TEST_CHECK(obj_num >= POOL_NUM, "%s: allocation failed with only %zu objects in use",
+                name, obj_num);
+            continue;
+        }
+
+        size_t index = pool_index(pool, obj);
+        TEST_CHECK(index < pool->num, "%s: object out of the pool", name);
+        TEST_CHECK(((uint8_t*)obj - (uint8_t*)pool->pool) % pool->objsize == 0,
+            "%s: misaligned object", name);
+        if (index < pool->num) {
+            TEST_CHECK(shadow[index] == 0, "%s: object %zu handed out twice", name, index);
+            shadow[index] = 1;
+        }
+        objs[obj_num++] = obj;
+    }
+
+    cpu()->id = 0;
+    free(objs);
+    free(shadow);
+}
+
+/* Back to back alloc and free of a single object, the common case for cpu messages */
+static void bench_pairs(const char* name, struct objpool* pool)
+{
+    objpool_init(pool);
+
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < BENCH_OPS; i++) {
+        void* obj = objpool_alloc(pool);
+        bench_consume((uint64_t)(uintptr_t)obj);
+        objpool_free(pool, obj);
+    }
+    bench_report(name, BENCH_OPS, bench_now_ns() - start);
+}
+
+/* Drains the whole pool and then frees all objects, cycling through the free list */
+static void bench_bursts(const char* name, struct objpool* pool)
+{
+    void** objs = calloc(pool->num + 1, sizeof(void*));
+    size_t ops = 0;
+
+    objpool_init(pool);
+
+    uint64_t start = bench_now_ns();
+    while (ops < BENCH_OPS) {
+        size_t num = 0;
+        while ((objs[num] = objpool_alloc(pool)) != NULL) {
+            num++;
+        }
+        while (num > 0) {
+            objpool_free(pool, objs[--num]);
+            ops++;
+        }
+    }
+    bench_report(name, ops, bench_now_ns() - start);
+
+    free(objs);
+}
+
+int main()
+{
+    uint64_t seed = bench_seed();
+
+    test_objpool("plain", &plain_pool, seed);
+    test_objpool("cached", &cached_pool, seed);
+
+    printf("objpool, %lu objects, %d cpus:\n", POOL_NUM, PLAT_CPU_NUM);
+    bench_pairs("plain, alloc+free pairs", &plain_pool);
+    bench_pairs("cached, alloc+free pairs", &cached_pool);
+    bench_bursts("plain, drain+refill bursts", &plain_pool);
+    bench_bursts("cached, drain+refill bursts", &cached_pool);
+
+    return bench_result("objpool_test");
+}
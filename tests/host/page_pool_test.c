@@ -0,0 +1,193 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <page_pool.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define POOL_BASE      (0x80000000UL)
+#define POOL_NUM_PAGES (0x10000UL)
+#define MAX_ALLOC      (64UL)
+#define TEST_OPS       (200000UL)
+#define BENCH_OPS      (20000UL)
+
+struct pool_alloc {
+    size_t index;
+    size_t num_pages;
+};
+
+static void pool_init(struct page_pool* pool, size_t num_pages)
+{
+    size_t meta_size = pp_meta_num_pages(num_pages) * PAGE_SIZE;
+
+    memset(pool, 0, sizeof(*pool));
+    pool->base = POOL_BASE;
+    pool->size = num_pages;
+    pool->free = num_pages;
+    pool->lock = SPINLOCK_INITVAL;
+    pool->bitmap = aligned_alloc(PAGE_SIZE, meta_size);
+    if (pool->bitmap == NULL) {
+        ERROR("failed to allocate pool metadata");
+    }
+    memset(pool->bitmap, 0, meta_size);
+    pp_buddy_init(pool);
+}
+
+static void pool_free(struct page_pool* pool, size_t index, size_t num_pages)
+{
+    pp_mark_free(pool, index, num_pages);
+    pool->free += num_pages;
+}
+
+static bool pool_alloc(struct page_pool* pool, size_t num_pages, bool aligned, size_t* index)
+{
+    struct ppages ppages;
+    if (!pp_alloc(pool, num_pages, aligned, &ppages) || ppages.num_pages != num_pages) {
+        return false;
+    }
+    *index = (ppages.base - pool->base) / PAGE_SIZE;
+    return true;
+}
+
+static size_t pool_rand_size(struct bench_rng* rng, bool* aligned)
+{
+    /* Mostly small requests, as for page tables and hypervisor objects, with some larger ones */
+    size_t num_pages = (bench_rand_below(rng, 4) == 0) ? (1 + bench_rand_below(rng, MAX_ALLOC)) :
+                                                          (1UL << bench_rand_below(rng, 4));
+    *aligned = ((num_pages & (num_pages - 1)) == 0) && (bench_rand_below(rng, 2) == 0);
+    return num_pages;
+}
+
+/**
+ * Random allocations and frees checked against a shadow map of the pool, and the buddy assisted
+ * pp_next_free checked against a bitmap scan.
+ */
+static void test_page_pool(uint64_t seed)
+{
+    struct page_pool pool;
+    struct bench_rng rng;
+    uint8_t* shadow = calloc(POOL_NUM_PAGES, sizeof(uint8_t));
+    struct pool_alloc* allocs = calloc(POOL_NUM_PAGES, sizeof(struct pool_alloc));
+    size_t alloc_num = 0;
+    size_t used = 0;
+
+    pool_init(&pool, POOL_NUM_PAGES);
+    bench_rng_init(&rng, seed);
+
+    for (size_t op = 0; op < TEST_OPS; op++) {
+        bool free_op = (alloc_num > 0) && (bench_rand_below(&rng, 100) < 45);
+
+        if (free_op) {
+            size_t i = bench_rand_below(&rng, alloc_num);
+            struct pool_alloc alloc = allocs[i];
+            allocs[i] = allocs[--alloc_num];
+            memset(&shadow[alloc.index], 0, alloc.num_pages);
+            used -= alloc.num_pages;
+            pool_free(&pool, alloc.index, alloc.num_pages);
+        } else {
+            bool aligned;
+            size_t num_pages = pool_rand_size(&rng, &aligned);
+            size_t index;
+            if (pool_alloc(&pool, num_pages, aligned, &index)) {
+                TEST_CHECK(index + num_pages <= POOL_NUM_PAGES, "allocation out of the pool");
+                TEST_CHECK(!aligned || (((POOL_BASE / PAGE_SIZE) + index) % num_pages) == 0,
+                    "misaligned allocation of %zu pages at %zu", num_pages, index);
+                for (size_t p = index; p < index + num_pages && p < POOL_NUM_PAGES; p++) {
+                    TEST_CHECK(shadow[p] == 0, "page %zu allocated twice", p);
+                    shadow[p] = 1;
+                }
+                allocs[alloc_num++] = (struct pool_alloc){ index, num_pages };
+                used += num_pages;
+            }
+        }
+
+        TEST_CHECK(pool.free == POOL_NUM_PAGES - used, "free count %zu, expected %zu", pool.free,
+            POOL_NUM_PAGES - used);
+
+        if ((op % 1024) == 0) {
+            for (size_t p = 0; p < POOL_NUM_PAGES; p++) {
+                TEST_CHECK(bitmap_get(pool.bitmap, p) == shadow[p], "bitmap differs at %zu", p);
+            }
+            size_t from = bench_rand_below(&rng, POOL_NUM_PAGES);
+            size_t next = from;
+            while (next < POOL_NUM_PAGES && shadow[next]) {
+                next++;
+            }
+            TEST_CHECK(pp_next_free(&pool, from) == next, "next free from %zu is %zu, not %zu",
+                from, pp_next_free(&pool, from), next);
+        }
+
+        if (bench_failures > 0) {
+            break;
+        }
+    }
+
+    free(allocs);
+    free(shadow);
+    free(pool.bitmap);
+}
+
+/**
+ * Leaves one in every stride pages allocated, so no free run spans more than stride - 1 pages.
+ */
+static void pool_fragment(struct page_pool* pool, size_t stride)
+{
+    for (size_t p = 0; p < pool->size; p += stride) {
+        pp_mark_alloc(pool, p, 1);
+        pool->free--;
+    }
+}
+
+static void bench_alloc(const char* name, size_t stride, size_t num_pages, bool aligned)
+{
+    struct page_pool pool;
+    size_t* indexes = calloc(BENCH_OPS, sizeof(size_t));
+    size_t allocated = 0;
+
+    pool_init(&pool, POOL_NUM_PAGES);
+    if (stride > 0) {
+        pool_fragment(&pool, stride);
+    }
+
+    uint64_t start = bench_now_ns();
+    while (allocated < BENCH_OPS && pool_alloc(&pool, num_pages, aligned, &indexes[allocated])) {
+        allocated++;
+    }
+    uint64_t alloc_ns = bench_now_ns() - start;
+
+    start = bench_now_ns();
+    for (size_t i = 0; i < allocated; i++) {
+        pool_free(&pool, indexes[i], num_pages);
+    }
+    uint64_t free_ns = bench_now_ns() - start;
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s alloc", name);
+    bench_report(label, allocated, alloc_ns);
+    snprintf(label, sizeof(label), "%s free", name);
+    bench_report(label, allocated, free_ns);
+
+    free(indexes);
+    free(pool.bitmap);
+}
+
+int main()
+{
+    uint64_t seed = bench_seed();
+
+    test_page_pool(seed);
+
+    printf("page pool, %lu pages:\n", POOL_NUM_PAGES);
+    bench_alloc("empty, 1 page", 0, 1, false);
+    bench_alloc("empty, 8 pages aligned", 0, 8, true);
+    bench_alloc("empty, 64 pages aligned", 0, 64, true);
+    bench_alloc("fragmented /4, 1 page", 4, 1, false);
+    bench_alloc("fragmented /4, 2 pages", 4, 2, false);
+    bench_alloc("fragmented /16, 8 pages aligned", 16, 8, true);
+    bench_alloc("fragmented /128, 64 pages aligned", 128, 64, true);
+
+    return bench_result("page_pool_test");
+}
@@ -0,0 +1,133 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <printk.h>
+
+#include "bench.h"
+
+/**
+ * vsnprintk output is checked against the host snprintf for the subset of the format it supports:
+ * the 'd', 'i', 'u', 'x', 's', 'c' and '%' specifiers, with no or the 'l' length.
+ */
+
+#define TEST_OPS  (20000UL)
+#define BENCH_OPS (200000UL)
+
+struct printk_out {
+    size_t len;
+    const char* fmt_left;
+};
+
+static struct printk_out snprintk(char* buf, size_t buf_size, const char* fmt, ...)
+{
+    va_list args;
+    struct printk_out out;
+
+    va_start(args, fmt);
+    out.fmt_left = fmt;
+    out.len = vsnprintk(buf, buf_size, &out.fmt_left, &args);
+    va_end(args);
+
+    return out;
+}
+
+static bool chars_equal(const char* a, const char* b, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_printk(uint64_t seed)
+{
+    static const char* const fmts[] = { "int %d, %i", "uint %u, %u", "hex %x, %x",
+        "long %ld, %ld", "ulong %lu, %lx", "str %s, char %c", "%d%% of %s" };
+    static const char* const strs[] = { "", "a", "vcpu", "a longer string argument" };
+    struct bench_rng rng;
+    char out[128];
+    char ref[128];
+
+    bench_rng_init(&rng, seed);
+
+    for (size_t op = 0; op < TEST_OPS && bench_failures == 0; op++) {
+        size_t fmt_id = bench_rand_below(&rng, sizeof(fmts) / sizeof(fmts[0]));
+        const char* fmt = fmts[fmt_id];
+        const char* str = strs[bench_rand_below(&rng, sizeof(strs) / sizeof(strs[0]))];
+        uint64_t a = bench_rand(&rng) >> bench_rand_below(&rng, 64);
+        uint64_t b = bench_rand(&rng) >> bench_rand_below(&rng, 64);
+        char c = (char)('a' + bench_rand_below(&rng, 26));
+        struct printk_out res = { 0 };
+        int ref_len = 0;
+
+        switch (fmt_id) {
+            case 0:
+                ref_len = snprintf(ref, sizeof(ref), fmt, (int)a, (int)b);
+                res = snprintk(out, sizeof(out), fmt, (int)a, (int)b);
+                break;
+            case 1:
+            case 2:
+                ref_len = snprintf(ref, sizeof(ref), fmt, (unsigned)a, (unsigned)b);
+                res = snprintk(out, sizeof(out), fmt, (unsigned)a, (unsigned)b);
+                break;
+            case 3:
+                ref_len = snprintf(ref, sizeof(ref), fmt, (long)(a >> 1), -(long)(b >> 1));
+                res = snprintk(out, sizeof(out), fmt, (long)(a >> 1), -(long)(b >> 1));
+                break;
+            case 4:
+                ref_len = snprintf(ref, sizeof(ref), fmt, (unsigned long)a, (unsigned long)b);
+                res = snprintk(out, sizeof(out), fmt, (unsigned long)a, (unsigned long)b);
+                break;
+            case 5:
+                ref_len = snprintf(ref, sizeof(ref), fmt, str, c);
+                res = snprintk(out, sizeof(out), fmt, str, c);
+                break;
+            default:
+                ref_len = snprintf(ref, sizeof(ref), fmt, (int)a, str);
+                res = snprintk(out, sizeof(out), fmt, (int)a, str);
+                break;
+        }
+
+        TEST_CHECK(res.len == (size_t)ref_len && chars_equal(out, ref, res.len),
+            "\"%s\" printed \"%.*s\", expected \"%s\"", fmt, (int)res.len, out, ref);
+        TEST_CHECK(*res.fmt_left == '\0', "\"%s\" stopped at \"%s\"", fmt, res.fmt_left);
+
+        /**
+         * With a smaller buffer, output stops before the first argument that does not fit, and
+         * the format is left pointing at its specifier.
+         */
+        size_t buf_size = bench_rand_below(&rng, (size_t)ref_len + 1);
+        res = snprintk(out, buf_size, "%s", ref);
+        TEST_CHECK(res.len == ((buf_size < (size_t)ref_len) ? 0 : (size_t)ref_len),
+            "printed %zu characters of a %d string in %zu", res.len, ref_len, buf_size);
+    }
+}
+
+static void bench_printk()
+{
+    char out[128];
+
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < BENCH_OPS; i++) {
+        struct printk_out res = snprintk(out, sizeof(out), "BAO INFO: vm %d vcpu %lu at 0x%lx: %s",
+            (int)i, (unsigned long)i, (unsigned long)(i * 0x1000), "exit");
+        bench_consume(res.len);
+    }
+    bench_report("typical log line", BENCH_OPS, bench_now_ns() - start);
+}
+
+int main()
+{
+    uint64_t seed = bench_seed();
+
+    test_printk(seed);
+
+    printf("printk:\n");
+    bench_printk();
+
+    return bench_result("printk_test");
+}
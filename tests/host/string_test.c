@@ -0,0 +1,153 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <string.h>
+
+#include "bench.h"
+
+/**
+ * The library's string functions are built under their own names (see host.mk), so the host C
+ * library keeps its own. Byte at a time loops below define the expected results.
+ */
+
+#define BUF_SIZE   (4096UL)
+#define TEST_OPS   (20000UL)
+#define BENCH_SIZE (64UL * 1024)
+#define BENCH_OPS  (2000UL)
+
+static uint8_t src_buf[BUF_SIZE + 64] __attribute__((aligned(64)));
+static uint8_t dst_buf[BUF_SIZE + 64] __attribute__((aligned(64)));
+static uint8_t ref_buf[BUF_SIZE + 64] __attribute__((aligned(64)));
+
+static void fill_rand(struct bench_rng* rng, uint8_t* buf, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = (uint8_t)bench_rand(rng);
+    }
+}
+
+static bool bytes_equal(const uint8_t* a, const uint8_t* b, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Random sizes and alignments, checking nothing around the destination is touched */
+static void test_memcpy_memset(uint64_t seed)
+{
+    struct bench_rng rng;
+    bench_rng_init(&rng, seed);
+
+    for (size_t op = 0; op < TEST_OPS && bench_failures == 0; op++) {
+        size_t src_off = bench_rand_below(&rng, 16);
+        size_t dst_off = (bench_rand_below(&rng, 2) == 0) ? src_off : bench_rand_below(&rng, 16);
+        size_t size = (bench_rand_below(&rng, 4) == 0) ? bench_rand_below(&rng, 17) :
+                                                          bench_rand_below(&rng, BUF_SIZE);
+
+        fill_rand(&rng, src_buf, sizeof(src_buf));
+        fill_rand(&rng, dst_buf, sizeof(dst_buf));
+        for (size_t i = 0; i < sizeof(dst_buf); i++) {
+            ref_buf[i] = dst_buf[i];
+        }
+
+        if (bench_rand_below(&rng, 2) == 0) {
+            for (size_t i = 0; i < size; i++) {
+                ref_buf[dst_off + i] = src_buf[src_off + i];
+            }
+            void* ret = memcpy(&dst_buf[dst_off], &src_buf[src_off], size);
+            TEST_CHECK(ret == &dst_buf[dst_off], "memcpy returned the wrong pointer");
+            TEST_CHECK(bytes_equal(dst_buf, ref_buf, sizeof(dst_buf)),
+                "memcpy of %zu bytes from offset %zu to %zu", size, src_off, dst_off);
+        } else {
+            int c = (int)bench_rand_below(&rng, 256);
+            for (size_t i = 0; i < size; i++) {
+                ref_buf[dst_off + i] = (uint8_t)c;
+            }
+            void* ret = memset(&dst_buf[dst_off], c, size);
+            TEST_CHECK(ret == &dst_buf[dst_off], "memset returned the wrong pointer");
+            TEST_CHECK(bytes_equal(dst_buf, ref_buf, sizeof(dst_buf)),
+                "memset of %zu bytes at offset %zu", size, dst_off);
+        }
+    }
+}
+
+static void test_strings(uint64_t seed)
+{
+    struct bench_rng rng;
+    char str[128];
+    char cat[256];
+
+    bench_rng_init(&rng, seed);
+
+    for (size_t op = 0; op < TEST_OPS && bench_failures == 0; op++) {
+        size_t len = bench_rand_below(&rng, sizeof(str));
+        for (size_t i = 0; i < len; i++) {
+            str[i] = (char)('a' + bench_rand_below(&rng, 26));
+        }
+        str[len] = '\0';
+
+        size_t max = bench_rand_below(&rng, sizeof(str) + 1);
+        TEST_CHECK(strlen(str) == len, "strlen is %zu, expected %zu", strlen(str), len);
+        TEST_CHECK(strnlen(str, max) == min(len, max), "strnlen(%zu) is %zu, expected %zu", max,
+            strnlen(str, max), min(len, max));
+
+        TEST_CHECK(strcpy(cat, str) == cat, "strcpy returned the wrong pointer");
+        TEST_CHECK(strcat(cat, str) == cat, "strcat returned the wrong pointer");
+        TEST_CHECK(strlen(cat) == 2 * len, "strcat of two %zu strings is %zu long", len,
+            strlen(cat));
+        TEST_CHECK(bytes_equal((uint8_t*)cat, (uint8_t*)str, len) &&
+                bytes_equal((uint8_t*)&cat[len], (uint8_t*)str, len + 1),
+            "strcpy or strcat of %zu characters", len);
+    }
+}
+
+static void bench_copy(const char* name, size_t src_off, size_t dst_off, size_t size)
+{
+    static uint8_t src[BENCH_SIZE + 64] __attribute__((aligned(64)));
+    static uint8_t dst[BENCH_SIZE + 64] __attribute__((aligned(64)));
+    size_t ops = (BENCH_OPS * BENCH_SIZE) / size;
+
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < ops; i++) {
+        memcpy(&dst[dst_off], &src[src_off], size);
+        bench_consume(dst[dst_off]);
+    }
+    bench_report(name, ops, bench_now_ns() - start);
+}
+
+static void bench_set(const char* name, size_t off, size_t size)
+{
+    static uint8_t dst[BENCH_SIZE + 64] __attribute__((aligned(64)));
+    size_t ops = (BENCH_OPS * BENCH_SIZE) / size;
+
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < ops; i++) {
+        memset(&dst[off], (int)i, size);
+        bench_consume(dst[off]);
+    }
+    bench_report(name, ops, bench_now_ns() - start);
+}
+
+int main()
+{
+    uint64_t seed = bench_seed();
+
+    test_memcpy_memset(seed);
+    test_strings(seed);
+
+    printf("string:\n");
+    bench_copy("memcpy, 64 bytes aligned", 0, 0, 64);
+    bench_copy("memcpy, 4KiB aligned", 0, 0, 4096);
+    bench_copy("memcpy, 64KiB aligned", 0, 0, BENCH_SIZE);
+    bench_copy("memcpy, 4KiB misaligned", 1, 3, 4096);
+    bench_set("memset, 4KiB aligned", 0, 4096);
+    bench_set("memset, 64KiB aligned", 0, BENCH_SIZE);
+
+    return bench_result("string_test");
+}